@@ -12,6 +12,11 @@ from ._ispc_texcomp import (
     ETCEncSettings,
     ASTCEncSettings,
     RGBASurface,
+    RGBAHalfSurface,
+    StreamEncoder,
+    Encoder,
+    BlockCache,
+    EncodeCache,
     compress_blocks_bc1,
     compress_blocks_bc3,
     compress_blocks_bc4,
@@ -20,6 +25,37 @@ from ._ispc_texcomp import (
     compress_blocks_bc7,
     compress_blocks_etc1,
     compress_blocks_astc,
+    compress_blocks_bc1_into,
+    compress_blocks_bc3_into,
+    compress_blocks_bc4_into,
+    compress_blocks_bc5_into,
+    compress_blocks_bc6h_into,
+    compress_blocks_bc7_into,
+    compress_blocks_etc1_into,
+    compress_blocks_astc_into,
+    decompress_blocks_bc1,
+    decompress_blocks_bc3,
+    decompress_blocks_bc4,
+    decompress_blocks_bc5,
+    decompress_blocks_bc6h,
+    decompress_blocks_bc7,
+    decompress_blocks_etc1,
+    decompress_blocks_astc,
+    compress_batch,
+    compress_mip_chain,
+    compress_to_file,
+    compress_region,
+    compress_adaptive,
+    write_dds,
+    write_ktx2,
+    compress_async,
+    compressed_size,
+    configure_thread_pool,
+    thread_pool_size,
+    cpu_target,
+    enable_stats,
+    stats,
+    reset_stats,
 )
 
 # Add module-level documentation
@@ -37,6 +73,11 @@ through stub files (.pyi).
 __all__ = [
     "__version__",
     "RGBASurface",
+    "RGBAHalfSurface",
+    "StreamEncoder",
+    "Encoder",
+    "BlockCache",
+    "EncodeCache",
     "BC6HEncSettings",
     "BC7EncSettings",
     "ETCEncSettings",
@@ -49,4 +90,35 @@ __all__ = [
     "compress_blocks_bc7",
     "compress_blocks_etc1",
     "compress_blocks_astc",
+    "compress_blocks_bc1_into",
+    "compress_blocks_bc3_into",
+    "compress_blocks_bc4_into",
+    "compress_blocks_bc5_into",
+    "compress_blocks_bc6h_into",
+    "compress_blocks_bc7_into",
+    "compress_blocks_etc1_into",
+    "compress_blocks_astc_into",
+    "decompress_blocks_bc1",
+    "decompress_blocks_bc3",
+    "decompress_blocks_bc4",
+    "decompress_blocks_bc5",
+    "decompress_blocks_bc6h",
+    "decompress_blocks_bc7",
+    "decompress_blocks_etc1",
+    "decompress_blocks_astc",
+    "compress_batch",
+    "compress_mip_chain",
+    "compress_to_file",
+    "compress_region",
+    "compress_adaptive",
+    "write_dds",
+    "write_ktx2",
+    "compress_async",
+    "compressed_size",
+    "configure_thread_pool",
+    "thread_pool_size",
+    "cpu_target",
+    "enable_stats",
+    "stats",
+    "reset_stats",
 ]
@@ -1,6 +1,39 @@
 from __future__ import annotations
 
-from typing import ByteString, Literal
+from collections.abc import Buffer, Callable
+from concurrent.futures import Future
+from os import PathLike
+from typing import ByteString, Literal, Sequence, TypedDict, overload
+
+PixelFormat = Literal["rgba8", "bgra8", "rgb8", "r8", "rg8", "rgba16f", "rgba32f"]
+
+class EncodeMetrics(TypedDict, total=False):
+    """
+    Error of the compressed blocks against the kernel input, over the channels the format stores
+    (RGB for BC1, ETC1 and BC6H, R for BC4, RG for BC5 and RGBA otherwise).
+    The PSNR peak is 255, or 1.0 for BC6H.
+    """
+
+    mse: float
+    psnr: float
+    channel_mse: tuple[float, ...]
+    channel_psnr: tuple[float, ...]
+    # float32 memoryview of shape (blocks_y, blocks_x), only with block_errors=True
+    block_mse: memoryview
+
+class CallStats(TypedDict):
+    """Cumulative counters of the compress_blocks_* calls of one format and profile, see stats()."""
+
+    calls: int
+    blocks: int
+    # size of the source pixels and of the compressed blocks
+    bytes_in: int
+    bytes_out: int
+    # time in the kernels, waiting for the GIL after them,
+    # and in the rest of the call (argument parsing, allocations, building the result)
+    kernel_ns: int
+    gil_wait_ns: int
+    wrapper_ns: int
 
 class RGBASurface:
     """
@@ -14,41 +47,140 @@ class RGBASurface:
         The height of the image in pixels (must be > 0)
     stride : int
         The number of bytes per row (calculated as width*4 if 0)
+    pixel_format : PixelFormat | None
+        The layout of the pixels, None if they're passed to the kernels as is
+
+    The attributes are read-only, the geometry is checked against the source as the surface is created.
 
     Methods
     -------
-    __init__(src, width, height, stride=0)
-        Initialize from raw pixel data
+    __init__(src, width=None, height=None, stride=0, pixel_format=None)
+        Initialize from raw pixel data or an array
+    from_file(path, width, height, stride=0, offset=0, pixel_format=None, *, validate=True)
+        Map raw pixel data from a file
+    from_array(array, pixel_format=None)
+        Surfaces pointing into an array, one per image of a batch
     data()
-        Get raw bytes of the surface
+        Get the pixels of the surface, without the stride padding
     __buffer__()
-        Get memoryview of pixel data
+        Get a memoryview of the pixels, padded rows are only exported with their strides
     """
 
-    width: int
-    height: int
-    stride: int
-
+    @property
+    def width(self) -> int: ...
+    @property
+    def height(self) -> int: ...
+    @property
+    def stride(self) -> int: ...
     def __init__(
-        self, src: ByteString, width: int, height: int, stride: int = 0
+        self,
+        src: ByteString | Buffer,
+        width: int | None = None,
+        height: int | None = None,
+        stride: int = 0,
+        pixel_format: PixelFormat | None = None,
     ) -> None:
         """
-        Initialize an RGBA surface from raw pixel data.
+        Initialize an RGBA surface from raw pixel data or an array.
+
+        Parameters
+        ----------
+        src : ByteString | Buffer
+            Raw RGBA pixel data (length should be height*stride or width*height*4),
+            or without width and height an array of shape (H, W) or (H, W, C),
+            through the buffer protocol or DLPack, see from_array
+        width : int | None, optional
+            Surface width in pixels (>0)
+        height : int | None, optional
+            Surface height in pixels (>0)
+        stride : int, optional
+            Bytes per row (0 = width * bytes per pixel)
+        pixel_format : PixelFormat | None, optional
+            Default None. Layout of the pixels, they're converted to the kernel input
+            block row by block row while compressing
+
+        Notes
+        -----
+        Without a pixel format the data is passed to the kernels as is,
+        which expect 8-bit RGBA, R8 for BC4, RG8 for BC5 and RGBA half floats for BC6H.
+        Missing channels become 0 (alpha 1) and floats are clamped for the 8-bit formats.
+        The size doesn't have to be a multiple of the block size,
+        the partial edge blocks are compressed with the border pixels replicated.
+        """
+        ...
+
+    @classmethod
+    def from_file(
+        cls,
+        path: str | bytes | PathLike,
+        width: int,
+        height: int,
+        stride: int = 0,
+        offset: int = 0,
+        pixel_format: PixelFormat | None = None,
+        *,
+        validate: bool = True,
+    ) -> RGBASurface:
+        """
+        Create a surface from raw pixel data in a file, without reading it into memory.
+
+        The file is memory mapped read-only,
+        so only the pages that get compressed are loaded.
 
         Parameters
         ----------
-        src : ByteString
-            Raw RGBA pixel data (length should be height*stride or width*height*4)
+        path : str | bytes | PathLike
+            Path of the raw file
         width : int
             Surface width in pixels (>0)
         height : int
             Surface height in pixels (>0)
         stride : int, optional
             Bytes per row (0 = width*4)
+        offset : int, optional
+            Default 0. Position of the first row in the file, e.g. to skip a header
+        pixel_format : PixelFormat | None, optional
+            Default None. Layout of the pixels, see __init__
+        validate : bool, optional
+            Default True. Only used by RGBAHalfSurface, see its __init__,
+            which reads the whole mapped range up front
+
+        Returns
+        -------
+        RGBASurface
+            Surface backed by the mapped file
+        """
+        ...
+
+    @classmethod
+    def from_array(
+        cls, array: Buffer, pixel_format: PixelFormat | None = None, *, validate: bool = True
+    ) -> RGBASurface | list[RGBASurface]:
+        """
+        Create surfaces pointing into an array, without copying it.
+
+        Parameters
+        ----------
+        array : Buffer
+            Array of shape (H, W), (H, W, C) or a batch of shape (N, H, W, C)
+            with uint8, float16 or float32 channels, supporting the buffer protocol
+            or DLPack (CPU memory only), e.g. a NumPy array
+        pixel_format : PixelFormat | None, optional
+            Default None. Layout of the pixels, derived from the channels and dtype if None
+            (r8, rg8, rgb8, rgba8, rgba16f or rgba32f), a given one has to match them
+        validate : bool, optional
+            Default True. Only used by RGBAHalfSurface, see its __init__
+
+        Returns
+        -------
+        RGBASurface | list[RGBASurface]
+            The surface, or one surface per image of a batch
 
         Notes
         -----
-        Data layout is assumed to be 8-bit per channel RGBA (32bpp)
+        Views and crops work as they are, as long as the pixels of a row are contiguous,
+        the rows may be any number of bytes apart (up to 2 GiB).
+        The surfaces keep the array alive.
         """
         ...
 
@@ -57,10 +189,60 @@ class RGBASurface:
         """bytes: Raw pixel data bytes of the surface."""
         ...
 
+    @property
+    def pixel_format(self) -> PixelFormat | None:
+        """PixelFormat | None: Layout of the pixels, None if they're passed to the kernels as is."""
+        ...
+
     def __buffer__(self) -> memoryview:
         """memoryview: Memoryview interface to pixel data."""
         ...
 
+class RGBAHalfSurface(RGBASurface):
+    """
+    HDR surface for BC6H, RGBA half floats or float32.
+
+    The stride defaults to width*8 for half floats and width*16 for float32,
+    float32 data is converted to half block row by block row while compressing.
+    from_file defaults to half floats as well.
+    """
+
+    def __init__(
+        self,
+        src: ByteString | Buffer,
+        width: int | None = None,
+        height: int | None = None,
+        stride: int = 0,
+        pixel_format: Literal["rgba16f", "rgba32f"] | None = None,
+        validate: bool = True,
+    ) -> None:
+        """
+        Initialize an HDR surface from raw pixel data or an array.
+
+        Parameters
+        ----------
+        src : ByteString | Buffer
+            Raw RGBA half float or float32 pixel data,
+            or without width and height a float16 or float32 array of shape (H, W, 4)
+        width : int | None, optional
+            Surface width in pixels (>0)
+        height : int | None, optional
+            Surface height in pixels (>0)
+        stride : int, optional
+            Bytes per row (0 = width * bytes per pixel)
+        pixel_format : Literal["rgba16f", "rgba32f"] | None, optional
+            Default None. Layout of the pixels, 'rgba16f' for raw data and the dtype for arrays
+        validate : bool, optional
+            Default True. Check that all values are finite and >= 0,
+            which is all BC6H can encode, raises ValueError otherwise
+
+        Notes
+        -----
+        Without validation, float32 values are clamped to [0, 65504] when they're converted,
+        invalid half floats are passed to the kernel as is.
+        """
+        ...
+
 BC7EncProfile = Literal[
     "ultrafast",
     "veryfast",
@@ -99,6 +281,10 @@ class BC7EncSettings:
     -------
     from_profile(profile)
         Create settings from predefined profile
+    profiles()
+        Names of the predefined profiles
+    fingerprint()
+        Stable hash of the settings
     """
 
     skip_mode2: bool
@@ -166,6 +352,20 @@ class BC7EncSettings:
         """
         ...
 
+    @classmethod
+    def profiles(cls) -> list[BC7EncProfile]:
+        """Names of the profiles from_profile accepts, sorted."""
+        ...
+
+    def fingerprint(self) -> int:
+        """
+        A 64 bit hash of the settings fields.
+
+        Unlike hash(), it's the same in every process and on every platform,
+        so it can be part of persistent cache keys.
+        """
+        ...
+
 BC6HEncProfile = Literal[
     "fast",
     "veryfast",
@@ -195,6 +395,10 @@ class BC6HEncSettings:
     -------
     from_profile(profile)
         Create settings from predefined profile
+    profiles()
+        Names of the predefined profiles
+    fingerprint()
+        Stable hash of the settings
     """
 
     slow_mode: bool
@@ -251,6 +455,15 @@ class BC6HEncSettings:
         """
         ...
 
+    @classmethod
+    def profiles(cls) -> list[BC6HEncProfile]:
+        """Names of the profiles from_profile accepts, sorted."""
+        ...
+
+    def fingerprint(self) -> int:
+        """A 64 bit hash of the settings fields, see BC7EncSettings.fingerprint."""
+        ...
+
 ETCEncProfile = Literal["slow",]
 
 class ETCEncSettings:
@@ -266,6 +479,10 @@ class ETCEncSettings:
     -------
     from_profile(profile)
         Create settings from predefined profile
+    profiles()
+        Names of the predefined profiles
+    fingerprint()
+        Stable hash of the settings
     """
 
     fast_skip_threshold: int
@@ -297,6 +514,15 @@ class ETCEncSettings:
         """
         ...
 
+    @classmethod
+    def profiles(cls) -> list[ETCEncProfile]:
+        """Names of the profiles from_profile accepts, sorted."""
+        ...
+
+    def fingerprint(self) -> int:
+        """A 64 bit hash of the settings fields, see BC7EncSettings.fingerprint."""
+        ...
+
 ASTCEncProfile = Literal[
     "fast",
     "alpha_fast",
@@ -310,9 +536,9 @@ class ASTCEncSettings:
     Attributes
     ----------
     block_width : int
-        ASTC block width (4-12)
+        ASTC block width, see block_height
     block_height : int
-        ASTC block height (4-12)
+        ASTC block height, valid footprints are 4x4, 5x4, 5x5, 6x5, 6x6, 8x5, 8x6 and 8x8
     channels : int
         Color channels (3=RGB, 4=RGBA)
     fast_skip_threshold : int
@@ -324,6 +550,12 @@ class ASTCEncSettings:
     -------
     from_profile(profile, block_width, block_height)
         Create settings from predefined profile
+    profiles()
+        Names of the predefined profiles
+    block_sizes()
+        Valid block footprints
+    fingerprint()
+        Stable hash of the settings
     """
 
     block_width: int
@@ -346,9 +578,9 @@ class ASTCEncSettings:
         Parameters
         ----------
         block_width : int
-            ASTC block width (4-12)
+            ASTC block width, see block_height
         block_height : int
-            ASTC block height (4-12)
+            ASTC block height, valid footprints are 4x4, 5x4, 5x5, 6x5, 6x6, 8x5, 8x6 and 8x8
         channels : int
             Color channels (3 or 4)
         fast_skip_threshold : int
@@ -372,9 +604,9 @@ class ASTCEncSettings:
             - 'alpha_fast': Textures with Alpha channel (fast)
             - 'alpha_slow': Textures with Alpha channel (high quality)
         block_width : int
-            ASTC block width (4-8)
+            ASTC block width, see block_height
         block_height : int
-            ASTC block height (4-8)
+            ASTC block height, valid footprints are 4x4, 5x4, 5x5, 6x5, 6x6, 8x5, 8x6 and 8x8
 
         Returns
         -------
@@ -383,7 +615,28 @@ class ASTCEncSettings:
         """
         ...
 
-def compress_blocks_bc1(rgba: RGBASurface) -> bytes:
+    @classmethod
+    def profiles(cls) -> list[ASTCEncProfile]:
+        """Names of the profiles from_profile accepts, sorted."""
+        ...
+
+    @classmethod
+    def block_sizes(cls) -> list[tuple[int, int]]:
+        """The valid (block_width, block_height) footprints."""
+        ...
+
+    def fingerprint(self) -> int:
+        """A 64 bit hash of the settings fields, see BC7EncSettings.fingerprint."""
+        ...
+
+def compress_blocks_bc1(
+    rgba: RGBASurface,
+    *,
+    threads: int = 1,
+    return_metrics: bool = False,
+    block_errors: bool = False,
+    cache: BlockCache | None = None,
+) -> bytes | tuple[bytes, EncodeMetrics]:
     """
     Compress to BC1 format (DXT1 equivalent).
 
@@ -391,11 +644,21 @@ def compress_blocks_bc1(rgba: RGBASurface) -> bytes:
     ----------
     rgba : RGBASurface
         Input RGBA surface (alpha channel ignored)
+    threads : int, optional
+        Default 1. Number of threads the block rows are split across (0=all pool workers)
+    return_metrics : bool, optional
+        Default False. Decode each block row right after compressing it and return the error metrics as well
+    block_errors : bool, optional
+        Default False. Add the mean squared error of each block to the metrics
+    cache : BlockCache | None, optional
+        Default None. Reuse the blocks of identical texels compressed with the same settings
 
     Returns
     -------
     bytes
         Compressed BC1 texture data
+    tuple[bytes, EncodeMetrics]
+        The data and its error metrics if return_metrics is set
 
     Notes
     -----
@@ -404,7 +667,14 @@ def compress_blocks_bc1(rgba: RGBASurface) -> bytes:
     """
     ...
 
-def compress_blocks_bc3(rgba: RGBASurface) -> bytes:
+def compress_blocks_bc3(
+    rgba: RGBASurface,
+    *,
+    threads: int = 1,
+    return_metrics: bool = False,
+    block_errors: bool = False,
+    cache: BlockCache | None = None,
+) -> bytes | tuple[bytes, EncodeMetrics]:
     """
     Compress to BC3 format (DXT5 equivalent).
 
@@ -412,11 +682,21 @@ def compress_blocks_bc3(rgba: RGBASurface) -> bytes:
     ----------
     rgba : RGBASurface
         Input RGBA surface
+    threads : int, optional
+        Default 1. Number of threads the block rows are split across (0=all pool workers)
+    return_metrics : bool, optional
+        Default False. Decode each block row right after compressing it and return the error metrics as well
+    block_errors : bool, optional
+        Default False. Add the mean squared error of each block to the metrics
+    cache : BlockCache | None, optional
+        Default None. Reuse the blocks of identical texels compressed with the same settings
 
     Returns
     -------
     bytes
         Compressed BC3 texture data
+    tuple[bytes, EncodeMetrics]
+        The data and its error metrics if return_metrics is set
 
     Notes
     -----
@@ -425,7 +705,14 @@ def compress_blocks_bc3(rgba: RGBASurface) -> bytes:
     """
     ...
 
-def compress_blocks_bc4(rgba: RGBASurface) -> bytes:
+def compress_blocks_bc4(
+    rgba: RGBASurface,
+    *,
+    threads: int = 1,
+    return_metrics: bool = False,
+    block_errors: bool = False,
+    cache: BlockCache | None = None,
+) -> bytes | tuple[bytes, EncodeMetrics]:
     """
     Compress to BC4 format (single-channel).
 
@@ -433,11 +720,21 @@ def compress_blocks_bc4(rgba: RGBASurface) -> bytes:
     ----------
     rgba : RGBASurface
         Input surface (uses red channel)
+    threads : int, optional
+        Default 1. Number of threads the block rows are split across (0=all pool workers)
+    return_metrics : bool, optional
+        Default False. Decode each block row right after compressing it and return the error metrics as well
+    block_errors : bool, optional
+        Default False. Add the mean squared error of each block to the metrics
+    cache : BlockCache | None, optional
+        Default None. Reuse the blocks of identical texels compressed with the same settings
 
     Returns
     -------
     bytes
         Compressed BC4 texture data
+    tuple[bytes, EncodeMetrics]
+        The data and its error metrics if return_metrics is set
 
     Notes
     -----
@@ -446,7 +743,14 @@ def compress_blocks_bc4(rgba: RGBASurface) -> bytes:
     """
     ...
 
-def compress_blocks_bc5(rgba: RGBASurface) -> bytes:
+def compress_blocks_bc5(
+    rgba: RGBASurface,
+    *,
+    threads: int = 1,
+    return_metrics: bool = False,
+    block_errors: bool = False,
+    cache: BlockCache | None = None,
+) -> bytes | tuple[bytes, EncodeMetrics]:
     """
     Compress to BC5 format (dual-channel).
 
@@ -454,11 +758,21 @@ def compress_blocks_bc5(rgba: RGBASurface) -> bytes:
     ----------
     rgba : RGBASurface
         Input surface (uses red/green channels)
+    threads : int, optional
+        Default 1. Number of threads the block rows are split across (0=all pool workers)
+    return_metrics : bool, optional
+        Default False. Decode each block row right after compressing it and return the error metrics as well
+    block_errors : bool, optional
+        Default False. Add the mean squared error of each block to the metrics
+    cache : BlockCache | None, optional
+        Default None. Reuse the blocks of identical texels compressed with the same settings
 
     Returns
     -------
     bytes
         Compressed BC5 texture data
+    tuple[bytes, EncodeMetrics]
+        The data and its error metrics if return_metrics is set
 
     Notes
     -----
@@ -467,7 +781,15 @@ def compress_blocks_bc5(rgba: RGBASurface) -> bytes:
     """
     ...
 
-def compress_blocks_bc6h(rgba: RGBASurface, settings: BC6HEncSettings) -> bytes:
+def compress_blocks_bc6h(
+    rgba: RGBASurface,
+    settings: BC6HEncSettings,
+    *,
+    threads: int = 1,
+    return_metrics: bool = False,
+    block_errors: bool = False,
+    cache: BlockCache | None = None,
+) -> bytes | tuple[bytes, EncodeMetrics]:
     """
     Compress an RGBA surface to BC6 texture blocks.
 
@@ -479,15 +801,33 @@ def compress_blocks_bc6h(rgba: RGBASurface, settings: BC6HEncSettings) -> bytes:
         Input RGBA surface to compress
     settings : BC6HEncSettings
         Compression configuration settings
+    threads : int, optional
+        Default 1. Number of threads the block rows are split across (0=all pool workers)
+    return_metrics : bool, optional
+        Default False. Decode each block row right after compressing it and return the error metrics as well
+    block_errors : bool, optional
+        Default False. Add the mean squared error of each block to the metrics
+    cache : BlockCache | None, optional
+        Default None. Reuse the blocks of identical texels compressed with the same settings
 
     Returns
     -------
     bytes
         Compressed texture data in BC6 format
+    tuple[bytes, EncodeMetrics]
+        The data and its error metrics if return_metrics is set
     """
     ...
 
-def compress_blocks_bc7(rgba: RGBASurface, settings: BC7EncSettings) -> bytes:
+def compress_blocks_bc7(
+    rgba: RGBASurface,
+    settings: BC7EncSettings,
+    *,
+    threads: int = 1,
+    return_metrics: bool = False,
+    block_errors: bool = False,
+    cache: BlockCache | None = None,
+) -> bytes | tuple[bytes, EncodeMetrics]:
     """
     Compress an RGBA surface to BC7 texture blocks.
 
@@ -497,15 +837,33 @@ def compress_blocks_bc7(rgba: RGBASurface, settings: BC7EncSettings) -> bytes:
         Input RGBA surface to compress
     settings : BC7EncSettings
         Compression configuration settings
+    threads : int, optional
+        Default 1. Number of threads the block rows are split across (0=all pool workers)
+    return_metrics : bool, optional
+        Default False. Decode each block row right after compressing it and return the error metrics as well
+    block_errors : bool, optional
+        Default False. Add the mean squared error of each block to the metrics
+    cache : BlockCache | None, optional
+        Default None. Reuse the blocks of identical texels compressed with the same settings
 
     Returns
     -------
     bytes
         Compressed texture data in BC7 format
+    tuple[bytes, EncodeMetrics]
+        The data and its error metrics if return_metrics is set
     """
     ...
 
-def compress_blocks_etc1(rgba: RGBASurface, settings: ETCEncSettings) -> bytes:
+def compress_blocks_etc1(
+    rgba: RGBASurface,
+    settings: ETCEncSettings,
+    *,
+    threads: int = 1,
+    return_metrics: bool = False,
+    block_errors: bool = False,
+    cache: BlockCache | None = None,
+) -> bytes | tuple[bytes, EncodeMetrics]:
     """
     Compress to ETC1 format.
 
@@ -515,11 +873,21 @@ def compress_blocks_etc1(rgba: RGBASurface, settings: ETCEncSettings) -> bytes:
         Input RGBA surface (alpha channel ignored)
     settings : ETCEncSettings
         Compression settings
+    threads : int, optional
+        Default 1. Number of threads the block rows are split across (0=all pool workers)
+    return_metrics : bool, optional
+        Default False. Decode each block row right after compressing it and return the error metrics as well
+    block_errors : bool, optional
+        Default False. Add the mean squared error of each block to the metrics
+    cache : BlockCache | None, optional
+        Default None. Reuse the blocks of identical texels compressed with the same settings
 
     Returns
     -------
     bytes
         Compressed ETC1 texture data
+    tuple[bytes, EncodeMetrics]
+        The data and its error metrics if return_metrics is set
 
     Notes
     -----
@@ -528,7 +896,15 @@ def compress_blocks_etc1(rgba: RGBASurface, settings: ETCEncSettings) -> bytes:
     """
     ...
 
-def compress_blocks_astc(rgba: RGBASurface, settings: ASTCEncSettings) -> bytes:
+def compress_blocks_astc(
+    rgba: RGBASurface,
+    settings: ASTCEncSettings,
+    *,
+    threads: int = 1,
+    return_metrics: bool = False,
+    block_errors: bool = False,
+    cache: BlockCache | None = None,
+) -> bytes | tuple[bytes, EncodeMetrics]:
     """
     Compress to ASTC format.
 
@@ -538,14 +914,1137 @@ def compress_blocks_astc(rgba: RGBASurface, settings: ASTCEncSettings) -> bytes:
         Input RGBA surface
     settings : ASTCEncSettings
         Compression settings with block configuration
+    threads : int, optional
+        Default 1. Number of threads the block rows are split across (0=all pool workers)
+    return_metrics : bool, optional
+        Default False. Decode each block row right after compressing it and return the error metrics as well
+    block_errors : bool, optional
+        Default False. Add the mean squared error of each block to the metrics
+    cache : BlockCache | None, optional
+        Default None. Reuse the blocks of identical texels compressed with the same settings
 
     Returns
     -------
     bytes
         Compressed ASTC texture data
+    tuple[bytes, EncodeMetrics]
+        The data and its error metrics if return_metrics is set
+
+    Notes
+    -----
+    - 4x4 to 8x8 block sizes, 16 bytes per block
+    """
+    ...
+
+def compress_blocks_bc1_into(
+    rgba: RGBASurface, out: Buffer, offset: int = 0, *, threads: int = 1
+) -> int:
+    """
+    Compress to BC1 format directly into a writable buffer.
+
+    Parameters
+    ----------
+    rgba : RGBASurface
+        Input RGBA surface
+    out : Buffer
+        Writable, contiguous buffer, e.g. bytearray, memoryview, numpy array or mmap
+    offset : int, optional
+        Default 0. Byte offset of the first block within out
+    threads : int, optional
+        Default 1. Number of threads the block rows are split across (0=all pool workers)
+
+    Returns
+    -------
+    int
+        Number of bytes written
+    """
+    ...
+
+def compress_blocks_bc3_into(
+    rgba: RGBASurface, out: Buffer, offset: int = 0, *, threads: int = 1
+) -> int:
+    """
+    Compress to BC3 format directly into a writable buffer.
+
+    Parameters
+    ----------
+    rgba : RGBASurface
+        Input RGBA surface
+    out : Buffer
+        Writable, contiguous buffer, e.g. bytearray, memoryview, numpy array or mmap
+    offset : int, optional
+        Default 0. Byte offset of the first block within out
+    threads : int, optional
+        Default 1. Number of threads the block rows are split across (0=all pool workers)
+
+    Returns
+    -------
+    int
+        Number of bytes written
+    """
+    ...
+
+def compress_blocks_bc4_into(
+    rgba: RGBASurface, out: Buffer, offset: int = 0, *, threads: int = 1
+) -> int:
+    """
+    Compress to BC4 format directly into a writable buffer.
+
+    Parameters
+    ----------
+    rgba : RGBASurface
+        Input RGBA surface
+    out : Buffer
+        Writable, contiguous buffer, e.g. bytearray, memoryview, numpy array or mmap
+    offset : int, optional
+        Default 0. Byte offset of the first block within out
+    threads : int, optional
+        Default 1. Number of threads the block rows are split across (0=all pool workers)
+
+    Returns
+    -------
+    int
+        Number of bytes written
+    """
+    ...
+
+def compress_blocks_bc5_into(
+    rgba: RGBASurface, out: Buffer, offset: int = 0, *, threads: int = 1
+) -> int:
+    """
+    Compress to BC5 format directly into a writable buffer.
+
+    Parameters
+    ----------
+    rgba : RGBASurface
+        Input RGBA surface
+    out : Buffer
+        Writable, contiguous buffer, e.g. bytearray, memoryview, numpy array or mmap
+    offset : int, optional
+        Default 0. Byte offset of the first block within out
+    threads : int, optional
+        Default 1. Number of threads the block rows are split across (0=all pool workers)
+
+    Returns
+    -------
+    int
+        Number of bytes written
+    """
+    ...
+
+def compress_blocks_bc6h_into(
+    rgba: RGBASurface,
+    settings: BC6HEncSettings,
+    out: Buffer,
+    offset: int = 0,
+    *,
+    threads: int = 1,
+) -> int:
+    """
+    Compress to BC6H format directly into a writable buffer.
+
+    Parameters
+    ----------
+    rgba : RGBASurface
+        Input RGBA surface
+    settings : BC6HEncSettings
+        Compression configuration settings
+    out : Buffer
+        Writable, contiguous buffer, e.g. bytearray, memoryview, numpy array or mmap
+    offset : int, optional
+        Default 0. Byte offset of the first block within out
+    threads : int, optional
+        Default 1. Number of threads the block rows are split across (0=all pool workers)
+
+    Returns
+    -------
+    int
+        Number of bytes written
+    """
+    ...
+
+def compress_blocks_bc7_into(
+    rgba: RGBASurface,
+    settings: BC7EncSettings,
+    out: Buffer,
+    offset: int = 0,
+    *,
+    threads: int = 1,
+) -> int:
+    """
+    Compress to BC7 format directly into a writable buffer.
+
+    Parameters
+    ----------
+    rgba : RGBASurface
+        Input RGBA surface
+    settings : BC7EncSettings
+        Compression configuration settings
+    out : Buffer
+        Writable, contiguous buffer, e.g. bytearray, memoryview, numpy array or mmap
+    offset : int, optional
+        Default 0. Byte offset of the first block within out
+    threads : int, optional
+        Default 1. Number of threads the block rows are split across (0=all pool workers)
+
+    Returns
+    -------
+    int
+        Number of bytes written
+    """
+    ...
+
+def compress_blocks_etc1_into(
+    rgba: RGBASurface,
+    settings: ETCEncSettings,
+    out: Buffer,
+    offset: int = 0,
+    *,
+    threads: int = 1,
+) -> int:
+    """
+    Compress to ETC1 format directly into a writable buffer.
+
+    Parameters
+    ----------
+    rgba : RGBASurface
+        Input RGBA surface
+    settings : ETCEncSettings
+        Compression configuration settings
+    out : Buffer
+        Writable, contiguous buffer, e.g. bytearray, memoryview, numpy array or mmap
+    offset : int, optional
+        Default 0. Byte offset of the first block within out
+    threads : int, optional
+        Default 1. Number of threads the block rows are split across (0=all pool workers)
+
+    Returns
+    -------
+    int
+        Number of bytes written
+    """
+    ...
+
+def compress_blocks_astc_into(
+    rgba: RGBASurface,
+    settings: ASTCEncSettings,
+    out: Buffer,
+    offset: int = 0,
+    *,
+    threads: int = 1,
+) -> int:
+    """
+    Compress to ASTC format directly into a writable buffer.
+
+    Parameters
+    ----------
+    rgba : RGBASurface
+        Input RGBA surface
+    settings : ASTCEncSettings
+        Compression configuration settings
+    out : Buffer
+        Writable, contiguous buffer, e.g. bytearray, memoryview, numpy array or mmap
+    offset : int, optional
+        Default 0. Byte offset of the first block within out
+    threads : int, optional
+        Default 1. Number of threads the block rows are split across (0=all pool workers)
+
+    Returns
+    -------
+    int
+        Number of bytes written
+    """
+    ...
+
+def decompress_blocks_bc1(data: Buffer, rgba: RGBASurface, *, threads: int = 1) -> None:
+    """
+    Decompress BC1 blocks into an existing surface.
+
+    Parameters
+    ----------
+    data : Buffer
+        Compressed BC1 blocks covering the surface
+    rgba : RGBASurface
+        Writable output surface, its size determines the number of blocks
+    threads : int, optional
+        Default 1. Number of threads the block rows are split across (0=all pool workers)
+
+    Notes
+    -----
+    - Decodes to RGBA, BC1 punch-through alpha decodes to transparent black, converted to the pixel_format of the surface
+    """
+    ...
+
+def decompress_blocks_bc3(data: Buffer, rgba: RGBASurface, *, threads: int = 1) -> None:
+    """
+    Decompress BC3 blocks into an existing surface.
+
+    Parameters
+    ----------
+    data : Buffer
+        Compressed BC3 blocks covering the surface
+    rgba : RGBASurface
+        Writable output surface, its size determines the number of blocks
+    threads : int, optional
+        Default 1. Number of threads the block rows are split across (0=all pool workers)
+
+    Notes
+    -----
+    - Decodes to RGBA, converted to the pixel_format of the surface
+    """
+    ...
+
+def decompress_blocks_bc4(data: Buffer, rgba: RGBASurface, *, threads: int = 1) -> None:
+    """
+    Decompress BC4 blocks into an existing surface.
+
+    Parameters
+    ----------
+    data : Buffer
+        Compressed BC4 blocks covering the surface
+    rgba : RGBASurface
+        Writable output surface, its size determines the number of blocks
+    threads : int, optional
+        Default 1. Number of threads the block rows are split across (0=all pool workers)
+
+    Notes
+    -----
+    - Decodes to R8 unless the surface has a pixel_format, converted to the pixel_format of the surface
+    """
+    ...
+
+def decompress_blocks_bc5(data: Buffer, rgba: RGBASurface, *, threads: int = 1) -> None:
+    """
+    Decompress BC5 blocks into an existing surface.
+
+    Parameters
+    ----------
+    data : Buffer
+        Compressed BC5 blocks covering the surface
+    rgba : RGBASurface
+        Writable output surface, its size determines the number of blocks
+    threads : int, optional
+        Default 1. Number of threads the block rows are split across (0=all pool workers)
+
+    Notes
+    -----
+    - Decodes to RG8 unless the surface has a pixel_format, converted to the pixel_format of the surface
+    """
+    ...
+
+def decompress_blocks_bc6h(data: Buffer, rgba: RGBASurface, *, threads: int = 1) -> None:
+    """
+    Decompress BC6H blocks into an existing surface.
+
+    Parameters
+    ----------
+    data : Buffer
+        Compressed BC6H blocks covering the surface
+    rgba : RGBASurface
+        Writable output surface, its size determines the number of blocks
+    threads : int, optional
+        Default 1. Number of threads the block rows are split across (0=all pool workers)
 
     Notes
     -----
-    - 4x4 to 8x8 block sizes
+    - Decodes to unsigned (UF16) RGB half floats with an alpha of 1.0, RGBA half floats unless the surface has a pixel_format, converted to the pixel_format of the surface
+    """
+    ...
+
+def decompress_blocks_bc7(data: Buffer, rgba: RGBASurface, *, threads: int = 1) -> None:
     """
+    Decompress BC7 blocks into an existing surface.
+
+    Parameters
+    ----------
+    data : Buffer
+        Compressed BC7 blocks covering the surface
+    rgba : RGBASurface
+        Writable output surface, its size determines the number of blocks
+    threads : int, optional
+        Default 1. Number of threads the block rows are split across (0=all pool workers)
+
+    Notes
+    -----
+    - Decodes to RGBA, converted to the pixel_format of the surface
+    """
+    ...
+
+def decompress_blocks_etc1(data: Buffer, rgba: RGBASurface, *, threads: int = 1) -> None:
+    """
+    Decompress ETC1 blocks into an existing surface.
+
+    Parameters
+    ----------
+    data : Buffer
+        Compressed ETC1 blocks covering the surface
+    rgba : RGBASurface
+        Writable output surface, its size determines the number of blocks
+    threads : int, optional
+        Default 1. Number of threads the block rows are split across (0=all pool workers)
+
+    Notes
+    -----
+    - Decodes to RGB with an alpha of 255, converted to the pixel_format of the surface
+    """
+    ...
+
+def decompress_blocks_astc(
+    data: Buffer,
+    rgba: RGBASurface,
+    block_width: int,
+    block_height: int,
+    *,
+    threads: int = 1,
+) -> None:
+    """
+    Decompress ASTC blocks into an existing surface.
+
+    Parameters
+    ----------
+    data : Buffer
+        Compressed ASTC blocks covering the surface
+    rgba : RGBASurface
+        Writable output surface, its size determines the number of blocks
+    block_width : int
+        ASTC block width, see block_height
+    block_height : int
+        ASTC block height, all 2D footprints from 4x4 up to 12x12 are valid
+    threads : int, optional
+        Default 1. Number of threads the block rows are split across (0=all pool workers)
+
+    Notes
+    -----
+    - LDR profile only, HDR and invalid blocks decode to magenta
+    """
+    ...
+
+TextureFormat = Literal["bc1", "bc3", "bc4", "bc5", "bc6h", "bc7", "etc1", "astc"]
+
+EncSettings = BC6HEncSettings | BC7EncSettings | ETCEncSettings | ASTCEncSettings
+
+@overload
+def compress_batch(
+    format: TextureFormat,
+    surfaces: Sequence[RGBASurface],
+    settings: EncSettings | None = None,
+    *,
+    threads: int = 1,
+    contiguous: Literal[False] = False,
+) -> list[bytes]: ...
+@overload
+def compress_batch(
+    format: TextureFormat,
+    surfaces: Sequence[RGBASurface],
+    settings: EncSettings | None = None,
+    *,
+    threads: int = 1,
+    contiguous: Literal[True],
+) -> tuple[bytes, list[int]]: ...
+def compress_batch(
+    format: TextureFormat,
+    surfaces: Sequence[RGBASurface],
+    settings: EncSettings | None = None,
+    *,
+    threads: int = 1,
+    contiguous: bool = False,
+) -> list[bytes] | tuple[bytes, list[int]]:
+    """
+    Compress multiple surfaces to the same format with a single call.
+
+    The GIL is released once for the whole batch,
+    and the block rows of all surfaces are spread across the threads.
+
+    Parameters
+    ----------
+    format : TextureFormat
+        Target format, e.g. 'bc7' or 'astc'
+    surfaces : Sequence[RGBASurface]
+        Input surfaces, e.g. texture array layers, cubemap faces or sprites
+    settings : EncSettings | None, optional
+        Settings matching the format, None for bc1/bc3/bc4/bc5
+    threads : int, optional
+        Default 1. Number of threads the block rows are split across (0=all pool workers)
+    contiguous : bool, optional
+        Default False. Return one buffer and the offsets of the surfaces within it
+
+    Returns
+    -------
+    list[bytes] | tuple[bytes, list[int]]
+        Compressed data per surface, or the contiguous data and offsets
+    """
+    ...
+
+class BlockCache:
+    """
+    Compressed blocks by their source texels, to skip compressing duplicate blocks again.
+
+    The cache can be shared by calls of any format, settings and thread,
+    the blocks are keyed by a hash of their texels and a fingerprint of the format and settings.
+    The texels are compared on every hit, so a hash collision can't return a wrong block.
+    Solid color blocks are keyed by their color alone.
+
+    Attributes
+    ----------
+    hits : int
+        The number of blocks taken from the cache
+    misses : int
+        The number of blocks that had to be compressed
+    size : int
+        The number of cached blocks
+    max_blocks : int
+        The number of blocks the cache is cleared at
+    """
+
+    def __init__(self, max_blocks: int = 1048576) -> None:
+        """
+        Initialize an empty cache.
+
+        Parameters
+        ----------
+        max_blocks : int, optional
+            Default 1048576. The cache is cleared once it holds this many blocks (>0)
+        """
+        ...
+
+    @property
+    def hits(self) -> int: ...
+    @property
+    def misses(self) -> int: ...
+    @property
+    def size(self) -> int: ...
+    @property
+    def max_blocks(self) -> int: ...
+    def clear(self) -> None:
+        """Drop all cached blocks and reset the counters."""
+        ...
+
+class EncodeCache:
+    """
+    A directory of compressed textures, to skip compressing unchanged textures again, e.g. in incremental builds.
+
+    Each entry is a file named after a BLAKE2b-256 digest of the pixels (without stride padding),
+    the geometry, the pixel format, the format and the fingerprint of the settings.
+    Its header repeats all of them, so that stale or damaged files are treated as misses.
+    Entries are written to a temporary file first and moved into place,
+    so the directory can be shared by concurrent processes.
+    Storing is best effort, the blocks are returned even if they couldn't be written, e.g. on a full disk.
+
+    Attributes
+    ----------
+    directory : str
+        The cache directory, created if it doesn't exist
+    hits : int
+        The number of textures read from the cache by this object
+    misses : int
+        The number of textures compressed by this object
+    store_failures : int
+        The number of compressed textures this object couldn't write to the directory
+    """
+
+    directory: str
+    hits: int
+    misses: int
+    store_failures: int
+
+    def __init__(self, directory: str | bytes | PathLike) -> None: ...
+    def compress(
+        self,
+        rgba: RGBASurface,
+        format: TextureFormat,
+        settings: EncSettings | None = None,
+        *,
+        threads: int = 1,
+    ) -> bytes:
+        """
+        Return the cached blocks of the surface, compressing and storing them on a miss.
+
+        Parameters
+        ----------
+        rgba : RGBASurface
+            Input surface
+        format : TextureFormat
+            Target format, e.g. 'bc7' or 'astc'
+        settings : EncSettings | None, optional
+            Settings matching the format, None for bc1/bc3/bc4/bc5
+        threads : int, optional
+            Default 1. Number of threads the block rows are split across on a miss (0=all pool workers)
+
+        Returns
+        -------
+        bytes
+            Compressed texture data
+        """
+        ...
+
+class Encoder:
+    """
+    Compresses frames of a fixed size into the same output buffer, for video and capture streams.
+
+    The format and settings are validated once and the output buffer is allocated once,
+    so encoding a frame doesn't allocate anything but the returned memoryview.
+    The encoder itself is a read-only buffer of the last compressed frame.
+
+    Attributes
+    ----------
+    width : int
+        The width of the frames in pixels
+    height : int
+        The height of the frames in pixels
+    size : int
+        The size of a compressed frame in bytes
+    block_width : int
+        The block width of the format
+    block_height : int
+        The block height of the format
+    """
+
+    width: int
+    height: int
+    size: int
+
+    def __init__(
+        self,
+        format: TextureFormat,
+        width: int,
+        height: int,
+        settings: EncSettings | None = None,
+        *,
+        threads: int = 1,
+    ) -> None:
+        """
+        Initialize an encoder.
+
+        Parameters
+        ----------
+        format : TextureFormat
+            Target format, e.g. 'bc1' or 'etc1'
+        width : int
+            Frame width in pixels (>0)
+        height : int
+            Frame height in pixels (>0)
+        settings : EncSettings | None, optional
+            Settings matching the format, None for bc1/bc3/bc4/bc5
+        threads : int, optional
+            Default 1. Number of threads the block rows of a frame are split across (0=all pool workers)
+        """
+        ...
+
+    @property
+    def block_width(self) -> int: ...
+    @property
+    def block_height(self) -> int: ...
+    def encode(self, surface: RGBASurface) -> memoryview:
+        """
+        Compress a frame into the output buffer.
+
+        Parameters
+        ----------
+        surface : RGBASurface
+            The frame, width x height in any pixel format
+
+        Returns
+        -------
+        memoryview
+            Read-only view of the compressed frame
+
+        Notes
+        -----
+        The view shares the output buffer, so the next encode call overwrites what it shows.
+        Copy it, e.g. with bytes(view), to keep a frame around.
+        The encoder can't be reinitialized while views of it exist.
+        """
+        ...
+
+    def __buffer__(self) -> memoryview:
+        """memoryview: Read-only memoryview of the last compressed frame."""
+        ...
+
+class StreamEncoder:
+    """
+    Compresses an image band by band, for images too large to hold in memory.
+
+    Bands are compressed as they are fed, so only one band of pixels
+    and its compressed block rows have to be in memory at a time.
+
+    Attributes
+    ----------
+    width : int
+        The width of the image in pixels
+    height : int
+        The height of the image in pixels
+    rows_done : int
+        The number of rows fed so far
+    rows_remaining : int
+        The number of rows still to be fed
+    block_height : int
+        The block height of the format, every band except the last one has to be a multiple of it
+    """
+
+    width: int
+    height: int
+    rows_done: int
+
+    def __init__(
+        self,
+        format: TextureFormat,
+        width: int,
+        height: int,
+        settings: EncSettings | None = None,
+        sink: Callable[[bytes], object] | None = None,
+        *,
+        threads: int = 1,
+        pixel_format: PixelFormat | None = None,
+    ) -> None:
+        """
+        Initialize a stream encoder.
+
+        Parameters
+        ----------
+        format : TextureFormat
+            Target format, e.g. 'bc7' or 'astc'
+        width : int
+            Image width in pixels (>0)
+        height : int
+            Image height in pixels (>0)
+        settings : EncSettings | None, optional
+            Settings matching the format, None for bc1/bc3/bc4/bc5
+        sink : Callable[[bytes], object] | None, optional
+            Receives the compressed block rows of each band,
+            a file-like object gets its write method called.
+            None makes feed return them instead
+        threads : int, optional
+            Default 1. Number of threads the block rows of a band are split across (0=all pool workers)
+        pixel_format : PixelFormat | None, optional
+            Default None. Layout of the fed pixels, see RGBASurface
+        """
+        ...
+
+    @property
+    def rows_remaining(self) -> int: ...
+    @property
+    def block_height(self) -> int: ...
+    def feed(self, rows: Buffer, stride: int = 0) -> bytes | None:
+        """
+        Compress the next band of rows.
+
+        Parameters
+        ----------
+        rows : Buffer
+            Pixel data of the band in the pixel format, or the input layout of the format without one.
+            Its height has to be a multiple of block_height, except for the last band
+        stride : int, optional
+            Bytes per row (0 = width * bytes per pixel), the last row doesn't need its padding
+
+        Returns
+        -------
+        bytes | None
+            Compressed block rows of the band, None if they were passed to the sink
+
+        Notes
+        -----
+        The output of all bands concatenated is the same as compressing the whole image at once.
+        """
+        ...
+
+def compress_mip_chain(
+    rgba: RGBASurface,
+    format: TextureFormat,
+    settings: EncSettings | None = None,
+    filter: Literal["box", "kaiser"] = "box",
+    srgb: bool = True,
+    *,
+    levels: int = 0,
+    threads: int = 1,
+) -> tuple[bytes, list[int]]:
+    """
+    Generate the mip chain of a surface and compress all of its levels.
+
+    Each level is half the size of the previous one (rounded down, at least 1).
+    With threads != 1 the next level is downsampled
+    while the pool compresses the block rows of the previous one.
+
+    Parameters
+    ----------
+    rgba : RGBASurface
+        Input surface, level 0 of the chain
+    format : TextureFormat
+        Target format, e.g. 'bc7' or 'astc'
+    settings : EncSettings | None, optional
+        Settings matching the format, None for bc1/bc3/bc4/bc5
+    filter : Literal["box", "kaiser"], optional
+        Default 'box'. Downsampling filter, 'kaiser' is sharper but slower
+    srgb : bool, optional
+        Default True. Filter the RGB channels of RGBA8 data in linear space
+    levels : int, optional
+        Default 0. Number of levels (0=full chain down to 1x1)
+    threads : int, optional
+        Default 1. Number of threads the block rows are split across (0=all pool workers)
+
+    Returns
+    -------
+    tuple[bytes, list[int]]
+        Compressed data of all levels and the offset of each level within it
+    """
+    ...
+
+def compress_to_file(
+    rgba: RGBASurface,
+    format: TextureFormat,
+    path: str | bytes | PathLike,
+    settings: EncSettings | None = None,
+    offset: int = 0,
+    *,
+    threads: int = 1,
+) -> int:
+    """
+    Compress a surface straight into a file.
+
+    The range of the file is memory mapped and the blocks are written into it directly.
+    The file is created if it doesn't exist and extended if it's too small,
+    the data outside of the range is left as is.
+
+    Parameters
+    ----------
+    rgba : RGBASurface
+        Input surface
+    format : TextureFormat
+        Target format, e.g. 'bc7' or 'astc'
+    path : str | bytes | PathLike
+        Path of the output file
+    settings : EncSettings | None, optional
+        Settings matching the format, None for bc1/bc3/bc4/bc5
+    offset : int, optional
+        Default 0. Position of the first block in the file, e.g. behind a header
+    threads : int, optional
+        Default 1. Number of threads the block rows are split across (0=all pool workers)
+
+    Returns
+    -------
+    int
+        Number of bytes written
+    """
+    ...
+
+def compress_region(
+    rgba: RGBASurface,
+    format: TextureFormat,
+    rect: tuple[int, int, int, int],
+    out: Buffer,
+    settings: EncSettings | None = None,
+    offset: int = 0,
+    *,
+    threads: int = 1,
+) -> tuple[int, int, int, int]:
+    """
+    Recompress the blocks covering a changed rectangle into the existing compressed data of the surface.
+
+    Only the blocks overlapping the rectangle are compressed and written,
+    so the cost of an edit depends on its size rather than on the size of the texture.
+    The blocks come out the same as if the whole surface was compressed again.
+
+    Parameters
+    ----------
+    rgba : RGBASurface
+        The changed surface
+    format : TextureFormat
+        Format of the compressed data, e.g. 'bc7' or 'astc'
+    rect : tuple[int, int, int, int]
+        Changed pixels as (x, y, width, height), clipped to the surface
+    out : Buffer
+        Writable buffer holding the compressed surface, e.g. a bytearray or a mmap
+    settings : EncSettings | None, optional
+        Settings matching the format, None for bc1/bc3/bc4/bc5
+    offset : int, optional
+        Default 0. Position of the first block of the surface in out
+    threads : int, optional
+        Default 1. Number of threads the block rows are split across (0=all pool workers)
+
+    Returns
+    -------
+    tuple[int, int, int, int]
+        The rewritten pixels as (x, y, width, height), rect grown to whole blocks,
+        e.g. to upload only them to the GPU
+    """
+    ...
+
+def write_dds(
+    surfaces: RGBASurface | Sequence[RGBASurface],
+    format: TextureFormat,
+    settings: EncSettings | None = None,
+    *,
+    levels: int = 1,
+    filter: Literal["box", "kaiser"] = "box",
+    srgb: bool = True,
+    threads: int = 1,
+    out: Buffer | str | bytes | PathLike | None = None,
+    offset: int = 0,
+) -> bytes | int:
+    """
+    Compress surfaces with their mip chains into a DDS file.
+
+    The header and all levels are written into a single buffer in one pass.
+    The legacy header is used for bc1, bc3, bc4 and bc5 textures,
+    the DX10 header for arrays, sRGB data and the other formats.
+    The layers are stored one after the other, each with all its levels.
+    ETC1 can't be stored in DDS.
+
+    Parameters
+    ----------
+    surfaces : RGBASurface | Sequence[RGBASurface]
+        A surface for a plain texture, a sequence of surfaces of the same size for a texture array
+    format : TextureFormat
+        Target format, e.g. 'bc7' or 'astc'
+    settings : EncSettings | None, optional
+        Settings matching the format, None for bc1/bc3/bc4/bc5
+    levels : int, optional
+        Default 1. Number of mip levels (0=full chain down to 1x1)
+    filter : Literal["box", "kaiser"], optional
+        Default 'box'. Downsampling filter of the mip levels
+    srgb : bool, optional
+        Default True. The RGBA8 data is sRGB, it's filtered in linear space
+        and tagged as sRGB if the format has a sRGB variant
+    threads : int, optional
+        Default 1. Number of threads the block rows are split across (0=all pool workers)
+    out : Buffer | str | bytes | PathLike | None, optional
+        Default None. Writable buffer or path of the file to write to, None to return a new bytes object
+    offset : int, optional
+        Default 0. Byte offset within out
+
+    Returns
+    -------
+    bytes | int
+        The file, or its size if it was written to out
+    """
+    ...
+
+def write_ktx2(
+    surfaces: RGBASurface | Sequence[RGBASurface],
+    format: TextureFormat,
+    settings: EncSettings | None = None,
+    *,
+    levels: int = 1,
+    filter: Literal["box", "kaiser"] = "box",
+    srgb: bool = True,
+    threads: int = 1,
+    out: Buffer | str | bytes | PathLike | None = None,
+    offset: int = 0,
+) -> bytes | int:
+    """
+    Compress surfaces with their mip chains into a KTX2 file.
+
+    The header, the data format descriptor and all levels are written into a single buffer in one pass,
+    without supercompression. The levels are stored from the smallest to the largest one, each with all layers.
+    ETC1 is stored as the ETC2 RGB format it's a subset of.
+
+    Parameters
+    ----------
+    surfaces : RGBASurface | Sequence[RGBASurface]
+        A surface for a plain texture, a sequence of surfaces of the same size for a texture array
+    format : TextureFormat
+        Target format, e.g. 'bc7' or 'astc'
+    settings : EncSettings | None, optional
+        Settings matching the format, None for bc1/bc3/bc4/bc5
+    levels : int, optional
+        Default 1. Number of mip levels (0=full chain down to 1x1)
+    filter : Literal["box", "kaiser"], optional
+        Default 'box'. Downsampling filter of the mip levels
+    srgb : bool, optional
+        Default True. The RGBA8 data is sRGB, it's filtered in linear space
+        and tagged as sRGB if the format has a sRGB variant
+    threads : int, optional
+        Default 1. Number of threads the block rows are split across (0=all pool workers)
+    out : Buffer | str | bytes | PathLike | None, optional
+        Default None. Writable buffer or path of the file to write to, None to return a new bytes object
+    offset : int, optional
+        Default 0. Byte offset within out
+
+    Returns
+    -------
+    bytes | int
+        The file, or its size if it was written to out
+    """
+    ...
+
+def compress_adaptive(
+    rgba: RGBASurface,
+    format: Literal["bc6h", "bc7", "etc1", "astc"],
+    fast: EncSettings,
+    slow: EncSettings,
+    threshold: float,
+    *,
+    threads: int = 1,
+) -> tuple[bytes, int]:
+    """
+    Compress with fast settings, then compress the blocks with a high error again with slow settings.
+
+    Each block row is compressed with fast and decoded again right away,
+    the blocks with a mean squared error above threshold are compressed again with slow in place.
+    This gets close to the quality of slow at close to the cost of fast, as most blocks come out the same.
+
+    Parameters
+    ----------
+    rgba : RGBASurface
+        Input surface
+    format : Literal["bc6h", "bc7", "etc1", "astc"]
+        Target format
+    fast : EncSettings
+        Settings of the first pass, e.g. BC7EncSettings.from_profile("fast")
+    slow : EncSettings
+        Settings of the second pass, ASTC settings need the block dimensions of fast
+    threshold : float
+        Mean squared error per channel of a block above which it's compressed again,
+        see the block_mse of return_metrics
+    threads : int, optional
+        Default 1. Number of threads the block rows are split across (0=all pool workers)
+
+    Returns
+    -------
+    tuple[bytes, int]
+        Compressed data and the number of blocks compressed with slow
+    """
+    ...
+
+def compress_async(
+    rgba: RGBASurface,
+    format: TextureFormat,
+    settings: EncSettings | None = None,
+    *,
+    threads: int = 0,
+) -> Future[bytes]:
+    """
+    Compress on the shared thread pool without blocking the caller.
+
+    The block rows are queued on the pool and the returned future is completed
+    by the worker finishing the last one, its done callbacks run on that worker.
+    asyncio code can await it via asyncio.wrap_future.
+    Pending jobs are waited for at interpreter exit.
+
+    Parameters
+    ----------
+    rgba : RGBASurface
+        Input surface, referenced until the job is done
+    format : TextureFormat
+        Target format, e.g. 'bc7' or 'astc'
+    settings : EncSettings | None, optional
+        Settings matching the format, None for bc1/bc3/bc4/bc5
+    threads : int, optional
+        Default 0. Number of pool workers the block rows are split across (0=all pool workers)
+
+    Returns
+    -------
+    Future[bytes]
+        Already running future of the compressed data, it can't be cancelled
+    """
+    ...
+
+def compressed_size(
+    format: TextureFormat,
+    width: int,
+    height: int,
+    settings: EncSettings | None = None,
+) -> int:
+    """
+    Calculate the size of the compressed data of a surface.
+
+    Partial blocks at the right and bottom edge take up a whole block,
+    e.g. a 5x3 surface needs 2x1 blocks.
+
+    Parameters
+    ----------
+    format : TextureFormat
+        Target format, e.g. 'bc7' or 'astc'
+    width : int
+        Surface width in pixels
+    height : int
+        Surface height in pixels
+    settings : EncSettings | None, optional
+        Settings matching the format, None for bc1/bc3/bc4/bc5
+
+    Returns
+    -------
+    int
+        ceil(width / block_width) * ceil(height / block_height) * bytes_per_block
+    """
+    ...
+
+def configure_thread_pool(threads: int = 0, pin: bool = False) -> None:
+    """
+    (Re)create the worker pool shared by all compress calls.
+
+    The pool is otherwise created on the first call with threads != 1,
+    using one worker per hardware thread.
+
+    Parameters
+    ----------
+    threads : int, optional
+        Default 0. Number of workers (0=one per hardware thread)
+    pin : bool, optional
+        Default False. Pin each worker to a single cpu (ignored on macOS)
+    """
+    ...
+
+def thread_pool_size() -> int:
+    """
+    Get the number of workers of the shared thread pool.
+
+    Returns
+    -------
+    int
+        Number of workers, or that the default pool will have if there is none yet
+    """
+    ...
+
+def cpu_target() -> str | None:
+    """
+    Get the ISA of the kernels the ISPC dispatcher runs on this cpu.
+
+    The wheels contain the kernels for several targets
+    (sse2, sse4, avx, avx2 and avx512skx on x86-64, neon on arm),
+    the best one the cpu and os support is picked at runtime.
+
+    Returns
+    -------
+    str | None
+        One of 'avx512skx', 'avx2', 'avx', 'sse4', 'sse2' or 'neon',
+        None if the module was built without the target list of setup.py
+    """
+    ...
+
+def enable_stats(enabled: bool = True) -> bool:
+    """
+    Turn the call counters of stats() on or off, they are off by default.
+
+    While they are off, the compress calls only check a flag.
+
+    Parameters
+    ----------
+    enabled : bool, optional
+        Default True. Whether the calls are counted
+
+    Returns
+    -------
+    bool
+        Whether they were counted before
+    """
+    ...
+
+def stats() -> dict[tuple[str, str | None], CallStats]:
+    """
+    Get the counters of the compress_blocks_* and compress_blocks_*_into calls since the last reset_stats().
+
+    The calls are counted per format and profile, the profile being recognized by the settings,
+    e.g. ("bc7", "fast"), ("bc1", None) for the formats without settings
+    and ("bc7", "custom") for settings that don't match any profile.
+    The ASTC block sizes of a profile are summed up.
+
+    Returns
+    -------
+    dict[tuple[str, str | None], CallStats]
+        Counters by (format, profile)
+    """
+    ...
+
+def reset_stats() -> None:
+    """Zero the counters of stats()."""
     ...
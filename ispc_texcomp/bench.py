@@ -0,0 +1,424 @@
+"""
+Benchmark of every format and profile, run with ``python -m ispc_texcomp.bench``.
+
+The images are generated from a fixed seed, so results of different builds and machines can be compared.
+The results are written as JSON.
+"""
+
+from __future__ import annotations
+
+import argparse
+import json
+import os
+import platform
+import random
+import statistics
+import struct
+import sys
+import time
+from typing import Any, Callable, Iterator
+
+import ispc_texcomp
+
+FORMATS = ("bc1", "bc3", "bc4", "bc5", "bc6h", "bc7", "etc1", "astc")
+IMAGES = ("noise", "gradient", "photo", "alpha", "odd")
+
+
+def _value_noise(rng: random.Random, width: int, height: int, cell: int) -> bytearray:
+    # bilinear interpolation of a coarse random RGB grid plus some grain, looks roughly like a photo
+    grid_width = width // cell + 2
+    grid_height = height // cell + 2
+    grid = [
+        [rng.randrange(256) for _ in range(grid_width * 3)] for _ in range(grid_height)
+    ]
+    # the coarse rows interpolated to full width first, so that each pixel is a single vertical lerp
+    rows = []
+    for coarse in grid:
+        row = []
+        for x in range(width):
+            gx, fx = divmod(x, cell)
+            t = fx / cell
+            for c in range(3):
+                row.append(coarse[gx * 3 + c] * (1 - t) + coarse[gx * 3 + 3 + c] * t)
+        rows.append(row)
+    grain = rng.randbytes(width * height * 3)
+    data = bytearray(width * height * 4)
+    for y in range(height):
+        gy, fy = divmod(y, cell)
+        t = fy / cell
+        top = rows[gy]
+        bottom = rows[gy + 1]
+        offset = y * width * 4
+        for i in range(width * 3):
+            value = (
+                top[i] * (1 - t) + bottom[i] * t + (grain[y * width * 3 + i] & 15) - 8
+            )
+            data[offset + i // 3 * 4 + i % 3] = min(255, max(0, int(value)))
+        data[offset + 3 : offset + width * 4 : 4] = b"\xff" * width
+    return data
+
+
+def generate_image(name: str, size: int, seed: int = 0) -> tuple[bytes, int, int]:
+    """
+    Generate one of the benchmark images as RGBA8.
+
+    Parameters
+    ----------
+    name : str
+        noise, gradient, photo, alpha (photo with soft transparent rings) or odd
+        (photo with a size that isn't a multiple of any block size)
+    size : int
+        Width and height of the image, odd images are a bit smaller
+    seed : int, optional
+        Default 0. Seed of the random parts
+
+    Returns
+    -------
+    tuple[bytes, int, int]
+        Pixels, width and height
+    """
+    rng = random.Random(f"{name}-{seed}")
+    width = height = size
+    if name == "noise":
+        return rng.randbytes(width * height * 4), width, height
+    if name == "gradient":
+        data = bytearray(width * height * 4)
+        for y in range(height):
+            row = memoryview(data)[y * width * 4 : (y + 1) * width * 4]
+            row[0::4] = bytes(x * 255 // max(1, width - 1) for x in range(width))
+            row[1::4] = bytes([y * 255 // max(1, height - 1)]) * width
+            row[2::4] = bytes(
+                (x + y) * 255 // max(1, width + height - 2) for x in range(width)
+            )
+            row[3::4] = b"\xff" * width
+        return bytes(data), width, height
+    if name == "odd":
+        width = size * 3 // 4 + 3
+        height = size // 2 + 1
+    elif name not in ("photo", "alpha"):
+        raise ValueError(f"Invalid image: '{name}'")
+    data = _value_noise(rng, width, height, max(4, size // 16))
+    if name == "alpha":
+        # concentric rings with soft edges, fully transparent, opaque and everything in between
+        for y in range(height):
+            for x in range(width):
+                distance = ((x - width / 2) ** 2 + (y - height / 2) ** 2) ** 0.5
+                phase = distance / max(1, size / 8) % 1.0
+                data[(y * width + x) * 4 + 3] = int(
+                    255 * min(1.0, abs(phase * 2 - 1) * 1.5)
+                )
+    return bytes(data), width, height
+
+
+def _to_hdr(data: bytes) -> bytes:
+    # linear half floats up to 8.0, so that BC6H gets values above 1
+    values = [(value / 255) ** 2.2 * 8.0 for value in data]
+    for i in range(3, len(values), 4):
+        values[i] = 1.0
+    return struct.pack(f"<{len(values)}e", *values)
+
+
+def iter_cases(
+    formats: list[str], profiles: list[str] | None
+) -> Iterator[tuple[str, str | None, Any, tuple[int, int]]]:
+    """
+    Iterate over the format, profile, settings and block size of every benchmark case.
+
+    Parameters
+    ----------
+    formats : list[str]
+        Formats to include
+    profiles : list[str] | None
+        Profiles to include, None for all of them
+
+    Yields
+    ------
+    tuple[str, str | None, Any, tuple[int, int]]
+        Format, profile (None for formats without settings), settings and block size
+    """
+    settings_types = {
+        "bc6h": ispc_texcomp.BC6HEncSettings,
+        "bc7": ispc_texcomp.BC7EncSettings,
+        "etc1": ispc_texcomp.ETCEncSettings,
+    }
+    for format in formats:
+        if format in ("bc1", "bc3", "bc4", "bc5"):
+            yield format, None, None, (4, 4)
+        elif format == "astc":
+            for profile in ispc_texcomp.ASTCEncSettings.profiles():
+                if profiles is not None and profile not in profiles:
+                    continue
+                for block_size in ispc_texcomp.ASTCEncSettings.block_sizes():
+                    settings = ispc_texcomp.ASTCEncSettings.from_profile(
+                        profile, *block_size
+                    )
+                    yield format, profile, settings, block_size
+        elif format in settings_types:
+            settings_type = settings_types[format]
+            for profile in settings_type.profiles():
+                if profiles is None or profile in profiles:
+                    yield format, profile, settings_type.from_profile(profile), (4, 4)
+        else:
+            raise ValueError(f"Invalid format: '{format}'")
+
+
+def measure(func: Callable[[], object], repeat: int) -> tuple[float, float]:
+    """
+    Time func.
+
+    Parameters
+    ----------
+    func : Callable[[], object]
+        Function to time
+    repeat : int
+        Number of runs
+
+    Returns
+    -------
+    tuple[float, float]
+        Fastest and median run in seconds
+    """
+    times = []
+    for _ in range(max(1, repeat)):
+        start = time.perf_counter()
+        func()
+        times.append(time.perf_counter() - start)
+    return min(times), statistics.median(times)
+
+
+def measure_overhead(
+    sizes: tuple[int, ...] = (4, 16, 32), calls: int = 20000
+) -> list[dict[str, Any]]:
+    """
+    Measure the per-call cost of compressing tiny BC1 textures, where the call overhead is comparable to the kernel.
+
+    Parameters
+    ----------
+    sizes : tuple[int, ...], optional
+        Default (4, 16, 32). Width and height of the textures
+    calls : int, optional
+        Default 20000. Calls per measurement, the fastest of 3 measurements is reported
+
+    Returns
+    -------
+    list[dict[str, Any]]
+        Nanoseconds per call of each function and size
+    """
+    results = []
+    for size in sizes:
+        data, _, _ = generate_image("noise", size)
+        surface = ispc_texcomp.RGBASurface(data, size, size)
+        out = bytearray(ispc_texcomp.compressed_size("bc1", size, size))
+        encoder = ispc_texcomp.Encoder("bc1", size, size)
+        variants = {
+            "compress_blocks_bc1": lambda: ispc_texcomp.compress_blocks_bc1(surface),
+            "compress_blocks_bc1(threads=1)": lambda: ispc_texcomp.compress_blocks_bc1(
+                surface, threads=1
+            ),
+            "compress_blocks_bc1_into": lambda: ispc_texcomp.compress_blocks_bc1_into(
+                surface, out
+            ),
+            "Encoder.encode": lambda: encoder.encode(surface),
+        }
+        for name, func in variants.items():
+
+            def repeat(func: Callable[[], object] = func) -> None:
+                for _ in range(calls):
+                    func()
+
+            best, _ = measure(repeat, 3)
+            results.append(
+                {
+                    "function": name,
+                    "size": size,
+                    "nanoseconds_per_call": best / calls * 1e9,
+                }
+            )
+    return results
+
+
+def run(
+    size: int = 256,
+    repeat: int = 3,
+    threads: list[int] | None = None,
+    formats: list[str] | None = None,
+    profiles: list[str] | None = None,
+    images: list[str] | None = None,
+    seed: int = 0,
+    progress: Callable[[str], object] | None = None,
+    overhead: bool = False,
+) -> dict[str, Any]:
+    """
+    Run the benchmark.
+
+    Parameters
+    ----------
+    size : int, optional
+        Default 256. Width and height of the generated images
+    repeat : int, optional
+        Default 3. Runs per measurement, the fastest one is reported
+    threads : list[int] | None, optional
+        Default None. Thread counts of the scaling runs (0=all pool workers), None for 1 and all pool workers
+    formats : list[str] | None, optional
+        Default None. Formats to benchmark, None for all of them
+    profiles : list[str] | None, optional
+        Default None. Profiles to benchmark, None for all of them
+    images : list[str] | None, optional
+        Default None. Generated images to benchmark, None for all of them
+    seed : int, optional
+        Default 0. Seed of the generated images
+    progress : Callable[[str], object] | None, optional
+        Default None. Called with a line for each measurement
+    overhead : bool, optional
+        Default False. Measure the per-call overhead with measure_overhead as well
+
+    Returns
+    -------
+    dict[str, Any]
+        The configuration, the machine and one result per format, profile, block size, image and thread count
+    """
+    pool_size = ispc_texcomp.thread_pool_size()
+    if threads is None:
+        threads = [1] if pool_size == 1 else [1, pool_size]
+    threads = [pool_size if count == 0 else count for count in threads]
+
+    sources = {}
+    for name in images or IMAGES:
+        data, width, height = generate_image(name, size, seed)
+        sources[name] = (
+            ispc_texcomp.RGBASurface(data, width, height, pixel_format="rgba8"),
+            ispc_texcomp.RGBAHalfSurface(_to_hdr(data), width, height),
+        )
+
+    results = []
+    for format, profile, settings, block_size in iter_cases(
+        list(formats or FORMATS), profiles
+    ):
+        compress = getattr(ispc_texcomp, f"compress_blocks_{format}")
+        args = () if settings is None else (settings,)
+        for name, (surface, hdr_surface) in sources.items():
+            source = hdr_surface if format == "bc6h" else surface
+            blocks = -(-source.width // block_size[0]) * -(
+                -source.height // block_size[1]
+            )
+            baseline = None
+            for count in threads:
+                best, median = measure(
+                    lambda: compress(source, *args, threads=count), repeat
+                )
+                result = {
+                    "format": format,
+                    "profile": profile,
+                    "block_size": f"{block_size[0]}x{block_size[1]}",
+                    "image": name,
+                    "width": source.width,
+                    "height": source.height,
+                    "threads": count,
+                    "seconds": best,
+                    "median_seconds": median,
+                    "megapixels_per_second": source.width * source.height / best / 1e6,
+                    "microseconds_per_block": best / blocks * 1e6,
+                }
+                if count == 1:
+                    baseline = best
+                elif baseline is not None:
+                    result["speedup"] = baseline / best
+                results.append(result)
+                if progress is not None:
+                    progress(
+                        f"{format} {profile or '-'} {result['block_size']} {name} threads={count}: "
+                        f"{result['megapixels_per_second']:.2f} MP/s"
+                    )
+
+    report = {
+        "version": ispc_texcomp.__version__,
+        "python": platform.python_version(),
+        "platform": platform.platform(),
+        "machine": platform.machine(),
+        "cpu_count": os.cpu_count(),
+        "cpu_target": ispc_texcomp.cpu_target(),
+        "thread_pool_size": pool_size,
+        "size": size,
+        "repeat": repeat,
+        "seed": seed,
+        "results": results,
+    }
+    if overhead:
+        report["overhead"] = measure_overhead()
+        if progress is not None:
+            for result in report["overhead"]:
+                progress(
+                    f"{result['function']} {result['size']}x{result['size']}: {result['nanoseconds_per_call']:.0f} ns/call"
+                )
+    return report
+
+
+def _list(value: str) -> list[str]:
+    return [item.strip() for item in value.split(",") if item.strip()]
+
+
+def main(argv: list[str] | None = None) -> int:
+    """
+    Run the benchmark from the command line and write the JSON results.
+
+    Parameters
+    ----------
+    argv : list[str] | None, optional
+        Default None. Arguments, None for sys.argv
+
+    Returns
+    -------
+    int
+        Exit code
+    """
+    parser = argparse.ArgumentParser(
+        prog="python -m ispc_texcomp.bench", description=__doc__
+    )
+    parser.add_argument(
+        "--size", type=int, default=256, help="width and height of the images"
+    )
+    parser.add_argument("--repeat", type=int, default=3, help="runs per measurement")
+    parser.add_argument(
+        "--threads", type=_list, help="thread counts, e.g. 1,2,4,0 (0=all pool workers)"
+    )
+    parser.add_argument(
+        "--formats", type=_list, help=f"formats, default {','.join(FORMATS)}"
+    )
+    parser.add_argument("--profiles", type=_list, help="profiles, default all")
+    parser.add_argument(
+        "--images", type=_list, help=f"images, default {','.join(IMAGES)}"
+    )
+    parser.add_argument("--seed", type=int, default=0, help="seed of the images")
+    parser.add_argument(
+        "--overhead",
+        action="store_true",
+        help="measure the per-call overhead on tiny textures as well",
+    )
+    parser.add_argument("-o", "--output", help="JSON output file, default stdout")
+    parser.add_argument(
+        "-q", "--quiet", action="store_true", help="no progress on stderr"
+    )
+    args = parser.parse_args(argv)
+
+    report = run(
+        size=args.size,
+        repeat=args.repeat,
+        threads=[int(count) for count in args.threads] if args.threads else None,
+        formats=args.formats,
+        profiles=args.profiles,
+        images=args.images,
+        seed=args.seed,
+        progress=None if args.quiet else lambda line: print(line, file=sys.stderr),
+        overhead=args.overhead,
+    )
+    if args.output:
+        with open(args.output, "w") as f:
+            json.dump(report, f, indent=2)
+    else:
+        json.dump(report, sys.stdout, indent=2)
+        print()
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -2,7 +2,7 @@ import os
 import platform
 import sys
 
-from setuptools import Extension, setup
+from setuptools import Command, Extension, setup
 from setuptools.command.bdist_wheel import bdist_wheel
 from setuptools.command.build_ext import build_ext
 
@@ -20,6 +20,79 @@ ISPC_ARCH_MAP = (
     ),
 )
 
+# targets compiled per --arch, the kernels dispatch to the best one the cpu supports at runtime,
+# ISPC_TEXCOMP_TARGETS (comma separated ispc targets) overrides them, e.g. to benchmark a single one.
+# The release workflow prebuilds with `setup.py prebuild_ispc`, so this is the only list of them.
+ISPC_TARGETS = {
+    "x86-64": "sse2-i32x4,sse4.1-i32x4,avx1-i32x4,avx2-i32x4,avx512skx-x16",
+    "x86": "sse2-i32x4,sse4.1-i32x4",
+    "aarch64": "neon-i32x4",
+    "arm": "neon-i32x4",
+}
+
+# the ISA of an ispc target, ISPC_TARGET_<ISA> tells cpu_target() which kernels exist
+ISPC_TARGET_ISAS = (
+    ("avx512skx", "AVX512SKX"),
+    ("avx2", "AVX2"),
+    ("avx", "AVX"),
+    ("sse4", "SSE4"),
+    ("sse2", "SSE2"),
+    ("neon", "NEON"),
+)
+
+
+def get_ispc_arch(plat_name: str) -> str | None:
+    for plat_archs, ispc_arch in ISPC_ARCH_MAP:
+        if plat_name.endswith(plat_archs):
+            return ispc_arch
+    return None
+
+
+def get_ispc_targets(ispc_arch: str | None) -> list[str]:
+    targets = os.environ.get("ISPC_TEXCOMP_TARGETS") or ISPC_TARGETS.get(ispc_arch, "")
+    return [target.strip() for target in targets.split(",") if target.strip()]
+
+
+# written next to the prebuilt objects, the macros of a wheel build are derived from what is linked
+ISPC_TARGETS_FILE = "ispc_targets.txt"
+
+
+def get_ispc_command(
+    src_fp: str, out_fp: str, header_fp: str, ispc_arch: str | None
+) -> list[str]:
+    args = [
+        "ispc",
+        "-O2",
+        src_fp,
+        "-o",
+        out_fp,
+        "-h",
+        header_fp,
+        "--opt=fast-math",
+        "--pic",
+    ]
+
+    if ispc_arch is not None:
+        args.append(f"--arch={ispc_arch}")
+    else:
+        # let's just see if ispc can handle it....
+        # the arch selection is basically for wheel building
+        print("Warning:", "failed to detect local arch")
+    targets = get_ispc_targets(ispc_arch)
+    if targets:
+        args.append(f"--target={','.join(targets)}")
+    return args
+
+
+def get_ispc_target_macros(targets: list[str]) -> list[tuple[str, str]]:
+    macros = []
+    for target in targets:
+        for prefix, isa in ISPC_TARGET_ISAS:
+            if target.startswith(prefix):
+                macros.append((f"ISPC_TARGET_{isa}", "1"))
+                break
+    return macros
+
 
 class build_ext_ispc(build_ext):
     def build_extension(self, ext: Extension):
@@ -37,14 +110,11 @@ class build_ext_ispc(build_ext):
         ispc_include_dir: str
 
         argv = sys.argv
+        ispc_arch = get_ispc_arch(self.plat_name)
         if os.environ.get("CIBUILDWHEEL"):
-            plat_name: str = self.plat_name
-            for plat_archs, ispc_arch in ISPC_ARCH_MAP:
-                if plat_name.endswith(plat_archs):
-                    argv.append(f"--ispc_prebuild_dir=ispc_texcomp_{ispc_arch}")
-                    break
-            else:
+            if ispc_arch is None:
                 raise ValueError("Couldn't identify the target architecture!")
+            argv.append(f"--ispc_prebuild_dir=ispc_texcomp_{ispc_arch}")
 
         for argv in argv:
             if argv.startswith("--ispc_prebuild_dir"):
@@ -55,12 +125,17 @@ class build_ext_ispc(build_ext):
                     if obj.endswith(".o")
                 ]
                 ispc_include_dir = ispc_build_dir
+                with open(os.path.join(ispc_build_dir, ISPC_TARGETS_FILE)) as f:
+                    ispc_targets = f.read().split(",")
                 break
         else:
             # compile ispc files
             ispc_build_dir = os.path.join(self.build_temp, "ispc")
-            ispc_extra_objects = self.build_ispc(ispc_files, ispc_build_dir)
+            ispc_extra_objects = self.build_ispc(ispc_files, ispc_build_dir, ispc_arch)
             ispc_include_dir = os.path.realpath(ispc_build_dir)
+            ispc_targets = get_ispc_targets(ispc_arch)
+
+        ext.define_macros.extend(get_ispc_target_macros(ispc_targets))
 
         # add ispc objects to extra_objects for linking
         ext.extra_objects.extend(ispc_extra_objects)
@@ -69,44 +144,54 @@ class build_ext_ispc(build_ext):
 
         super().build_extension(ext)  # type: ignore
 
-    def build_ispc(self, ispc_files: list[str], build_dir: str) -> list[str]:
-        extra_objects: list[str] = []
+    def build_ispc(
+        self, ispc_files: list[str], build_dir: str, ispc_arch: str | None
+    ) -> list[str]:
         for source in ispc_files:
             name = os.path.basename(source)[:-5]
             source = os.path.realpath(source)
             output = os.path.realpath(os.path.join(build_dir, f"{name}.o"))
             header = os.path.realpath(os.path.join(build_dir, f"{name}_ispc.h"))
 
-            self.run_ispc(source, output, header)
-            extra_objects.append(output)
-        return extra_objects
+            self.run_ispc(source, output, header, ispc_arch)
+        # multi-target builds add an object per target next to the dispatcher
+        return [
+            os.path.realpath(os.path.join(build_dir, obj))
+            for obj in os.listdir(build_dir)
+            if obj.endswith(".o")
+        ]
 
-    def run_ispc(self, src_fp: str, out_fp: str, header_fp: str):
+    def run_ispc(self, src_fp: str, out_fp: str, header_fp: str, ispc_arch: str | None):
         os.makedirs(os.path.dirname(out_fp), exist_ok=True)
         os.makedirs(os.path.dirname(header_fp), exist_ok=True)
+        self.spawn(get_ispc_command(src_fp, out_fp, header_fp, ispc_arch))
 
-        args = [
-            "ispc",
-            "-O2",
-            src_fp,
-            "-o",
-            out_fp,
-            "-h",
-            header_fp,
-            "--opt=fast-math",
-            "--pic",
-        ]
 
-        plat_name: str = self.plat_name
-        for plat_archs, ispc_arch in ISPC_ARCH_MAP:
-            if plat_name.endswith(plat_archs):
-                args.append(f"--arch={ispc_arch}")
-        else:
-            # let's just see if ispc can handle it....
-            # the arch selection is basically for wheel building
-            print("Warning:", "failed to detect local arch")
+class prebuild_ispc(Command):
+    """Compile the kernels into ispc_texcomp_<arch>, which cibuildwheel links via --ispc_prebuild_dir."""
+
+    description = "compile the ispc kernels for the wheels of an architecture"
+    user_options = [("arch=", None, "ispc --arch to compile for")]
+
+    def initialize_options(self):
+        self.arch = None
+
+    def finalize_options(self):
+        if self.arch not in ISPC_TARGETS:
+            raise ValueError(f"--arch has to be one of {', '.join(ISPC_TARGETS)}")
 
-        self.spawn(args)
+    def run(self):
+        build_dir = f"ispc_texcomp_{self.arch}"
+        os.makedirs(build_dir, exist_ok=True)
+        for ext in self.distribution.ext_modules:
+            for source in ext.sources:
+                if source.endswith(".ispc"):
+                    name = os.path.basename(source)[:-5]
+                    output = os.path.join(build_dir, f"{name}.o")
+                    header = os.path.join(build_dir, f"{name}_ispc.h")
+                    self.spawn(get_ispc_command(source, output, header, self.arch))
+        with open(os.path.join(build_dir, ISPC_TARGETS_FILE), "w") as f:
+            f.write(",".join(get_ispc_targets(self.arch)))
 
 
 class bdist_wheel_abi3(bdist_wheel):
@@ -146,8 +231,27 @@ setup(
                 "src/ISPCTextureCompressor/ispc_texcomp/kernel_astc.ispc",
             ],
             depends=[
+                "src/mapped_file.hpp",
+                "src/pixel_format.hpp",
+                "src/fastcall.hpp",
+                "src/surface_array.hpp",
                 "src/rgba_surface_py.hpp",
                 "src/settings.hpp",
+                "src/thread_pool.hpp",
+                "src/cpu_target.hpp",
+                "src/decoder.hpp",
+                "src/format.hpp",
+                "src/block_cache.hpp",
+                "src/metrics.hpp",
+                "src/adaptive.hpp",
+                "src/mipmap.hpp",
+                "src/stream_encoder_py.hpp",
+                "src/encoder_py.hpp",
+                "src/block_cache_py.hpp",
+                "src/encode_cache_py.hpp",
+                "src/async.hpp",
+                "src/stats.hpp",
+                "src/container.hpp",
                 "src/ISPCTextureCompressor/ispc_texcomp/ispc_texcomp.h",
                 "src/ISPCTextureCompressor/ispc_texcomp/ispc_texcomp.def",
             ],
@@ -160,6 +264,10 @@ setup(
             py_limited_api=True,
         ),
     ],
-    cmdclass={"build_ext": build_ext_ispc, "bdist_wheel": bdist_wheel_abi3},
+    cmdclass={
+        "build_ext": build_ext_ispc,
+        "bdist_wheel": bdist_wheel_abi3,
+        "prebuild_ispc": prebuild_ispc,
+    },
     zip_safe=False,
 )
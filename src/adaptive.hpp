@@ -0,0 +1,67 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <vector>
+
+// reused by the block errors and the gathered blocks of the second pass
+thread_local std::vector<float> adaptive_errors;
+thread_local std::vector<int> adaptive_selected;
+thread_local std::vector<uint8_t> adaptive_scratch;
+
+// Compresses the block rows [begin, end) of src with the fast settings, then compresses the blocks
+// with a mean squared error above threshold again with the slow settings.
+// The blocks of a row are gathered into one strip, so the slow kernel runs once per block row.
+// Returns the number of blocks compressed again.
+int compress_rows_adaptive(const FormatInfo &format, EncSettings &fast, EncSettings &slow, const rgba_surface &src, uint8_t *dst, int begin, int end, float threshold, PixelFormat pixel_format) noexcept
+{
+    const int block_width = format.get_block_width(fast);
+    const int block_height = format.get_block_height(fast);
+    const int blocks_x = format.blocks_x(fast, src.width);
+    const size_t row_size = blocks_x * format.block_size;
+    adaptive_errors.resize(blocks_x);
+
+    int recompressed = 0;
+    for (int row = begin; row < end; row++)
+    {
+        compress_rows(format, fast, src, dst, row, row + 1, pixel_format);
+        double squared_error[4] = {};
+        measure_block_row(format, fast, src, dst, row, pixel_format, squared_error, adaptive_errors.data());
+
+        adaptive_selected.clear();
+        for (int x = 0; x < blocks_x; x++)
+        {
+            if (adaptive_errors[x] > threshold)
+                adaptive_selected.push_back(x);
+        }
+        if (adaptive_selected.empty())
+            continue;
+
+        const int count = static_cast<int>(adaptive_selected.size());
+        const rgba_surface source = kernel_source_rows(format, src, row * block_height, std::min(block_height, src.height - row * block_height), pixel_format);
+        rgba_surface strip = {nullptr, count * block_width, block_height, count * block_width * format.pixel_size};
+        adaptive_scratch.resize(static_cast<size_t>(strip.stride) * block_height + count * format.block_size);
+        strip.ptr = adaptive_scratch.data();
+        for (int i = 0; i < count; i++)
+        {
+            // the edge blocks get their border pixels replicated, like in compress_rows
+            rgba_surface slot = {strip.ptr + static_cast<size_t>(i) * block_width * format.pixel_size, block_width, block_height, strip.stride};
+            ReplicateBorders(&slot, &source, adaptive_selected[i] * block_width, 0, format.pixel_size * 8);
+        }
+        uint8_t *blocks = strip.ptr + static_cast<size_t>(strip.stride) * block_height;
+        format.compress(&strip, blocks, slow);
+        for (int i = 0; i < count; i++)
+            memcpy(dst + row * row_size + adaptive_selected[i] * format.block_size, blocks + i * format.block_size, format.block_size);
+        recompressed += count;
+    }
+    return recompressed;
+}
+
+// compress_rows_adaptive over the whole surface, its block rows are split across up to `threads` threads
+int compress_surface_adaptive(const FormatInfo &format, EncSettings &fast, EncSettings &slow, const rgba_surface &src, uint8_t *dst, float threshold, int threads, PixelFormat pixel_format) noexcept
+{
+    std::atomic<int> recompressed{0};
+    parallel_for(format.blocks_y(fast, src.height), threads, [&](int begin, int end)
+                 { recompressed += compress_rows_adaptive(format, fast, slow, src, dst, begin, end, threshold, pixel_format); });
+    return recompressed;
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include <Python.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+
+// A compression running on the shared pool without a waiting caller,
+// the worker finishing its last block row completes the future.
+struct AsyncJob
+{
+    const FormatInfo *format;
+    EncSettings settings;
+    rgba_surface src;
+    PixelFormat pixel_format;
+    uint8_t *dst;
+    // referenced until the job is done, so that the source buffer stays alive
+    PyObject *surface;
+    // bytes the blocks are written into, passed to future.set_result
+    PyObject *result;
+    PyObject *future;
+    std::atomic<int> rows_left;
+};
+
+// never waited on, the jobs count their rows themselves
+TaskGroup async_group;
+
+// jobs submitted but not completed yet, the interpreter waits for them at exit
+std::mutex async_mutex;
+std::condition_variable async_done;
+int async_jobs = 0;
+
+// called with the GIL held, before the job is submitted
+void begin_async_job() noexcept
+{
+    std::lock_guard<std::mutex> lock(async_mutex);
+    async_jobs++;
+}
+
+// Sets the result of the future, which runs its done callbacks on this thread, and drops the job.
+// Called from a worker of the pool without the GIL.
+void complete_async_job(AsyncJob *job) noexcept
+{
+    PyGILState_STATE state = PyGILState_Ensure();
+    PyObject *done = PyObject_CallMethod(job->future, "set_result", "O", job->result);
+    if (!done)
+        PyErr_WriteUnraisable(job->future);
+    Py_XDECREF(done);
+    Py_DECREF(job->surface);
+    Py_DECREF(job->result);
+    Py_DECREF(job->future);
+    PyGILState_Release(state);
+    delete job;
+
+    std::lock_guard<std::mutex> lock(async_mutex);
+    if (--async_jobs == 0)
+        async_done.notify_all();
+}
+
+// Queues the block rows of the job on the shared pool, called without the GIL.
+// The job may be completed and deleted before this returns.
+void submit_async_job(AsyncJob *job, int threads) noexcept
+{
+    const int count = job->format->blocks_y(job->settings, job->src.height);
+    job->rows_left = count;
+    if (count == 0)
+        return complete_async_job(job);
+
+    auto rows = [job](int begin, int end)
+    {
+        compress_rows(*job->format, job->settings, job->src, job->dst, begin, end, job->pixel_format);
+        if (job->rows_left.fetch_sub(end - begin) == end - begin)
+            complete_async_job(job);
+    };
+    std::shared_ptr<ThreadPool> pool;
+    try
+    {
+        pool = get_thread_pool();
+    }
+    catch (const std::exception &)
+    {
+        // no pool, so the job is done right here
+        return rows(0, count);
+    }
+    // the reference is dropped without the GIL, as the last one joins the workers, which may need it to complete jobs
+    submit_chunks(*pool, async_group, count, threads, rows);
+}
+
+// Blocks until every submitted job is completed, registered with atexit, so that no worker
+// needs the GIL after the interpreter is finalized.
+PyObject *wait_async_jobs(PyObject *self, PyObject *) noexcept
+{
+    Py_BEGIN_ALLOW_THREADS
+    {
+        std::unique_lock<std::mutex> lock(async_mutex);
+        async_done.wait(lock, []
+                        { return async_jobs == 0; });
+    }
+    Py_END_ALLOW_THREADS Py_RETURN_NONE;
+}
+
+PyMethodDef wait_async_jobs_def = {"_wait_async_jobs", wait_async_jobs, METH_NOARGS, "wait for the pending compress_async jobs"};
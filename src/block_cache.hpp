@@ -0,0 +1,197 @@
+#pragma once
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// 64 bit hash of a byte range, 8 bytes at a time
+inline uint64_t hash_bytes(const uint8_t *data, size_t size, uint64_t hash) noexcept
+{
+    const uint64_t prime = 0x9E3779B97F4A7C15ull;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8)
+    {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * prime;
+        hash ^= hash >> 29;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, data + i, size - i);
+    hash = (hash ^ tail ^ size) * prime;
+    return hash ^ (hash >> 32);
+}
+
+// Compressed blocks by the texels they were compressed from, shared by all calls and threads using it.
+// The texels are compared on every hit, so hash collisions can't return a wrong block.
+// Solid blocks are stored by their single color. The cache is cleared once it holds max_blocks blocks.
+struct BlockCache
+{
+    // texels followed by the compressed block
+    using Entry = std::vector<uint8_t>;
+
+    std::mutex mutex;
+    std::unordered_map<uint64_t, Entry> entries;
+    size_t max_blocks;
+    size_t hits = 0;
+    size_t misses = 0;
+
+    explicit BlockCache(size_t max_blocks) : max_blocks(max_blocks) {}
+
+    // copies the block compressed from texels to block, false if it isn't cached, the mutex has to be held
+    bool find(uint64_t key, const uint8_t *texels, size_t texels_size, uint8_t *block, size_t block_size) const noexcept
+    {
+        const auto it = entries.find(key);
+        if (it == entries.end() || it->second.size() != texels_size + block_size || memcmp(it->second.data(), texels, texels_size) != 0)
+            return false;
+        memcpy(block, it->second.data() + texels_size, block_size);
+        return true;
+    }
+
+    // the mutex has to be held, a colliding entry is replaced
+    void insert(uint64_t key, const uint8_t *texels, size_t texels_size, const uint8_t *block, size_t block_size) noexcept
+    {
+        try
+        {
+            if (entries.size() >= max_blocks)
+                entries.clear();
+            Entry &entry = entries[key];
+            entry.assign(texels, texels + texels_size);
+            entry.insert(entry.end(), block, block + block_size);
+        }
+        catch (const std::exception &)
+        {
+            // out of memory, the block just isn't cached
+            entries.erase(key);
+        }
+    }
+};
+
+// reused by the cached compression of all calls on the same thread
+thread_local std::vector<uint8_t> cache_band;
+thread_local std::vector<uint8_t> cache_texels;
+thread_local std::vector<uint8_t> cache_strip;
+thread_local std::vector<size_t> cache_sizes;
+thread_local std::vector<uint64_t> cache_keys;
+thread_local std::vector<int> cache_sources;
+thread_local std::vector<int> cache_misses;
+thread_local std::unordered_map<uint64_t, int> cache_row_misses;
+
+// Like compress_rows, but only the blocks that aren't in the cache are compressed, gathered into one strip per block row.
+// Duplicates within a row are compressed once as well.
+void compress_rows_cached(const FormatInfo &format, EncSettings &settings, const rgba_surface &src, uint8_t *dst, int begin, int end, PixelFormat pixel_format, BlockCache &cache) noexcept
+{
+    const int block_width = format.get_block_width(settings);
+    const int block_height = format.get_block_height(settings);
+    const int blocks_x = format.blocks_x(settings, src.width);
+    const size_t row_size = blocks_x * format.block_size;
+    const int pixel_size = format.pixel_size;
+    const size_t texels_size = static_cast<size_t>(block_width) * block_height * pixel_size;
+    const uint64_t seed = format_fingerprint(format, settings);
+    // solid blocks are keyed by their color alone
+    const uint64_t solid_seed = seed ^ 0x5D1D5D1D5D1D5D1Dull;
+
+    rgba_surface band = {nullptr, blocks_x * block_width, block_height, blocks_x * block_width * pixel_size};
+    cache_band.resize(static_cast<size_t>(band.stride) * block_height);
+    band.ptr = cache_band.data();
+    cache_texels.resize(blocks_x * texels_size);
+    cache_sizes.resize(blocks_x);
+    cache_keys.resize(blocks_x);
+    cache_sources.resize(blocks_x);
+
+    for (int row = begin; row < end; row++)
+    {
+        // the block row with its edges replicated like compress_rows does, then each block's texels made contiguous
+        const rgba_surface source = kernel_source_rows(format, src, row * block_height, std::min(block_height, src.height - row * block_height), pixel_format);
+        ReplicateBorders(&band, &source, 0, 0, pixel_size * 8);
+        for (int x = 0; x < blocks_x; x++)
+        {
+            uint8_t *texels = cache_texels.data() + x * texels_size;
+            for (int y = 0; y < block_height; y++)
+                memcpy(texels + static_cast<size_t>(y) * block_width * pixel_size, band.ptr + static_cast<size_t>(y) * band.stride + static_cast<size_t>(x) * block_width * pixel_size, static_cast<size_t>(block_width) * pixel_size);
+
+            // solid blocks are keyed and compared by their first pixel alone
+            cache_sizes[x] = pixel_size;
+            for (size_t i = pixel_size; i < texels_size; i += pixel_size)
+            {
+                if (memcmp(texels, texels + i, pixel_size) != 0)
+                {
+                    cache_sizes[x] = texels_size;
+                    break;
+                }
+            }
+            cache_keys[x] = hash_bytes(texels, cache_sizes[x], cache_sizes[x] == texels_size ? seed : solid_seed);
+        }
+
+        uint8_t *blocks = dst + row * row_size;
+        cache_misses.clear();
+        cache_row_misses.clear();
+        {
+            std::lock_guard<std::mutex> lock(cache.mutex);
+            for (int x = 0; x < blocks_x; x++)
+            {
+                const uint8_t *texels = cache_texels.data() + x * texels_size;
+                if (cache.find(cache_keys[x], texels, cache_sizes[x], blocks + x * format.block_size, format.block_size))
+                {
+                    cache_sources[x] = -1;
+                    cache.hits++;
+                    continue;
+                }
+                // a duplicate of an earlier miss of this row is copied from its block once it's compressed
+                const auto it = cache_row_misses.find(cache_keys[x]);
+                if (it != cache_row_misses.end())
+                {
+                    const int miss = cache_misses[it->second];
+                    if (cache_sizes[miss] == cache_sizes[x] && memcmp(cache_texels.data() + miss * texels_size, texels, cache_sizes[x]) == 0)
+                    {
+                        cache_sources[x] = it->second;
+                        cache.hits++;
+                        continue;
+                    }
+                }
+                cache_sources[x] = static_cast<int>(cache_misses.size());
+                cache_row_misses.emplace(cache_keys[x], cache_sources[x]);
+                cache_misses.push_back(x);
+                cache.misses++;
+            }
+        }
+        if (cache_misses.empty())
+            continue;
+
+        // the misses are compressed with a single kernel call
+        const int count = static_cast<int>(cache_misses.size());
+        rgba_surface strip = {nullptr, count * block_width, block_height, count * block_width * pixel_size};
+        cache_strip.resize(static_cast<size_t>(strip.stride) * block_height + count * format.block_size);
+        strip.ptr = cache_strip.data();
+        for (int i = 0; i < count; i++)
+        {
+            const uint8_t *texels = cache_texels.data() + cache_misses[i] * texels_size;
+            for (int y = 0; y < block_height; y++)
+                memcpy(strip.ptr + static_cast<size_t>(y) * strip.stride + static_cast<size_t>(i) * block_width * pixel_size, texels + static_cast<size_t>(y) * block_width * pixel_size, static_cast<size_t>(block_width) * pixel_size);
+        }
+        uint8_t *compressed = strip.ptr + static_cast<size_t>(strip.stride) * block_height;
+        format.compress(&strip, compressed, settings);
+        for (int x = 0; x < blocks_x; x++)
+        {
+            if (cache_sources[x] >= 0)
+                memcpy(blocks + x * format.block_size, compressed + cache_sources[x] * format.block_size, format.block_size);
+        }
+
+        std::lock_guard<std::mutex> lock(cache.mutex);
+        for (int i = 0; i < count; i++)
+        {
+            const int x = cache_misses[i];
+            cache.insert(cache_keys[x], cache_texels.data() + x * texels_size, cache_sizes[x], compressed + i * format.block_size, format.block_size);
+        }
+    }
+}
+
+// compress_surface through the cache if there is one
+void compress_surface_cached(const FormatInfo &format, EncSettings &settings, const rgba_surface &src, uint8_t *dst, int threads, PixelFormat pixel_format, BlockCache *cache) noexcept
+{
+    if (!cache)
+        return compress_surface(format, settings, src, dst, threads, pixel_format);
+    parallel_for(format.blocks_y(settings, src.height), threads, [&](int begin, int end)
+                 { compress_rows_cached(format, settings, src, dst, begin, end, pixel_format, *cache); });
+}
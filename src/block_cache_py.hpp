@@ -0,0 +1,149 @@
+#pragma once
+#include <Python.h>
+#include <new>
+
+PyTypeObject *BlockCacheObjectType = nullptr;
+
+// Python handle of a BlockCache, which can be passed to the compress functions of any format and thread.
+typedef struct
+{
+    PyObject_HEAD
+        BlockCache *cache;
+} BlockCacheObject;
+
+void BlockCache_dealloc(BlockCacheObject *self)
+{
+    delete self->cache;
+    PyObject_Del((PyObject *)self);
+}
+
+int BlockCache_init(BlockCacheObject *self, PyObject *args, PyObject *kwds)
+{
+    static const char *kwlist[] = {
+        "max_blocks",
+        nullptr};
+
+    Py_ssize_t max_blocks = 1 << 20;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|n", const_cast<char **>(kwlist), &max_blocks))
+        return -1;
+    if (max_blocks <= 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "max_blocks has to be positive");
+        return -1;
+    }
+
+    if (self->cache)
+    {
+        // initialized again, the cache may be in use by a compression that released the GIL, so it's only emptied
+        std::lock_guard<std::mutex> lock(self->cache->mutex);
+        self->cache->entries.clear();
+        self->cache->max_blocks = static_cast<size_t>(max_blocks);
+        self->cache->hits = 0;
+        self->cache->misses = 0;
+        return 0;
+    }
+    self->cache = new (std::nothrow) BlockCache(static_cast<size_t>(max_blocks));
+    if (!self->cache)
+    {
+        PyErr_NoMemory();
+        return -1;
+    }
+    return 0;
+}
+
+// sets a ValueError if __init__ hasn't run
+bool block_cache_ready(BlockCacheObject *self) noexcept
+{
+    if (self->cache)
+        return true;
+    PyErr_SetString(PyExc_ValueError, "BlockCache is not initialized");
+    return false;
+}
+
+// the getters lock the cache, as compressions running on other threads may be updating it
+PyObject *BlockCache_getHits(BlockCacheObject *self, void *closure)
+{
+    if (!block_cache_ready(self))
+        return nullptr;
+    std::lock_guard<std::mutex> lock(self->cache->mutex);
+    return PyLong_FromSize_t(self->cache->hits);
+}
+
+PyObject *BlockCache_getMisses(BlockCacheObject *self, void *closure)
+{
+    if (!block_cache_ready(self))
+        return nullptr;
+    std::lock_guard<std::mutex> lock(self->cache->mutex);
+    return PyLong_FromSize_t(self->cache->misses);
+}
+
+PyObject *BlockCache_getSize(BlockCacheObject *self, void *closure)
+{
+    if (!block_cache_ready(self))
+        return nullptr;
+    std::lock_guard<std::mutex> lock(self->cache->mutex);
+    return PyLong_FromSize_t(self->cache->entries.size());
+}
+
+PyObject *BlockCache_getMaxBlocks(BlockCacheObject *self, void *closure)
+{
+    if (!block_cache_ready(self))
+        return nullptr;
+    std::lock_guard<std::mutex> lock(self->cache->mutex);
+    return PyLong_FromSize_t(self->cache->max_blocks);
+}
+
+PyObject *BlockCache_clear(BlockCacheObject *self, PyObject *)
+{
+    if (!block_cache_ready(self))
+        return nullptr;
+    std::lock_guard<std::mutex> lock(self->cache->mutex);
+    self->cache->entries.clear();
+    self->cache->hits = 0;
+    self->cache->misses = 0;
+    Py_RETURN_NONE;
+}
+
+PyGetSetDef BlockCache_getsetters[] = {
+    {"hits", (getter)BlockCache_getHits, NULL, "hits", NULL},
+    {"misses", (getter)BlockCache_getMisses, NULL, "misses", NULL},
+    {"size", (getter)BlockCache_getSize, NULL, "size", NULL},
+    {"max_blocks", (getter)BlockCache_getMaxBlocks, NULL, "max_blocks", NULL},
+    {NULL} /* Sentinel */
+};
+
+PyMethodDef BlockCache_methods[] = {
+    {"clear", (PyCFunction)BlockCache_clear, METH_NOARGS, "drop all cached blocks and reset the counters"},
+    {NULL} /* Sentinel */
+};
+
+PyObject *BlockCache_repr(PyObject *self)
+{
+    BlockCache *cache = ((BlockCacheObject *)self)->cache;
+    if (!cache)
+        return PyUnicode_FromString("<BlockCache (uninitialized)>");
+    std::lock_guard<std::mutex> lock(cache->mutex);
+    return PyUnicode_FromFormat(
+        "<BlockCache (size:%zu, hits:%zu, misses:%zu)>",
+        cache->entries.size(),
+        cache->hits,
+        cache->misses);
+}
+
+PyType_Slot BlockCacheType_slots[] = {
+    {Py_tp_new, reinterpret_cast<void *>(PyType_GenericNew)},
+    {Py_tp_init, reinterpret_cast<void *>(BlockCache_init)},
+    {Py_tp_dealloc, reinterpret_cast<void *>(BlockCache_dealloc)},
+    {Py_tp_getset, reinterpret_cast<void *>(BlockCache_getsetters)},
+    {Py_tp_methods, reinterpret_cast<void *>(BlockCache_methods)},
+    {Py_tp_repr, reinterpret_cast<void *>(BlockCache_repr)},
+    {0, NULL},
+};
+
+PyType_Spec BlockCacheType_Spec = {
+    "ispc_texcomp.BlockCache",                // const char* name;
+    sizeof(BlockCacheObject),                 // int basicsize;
+    0,                                        // int itemsize;
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE, // unsigned int flags;
+    BlockCacheType_slots,                     // PyType_Slot *slots;
+};
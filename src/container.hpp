@@ -0,0 +1,394 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+// Identifiers of the formats in DDS and KTX2 files, indexed by FormatId like formats.
+// ASTC has one per footprint, the ones given are for 4x4 and the others follow in the order of astc_footprints.
+struct ContainerFormat
+{
+    // legacy DDS pixel format, 0 if only the DX10 header can describe it
+    uint32_t fourcc;
+    // 0 if there is no DXGI format, the sRGB variants are 0 for the formats without one
+    uint32_t dxgi;
+    uint32_t dxgi_srgb;
+    uint32_t vk;
+    uint32_t vk_srgb;
+    // color model of the KTX2 data format descriptor
+    uint8_t dfd_model;
+    // samples of the descriptor, channel id in the low 4 bits, each sample covers 64 bits of the block
+    int samples;
+    uint8_t sample_channels[2];
+};
+
+constexpr uint32_t make_fourcc(char a, char b, char c, char d)
+{
+    return static_cast<uint32_t>(a) | static_cast<uint32_t>(b) << 8 | static_cast<uint32_t>(c) << 16 | static_cast<uint32_t>(d) << 24;
+}
+
+// the descriptor float flag, set on the BC6H sample
+const uint8_t dfd_sample_float = 0x80;
+// the descriptor linear flag, set on alpha samples of sRGB data
+const uint8_t dfd_sample_linear = 0x10;
+
+const ContainerFormat container_formats[] = {
+    {make_fourcc('D', 'X', 'T', '1'), 71, 72, 131, 132, 128, 1, {0}},
+    {make_fourcc('D', 'X', 'T', '5'), 77, 78, 137, 138, 130, 2, {15, 0}},
+    {make_fourcc('A', 'T', 'I', '1'), 80, 0, 139, 0, 131, 1, {0}},
+    {make_fourcc('A', 'T', 'I', '2'), 83, 0, 141, 0, 132, 2, {0, 1}},
+    {0, 95, 0, 143, 0, 133, 1, {dfd_sample_float}},
+    {0, 98, 99, 145, 146, 134, 1, {0}},
+    // ETC1 is stored as the ETC2 RGB it's a subset of, DDS has no format for it
+    {0, 0, 0, 147, 148, 161, 1, {2}},
+    {0, 134, 135, 157, 158, 162, 1, {0}},
+};
+
+// the DXGI and Vulkan formats of ASTC are 4 and 2 apart per footprint
+int astc_footprint_index(const EncSettings &settings) noexcept
+{
+    for (size_t i = 0; i < sizeof(astc_footprints) / sizeof(astc_footprints[0]); i++)
+    {
+        if (astc_footprints[i][0] == settings.astc.block_width && astc_footprints[i][1] == settings.astc.block_height)
+            return static_cast<int>(i);
+    }
+    return 0;
+}
+
+// whether the format has a sRGB variant the data is tagged with
+bool container_srgb(const ContainerFormat &format, bool srgb) noexcept
+{
+    return srgb && format.vk_srgb != 0;
+}
+
+// The placement of the compressed levels of all layers in a container file,
+// the level n of the layer i goes to offsets[i * levels + n].
+struct ContainerLayout
+{
+    std::vector<uint8_t> header;
+    std::vector<size_t> offsets;
+    // gaps between the header and the levels, which are zeroed
+    std::vector<std::pair<size_t, size_t>> padding;
+    size_t size;
+};
+
+inline void put_u32(std::vector<uint8_t> &out, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+        out.push_back(static_cast<uint8_t>(value >> (i * 8)));
+}
+
+inline void put_u64(std::vector<uint8_t> &out, uint64_t value)
+{
+    put_u32(out, static_cast<uint32_t>(value));
+    put_u32(out, static_cast<uint32_t>(value >> 32));
+}
+
+size_t level_size(const FormatInfo &format, const EncSettings &settings, int width, int height, int level) noexcept
+{
+    return compressed_size(format, settings, std::max(1, width >> level), std::max(1, height >> level));
+}
+
+// DDS with the DX10 header if the legacy one can't describe the data, the layers one after the other, each with all its levels.
+// Sets a ValueError and returns false if DDS has no format for it.
+bool dds_layout(const FormatInfo &format, const EncSettings &settings, int width, int height, int layers, bool array, int levels, bool srgb, ContainerLayout &layout)
+{
+    const ContainerFormat &container = container_formats[&format - formats];
+    if (container.dxgi == 0)
+    {
+        PyErr_Format(PyExc_ValueError, "%s can't be stored in DDS", format.name);
+        return false;
+    }
+    const bool tag_srgb = container_srgb(container, srgb);
+    uint32_t dxgi = tag_srgb ? container.dxgi_srgb : container.dxgi;
+    if (&format == &formats[FORMAT_ASTC])
+        dxgi += 4 * astc_footprint_index(settings);
+    const bool dx10 = container.fourcc == 0 || array || tag_srgb;
+
+    std::vector<uint8_t> &header = layout.header;
+    put_u32(header, make_fourcc('D', 'D', 'S', ' '));
+    put_u32(header, 124);
+    // caps, height, width, pixel format, linear size and mip count if there are several levels
+    put_u32(header, 0x1 | 0x2 | 0x4 | 0x1000 | 0x80000 | (levels > 1 ? 0x20000 : 0));
+    put_u32(header, height);
+    put_u32(header, width);
+    put_u32(header, static_cast<uint32_t>(level_size(format, settings, width, height, 0)));
+    put_u32(header, 0);
+    put_u32(header, levels);
+    for (int i = 0; i < 11; i++)
+        put_u32(header, 0);
+    // pixel format with a fourcc
+    put_u32(header, 32);
+    put_u32(header, 0x4);
+    put_u32(header, dx10 ? make_fourcc('D', 'X', '1', '0') : container.fourcc);
+    for (int i = 0; i < 5; i++)
+        put_u32(header, 0);
+    // texture, complex if there are several levels or layers, mipmap if there are several levels
+    put_u32(header, 0x1000 | (levels > 1 ? 0x400008 : 0) | (layers > 1 ? 0x8 : 0));
+    for (int i = 0; i < 4; i++)
+        put_u32(header, 0);
+    if (dx10)
+    {
+        put_u32(header, dxgi);
+        // 2D texture
+        put_u32(header, 3);
+        put_u32(header, 0);
+        put_u32(header, layers);
+        put_u32(header, 0);
+    }
+
+    size_t offset = header.size();
+    for (int i = 0; i < layers; i++)
+    {
+        for (int n = 0; n < levels; n++)
+        {
+            layout.offsets.push_back(offset);
+            offset += level_size(format, settings, width, height, n);
+        }
+    }
+    layout.size = offset;
+    return true;
+}
+
+// KTX2 without supercompression, the levels from the smallest to the largest one, each with all layers.
+bool ktx2_layout(const FormatInfo &format, const EncSettings &settings, int width, int height, int layers, bool array, int levels, bool srgb, ContainerLayout &layout)
+{
+    const ContainerFormat &container = container_formats[&format - formats];
+    const bool tag_srgb = container_srgb(container, srgb);
+    uint32_t vk = tag_srgb ? container.vk_srgb : container.vk;
+    if (&format == &formats[FORMAT_ASTC])
+        vk += 2 * astc_footprint_index(settings);
+
+    std::vector<uint8_t> &header = layout.header;
+    const uint8_t identifier[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+    header.insert(header.end(), identifier, identifier + 12);
+    put_u32(header, vk);
+    put_u32(header, 1);
+    put_u32(header, width);
+    put_u32(header, height);
+    put_u32(header, 0);
+    put_u32(header, array ? layers : 0);
+    put_u32(header, 1);
+    put_u32(header, levels);
+    put_u32(header, 0);
+    const size_t dfd_offset = 80 + 24 * static_cast<size_t>(levels);
+    const size_t dfd_size = 4 + 24 + 16 * static_cast<size_t>(container.samples);
+    put_u32(header, static_cast<uint32_t>(dfd_offset));
+    put_u32(header, static_cast<uint32_t>(dfd_size));
+    // no key/value data and no supercompression global data
+    put_u32(header, 0);
+    put_u32(header, 0);
+    put_u64(header, 0);
+    put_u64(header, 0);
+
+    // the level index, filled in below
+    const size_t index_offset = header.size();
+    header.resize(dfd_offset, 0);
+
+    // the basic data format descriptor
+    put_u32(header, static_cast<uint32_t>(dfd_size));
+    put_u32(header, 0);
+    put_u32(header, 2 | static_cast<uint32_t>(dfd_size - 4) << 16);
+    // color model, BT.709 primaries, linear or sRGB transfer function, straight alpha
+    put_u32(header, container.dfd_model | 1 << 8 | (tag_srgb ? 2 : 1) << 16);
+    put_u32(header, (format.get_block_width(settings) - 1) | (format.get_block_height(settings) - 1) << 8);
+    put_u32(header, static_cast<uint32_t>(format.block_size));
+    put_u32(header, 0);
+    const int sample_bits = static_cast<int>(format.block_size) * 8 / container.samples;
+    for (int i = 0; i < container.samples; i++)
+    {
+        uint8_t channel = container.sample_channels[i];
+        if (tag_srgb && (channel & 0xF) == 15)
+            channel |= dfd_sample_linear;
+        put_u32(header, (i * sample_bits) | (sample_bits - 1) << 16 | static_cast<uint32_t>(channel) << 24);
+        put_u32(header, 0);
+        // the range of a float sample is 0.0 to 1.0, unorm samples span their whole bits
+        put_u32(header, 0);
+        put_u32(header, channel & dfd_sample_float ? 0x3F800000 : 0xFFFFFFFF);
+    }
+
+    // the levels are aligned to the block size, which is a multiple of 4
+    layout.offsets.resize(static_cast<size_t>(layers) * levels);
+    size_t offset = header.size();
+    for (int n = levels - 1; n >= 0; n--)
+    {
+        const size_t aligned = (offset + format.block_size - 1) / format.block_size * format.block_size;
+        if (aligned != offset)
+            layout.padding.push_back({offset, aligned - offset});
+        offset = aligned;
+        const size_t size = level_size(format, settings, width, height, n);
+        const size_t index = index_offset + 24 * static_cast<size_t>(n);
+        for (int i = 0; i < 8; i++)
+        {
+            header[index + i] = static_cast<uint8_t>(static_cast<uint64_t>(offset) >> (i * 8));
+            header[index + 8 + i] = static_cast<uint8_t>(static_cast<uint64_t>(size * layers) >> (i * 8));
+            header[index + 16 + i] = header[index + 8 + i];
+        }
+        for (int i = 0; i < layers; i++)
+        {
+            layout.offsets[static_cast<size_t>(i) * levels + n] = offset;
+            offset += size;
+        }
+    }
+    layout.size = offset;
+    return true;
+}
+
+typedef bool (*ContainerLayoutFunc)(const FormatInfo &format, const EncSettings &settings, int width, int height, int layers, bool array, int levels, bool srgb, ContainerLayout &layout);
+
+// write_dds and write_ktx2, compressing the mip chains of all layers straight into the container in a single pass
+template <ContainerLayoutFunc make_layout>
+PyObject *py_write_container(PyObject *self, PyObject *args, PyObject *kwds) noexcept
+{
+    static const char *kwlist[] = {"surfaces", "format", "settings", "levels", "filter", "srgb", "threads", "out", "offset", nullptr};
+    PyObject *py_surfaces;
+    const char *format_name;
+    PyObject *py_settings = nullptr;
+    int levels = 1;
+    const char *filter_name = "box";
+    int srgb = 1;
+    int threads = 1;
+    PyObject *py_out = Py_None;
+    Py_ssize_t offset = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "Os|O$ispO&On", const_cast<char **>(kwlist), &py_surfaces, &format_name, &py_settings, &levels, &filter_name, &srgb, threads_converter, &threads, &py_out, &offset))
+        return nullptr;
+
+    const FormatInfo *format = find_format(format_name);
+    if (!format)
+        return nullptr;
+    EncSettings settings = {};
+    if (!parse_settings(*format, py_settings, settings))
+        return nullptr;
+    MipFilter filter;
+    if (!find_mip_filter(filter_name, filter))
+        return nullptr;
+    if (offset < 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "offset must be >= 0");
+        return nullptr;
+    }
+
+    // a single surface is a plain texture, a sequence of them an array, referenced while the GIL is released
+    const bool array = !PyObject_TypeCheck(py_surfaces, RGBASurfaceObjectType);
+    PyObject *py_list = array ? PySequence_List(py_surfaces) : PyList_New(1);
+    if (!py_list)
+        return nullptr;
+    if (!array)
+    {
+        Py_INCREF(py_surfaces);
+        PyList_SetItem(py_list, 0, py_surfaces);
+    }
+    const Py_ssize_t layers = PyList_Size(py_list);
+    std::vector<rgba_surface> surfaces(layers);
+    std::vector<PixelFormat> surface_formats(layers);
+    for (Py_ssize_t i = 0; i < layers; i++)
+    {
+        PyObject *item = PyList_GetItem(py_list, i);
+        if (!PyObject_TypeCheck(item, RGBASurfaceObjectType))
+        {
+            PyErr_Format(PyExc_TypeError, "surfaces[%zd] is not a RGBASurface", i);
+            Py_DECREF(py_list);
+            return nullptr;
+        }
+        surfaces[i] = reinterpret_cast<RGBASurfaceObject *>(item)->surf;
+        surface_formats[i] = reinterpret_cast<RGBASurfaceObject *>(item)->pixel_format;
+        if (!check_native_stride(*format, surfaces[i], surface_formats[i]))
+        {
+            Py_DECREF(py_list);
+            return nullptr;
+        }
+        if (surfaces[i].width != surfaces[0].width || surfaces[i].height != surfaces[0].height)
+        {
+            PyErr_Format(PyExc_ValueError, "surfaces[%zd] is %dx%d, the first one %dx%d", i, surfaces[i].width, surfaces[i].height, surfaces[0].width, surfaces[0].height);
+            Py_DECREF(py_list);
+            return nullptr;
+        }
+    }
+    if (layers == 0 || surfaces[0].width <= 0 || surfaces[0].height <= 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "the surfaces are empty");
+        Py_DECREF(py_list);
+        return nullptr;
+    }
+    const int width = surfaces[0].width;
+    const int height = surfaces[0].height;
+    const int max_levels = mip_count(width, height);
+    if (levels < 0 || levels > max_levels)
+    {
+        PyErr_Format(PyExc_ValueError, "levels must be between 0 (full chain) and %d", max_levels);
+        Py_DECREF(py_list);
+        return nullptr;
+    }
+    if (levels == 0)
+        levels = max_levels;
+
+    ContainerLayout layout;
+    try
+    {
+        if (!make_layout(*format, settings, width, height, static_cast<int>(layers), array, levels, srgb != 0, layout))
+        {
+            Py_DECREF(py_list);
+            return nullptr;
+        }
+    }
+    catch (const std::bad_alloc &)
+    {
+        Py_DECREF(py_list);
+        return PyErr_NoMemory();
+    }
+
+    // the output is a new bytes object, a writable buffer or a mapped file
+    PyObject *result = nullptr;
+    Py_buffer view = {};
+    MappedFile file = {};
+    uint8_t *dst = nullptr;
+    if (py_out == Py_None)
+    {
+        result = PyBytes_FromStringAndSize(nullptr, layout.size);
+        dst = result ? reinterpret_cast<uint8_t *>(PyBytes_AsString(result)) : nullptr;
+    }
+    else if (PyObject_CheckBuffer(py_out))
+    {
+        if (PyObject_GetBuffer(py_out, &view, PyBUF_WRITABLE) == 0)
+        {
+            if (static_cast<size_t>(view.len) < layout.size || static_cast<size_t>(view.len) - layout.size < static_cast<size_t>(offset))
+            {
+                PyErr_Format(PyExc_ValueError, "Output buffer too small (need %zu bytes at offset %zd, got %zd)", layout.size, offset, view.len);
+                PyBuffer_Release(&view);
+            }
+            else
+                dst = static_cast<uint8_t *>(view.buf) + offset;
+        }
+    }
+    else if (map_file(py_out, true, offset, layout.size, file))
+        dst = file.data;
+    if (!dst)
+    {
+        Py_XDECREF(result);
+        Py_DECREF(py_list);
+        return nullptr;
+    }
+
+    bool compressed = true;
+    Py_BEGIN_ALLOW_THREADS
+        memcpy(dst, layout.header.data(), layout.header.size());
+    for (const auto &gap : layout.padding)
+        memset(dst + gap.first, 0, gap.second);
+    for (Py_ssize_t i = 0; compressed && i < layers; i++)
+        compressed = compress_mip_chain(*format, settings, surfaces[i], levels, dst, &layout.offsets[i * levels], filter, srgb != 0, threads, surface_formats[i]);
+    unmap_file(file);
+    Py_END_ALLOW_THREADS Py_DECREF(py_list);
+
+    if (view.obj)
+        PyBuffer_Release(&view);
+    // a partially written container is never handed back
+    if (!compressed)
+    {
+        Py_XDECREF(result);
+        return PyErr_NoMemory();
+    }
+    if (result)
+        return result;
+    return PyLong_FromSize_t(layout.size);
+}
@@ -0,0 +1,142 @@
+#pragma once
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define ISPC_TEXCOMP_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+// The ISAs the kernels can be compiled for, best first. setup.py defines ISPC_TARGET_<ISA> as 1
+// for every target it compiled, the ISPC dispatcher picks the first one the cpu supports.
+enum class KernelIsa : int
+{
+    avx512skx,
+    avx2,
+    avx,
+    sse4,
+    sse2,
+    neon,
+};
+
+#if defined(ISPC_TEXCOMP_X86)
+inline void cpuid(int leaf, int subleaf, uint32_t regs[4]) noexcept
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuidex(info, leaf, subleaf);
+    for (int i = 0; i < 4; i++)
+        regs[i] = static_cast<uint32_t>(info[i]);
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// the register states the os saves on context switches
+inline uint64_t xgetbv0() noexcept
+{
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    uint32_t eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+}
+#endif
+
+// whether the cpu and the os support the ISA, with the feature checks of the ISPC dispatcher
+inline bool cpu_supports(KernelIsa isa) noexcept
+{
+#if defined(ISPC_TEXCOMP_X86)
+    uint32_t regs[4];
+    cpuid(0, 0, regs);
+    const uint32_t max_leaf = regs[0];
+    cpuid(1, 0, regs);
+    const uint32_t ecx1 = regs[2];
+    const uint32_t edx1 = regs[3];
+    uint32_t ebx7 = 0;
+    if (max_leaf >= 7)
+    {
+        cpuid(7, 0, regs);
+        ebx7 = regs[1];
+    }
+    // ymm and zmm states have to be enabled by the os, not just supported by the cpu
+    const bool osxsave = (ecx1 >> 27) & 1;
+    const uint64_t xcr0 = osxsave ? xgetbv0() : 0;
+    const bool ymm = (xcr0 & 0x6) == 0x6;
+    const bool zmm = (xcr0 & 0xE6) == 0xE6;
+
+    switch (isa)
+    {
+    case KernelIsa::avx512skx:
+        // F, DQ, CD, BW and VL
+        return zmm && (ebx7 & 0xD0030000u) == 0xD0030000u;
+    case KernelIsa::avx2:
+        // AVX2, FMA and F16C
+        return ymm && ((ebx7 >> 5) & 1) && ((ecx1 >> 12) & 1) && ((ecx1 >> 29) & 1);
+    case KernelIsa::avx:
+        return ymm && ((ecx1 >> 28) & 1);
+    case KernelIsa::sse4:
+        return ((ecx1 >> 19) & 1) && ((ecx1 >> 20) & 1);
+    case KernelIsa::sse2:
+        return (edx1 >> 26) & 1;
+    default:
+        return false;
+    }
+#elif defined(__aarch64__) || defined(_M_ARM64) || defined(__ARM_NEON)
+    return isa == KernelIsa::neon;
+#else
+    (void)isa;
+    return false;
+#endif
+}
+
+struct KernelIsaInfo
+{
+    KernelIsa isa;
+    const char *name;
+    bool compiled;
+};
+
+#ifndef ISPC_TARGET_AVX512SKX
+#define ISPC_TARGET_AVX512SKX 0
+#endif
+#ifndef ISPC_TARGET_AVX2
+#define ISPC_TARGET_AVX2 0
+#endif
+#ifndef ISPC_TARGET_AVX
+#define ISPC_TARGET_AVX 0
+#endif
+#ifndef ISPC_TARGET_SSE4
+#define ISPC_TARGET_SSE4 0
+#endif
+#ifndef ISPC_TARGET_SSE2
+#define ISPC_TARGET_SSE2 0
+#endif
+#ifndef ISPC_TARGET_NEON
+#define ISPC_TARGET_NEON 0
+#endif
+
+const KernelIsaInfo kernel_isas[] = {
+    {KernelIsa::avx512skx, "avx512skx", ISPC_TARGET_AVX512SKX != 0},
+    {KernelIsa::avx2, "avx2", ISPC_TARGET_AVX2 != 0},
+    {KernelIsa::avx, "avx", ISPC_TARGET_AVX != 0},
+    {KernelIsa::sse4, "sse4", ISPC_TARGET_SSE4 != 0},
+    {KernelIsa::sse2, "sse2", ISPC_TARGET_SSE2 != 0},
+    {KernelIsa::neon, "neon", ISPC_TARGET_NEON != 0},
+};
+
+// name of the ISA whose kernels run on this cpu, nullptr if the targets weren't passed by setup.py
+const char *active_kernel_isa() noexcept
+{
+    for (const auto &info : kernel_isas)
+    {
+        if (info.compiled && cpu_supports(info.isa))
+            return info.name;
+    }
+    return nullptr;
+}
@@ -0,0 +1,1264 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+// Block decoders of all formats, each one writes the pixels of one block in the kernel input layout
+// (RGBA8, R8 for BC4, RG8 for BC5 and RGBA half floats for BC6H) to dst, rows being stride bytes apart.
+
+inline uint32_t load_le32(const uint8_t *data)
+{
+    return static_cast<uint32_t>(data[0]) | static_cast<uint32_t>(data[1]) << 8 | static_cast<uint32_t>(data[2]) << 16 | static_cast<uint32_t>(data[3]) << 24;
+}
+
+inline uint32_t load_be32(const uint8_t *data)
+{
+    return static_cast<uint32_t>(data[0]) << 24 | static_cast<uint32_t>(data[1]) << 16 | static_cast<uint32_t>(data[2]) << 8 | static_cast<uint32_t>(data[3]);
+}
+
+// the 128 bits of a block, bit 0 being the lowest bit of the first byte
+struct BlockBits
+{
+    uint64_t low;
+    uint64_t high;
+
+    explicit BlockBits(const uint8_t *block)
+    {
+        low = static_cast<uint64_t>(load_le32(block)) | static_cast<uint64_t>(load_le32(block + 4)) << 32;
+        high = static_cast<uint64_t>(load_le32(block + 8)) | static_cast<uint64_t>(load_le32(block + 12)) << 32;
+    }
+
+    // up to 32 bits starting at start, bits past the end of the block are 0
+    uint32_t get(int start, int count) const
+    {
+        if (count == 0 || start >= 128)
+            return 0;
+        uint64_t value;
+        if (start >= 64)
+            value = high >> (start - 64);
+        else if (start == 0)
+            value = low;
+        else
+            value = (low >> start) | (high << (64 - start));
+        return static_cast<uint32_t>(value & ((static_cast<uint64_t>(1) << count) - 1));
+    }
+};
+
+// reads consecutive bit fields
+struct BitReader
+{
+    const BlockBits &bits;
+    int position;
+
+    uint32_t read(int count)
+    {
+        const uint32_t value = bits.get(position, count);
+        position += count;
+        return value;
+    }
+};
+
+// ---------------------------------------------------------------------------------------------------------------
+// BC1 - BC5
+
+inline void bc1_palette(const uint8_t *block, uint8_t palette[4][4], bool four_colors)
+{
+    const int c0 = block[0] | block[1] << 8;
+    const int c1 = block[2] | block[3] << 8;
+    for (int i = 0; i < 2; i++)
+    {
+        const int c = i == 0 ? c0 : c1;
+        const int r = (c >> 11) & 0x1F;
+        const int g = (c >> 5) & 0x3F;
+        const int b = c & 0x1F;
+        palette[i][0] = static_cast<uint8_t>((r << 3) | (r >> 2));
+        palette[i][1] = static_cast<uint8_t>((g << 2) | (g >> 4));
+        palette[i][2] = static_cast<uint8_t>((b << 3) | (b >> 2));
+        palette[i][3] = 255;
+    }
+    for (int ch = 0; ch < 4; ch++)
+    {
+        const int a = palette[0][ch];
+        const int b = palette[1][ch];
+        if (four_colors || c0 > c1)
+        {
+            palette[2][ch] = static_cast<uint8_t>((2 * a + b + 1) / 3);
+            palette[3][ch] = static_cast<uint8_t>((a + 2 * b + 1) / 3);
+        }
+        else
+        {
+            // 3 colors and transparent black
+            palette[2][ch] = static_cast<uint8_t>((a + b + 1) / 2);
+            palette[3][ch] = 0;
+        }
+    }
+}
+
+inline void bc1_colors(const uint8_t *block, uint8_t *dst, size_t stride, bool four_colors)
+{
+    uint8_t palette[4][4];
+    bc1_palette(block, palette, four_colors);
+    const uint32_t indices = load_le32(block + 4);
+    for (int y = 0; y < 4; y++)
+    {
+        for (int x = 0; x < 4; x++)
+            memcpy(dst + y * stride + x * 4, palette[(indices >> (2 * (y * 4 + x))) & 3], 4);
+    }
+}
+
+// decodes a BC4 block into one channel of pixels pixel_size bytes apart
+inline void bc4_channel(const uint8_t *block, uint8_t *dst, size_t stride, int pixel_size)
+{
+    const int a = block[0];
+    const int b = block[1];
+    uint8_t palette[8] = {static_cast<uint8_t>(a), static_cast<uint8_t>(b)};
+    if (a > b)
+    {
+        for (int i = 1; i < 7; i++)
+            palette[i + 1] = static_cast<uint8_t>(((7 - i) * a + i * b + 3) / 7);
+    }
+    else
+    {
+        for (int i = 1; i < 5; i++)
+            palette[i + 1] = static_cast<uint8_t>(((5 - i) * a + i * b + 2) / 5);
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+    const uint64_t indices = static_cast<uint64_t>(load_le32(block + 2)) | static_cast<uint64_t>(block[6]) << 32 | static_cast<uint64_t>(block[7]) << 40;
+    for (int y = 0; y < 4; y++)
+    {
+        for (int x = 0; x < 4; x++)
+            dst[y * stride + x * pixel_size] = palette[(indices >> (3 * (y * 4 + x))) & 7];
+    }
+}
+
+void decode_bc1(const uint8_t *block, uint8_t *dst, size_t stride, int, int)
+{
+    bc1_colors(block, dst, stride, false);
+}
+
+void decode_bc3(const uint8_t *block, uint8_t *dst, size_t stride, int, int)
+{
+    bc1_colors(block + 8, dst, stride, true);
+    bc4_channel(block, dst + 3, stride, 4);
+}
+
+void decode_bc4(const uint8_t *block, uint8_t *dst, size_t stride, int, int)
+{
+    bc4_channel(block, dst, stride, 1);
+}
+
+void decode_bc5(const uint8_t *block, uint8_t *dst, size_t stride, int, int)
+{
+    bc4_channel(block, dst, stride, 2);
+    bc4_channel(block + 8, dst + 1, stride, 2);
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+// BC6H & BC7
+
+// subset of each pixel of the 64 two subset partitions, bit i is pixel i
+const uint16_t bptc_partitions2[64] = {
+    0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80, 0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+    0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE, 0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+    0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A, 0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+    0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C, 0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22};
+
+// subset of each pixel of the 64 three subset partitions, 2 bits per pixel
+const uint32_t bptc_partitions3[64] = {
+    0xAA685050, 0x6A5A5040, 0x5A5A4200, 0x5450A0A8, 0xA5A50000, 0xA0A05050, 0x5555A0A0, 0x5A5A5050,
+    0xAA550000, 0xAA555500, 0xAAAA5500, 0x90909090, 0x94949494, 0xA4A4A4A4, 0xA9A59450, 0x2A0A4250,
+    0xA5945040, 0x0A425054, 0xA5A5A500, 0x55A0A0A0, 0xA8A85454, 0x6A6A4040, 0xA4A45000, 0x1A1A0500,
+    0x0050A4A4, 0xAAA59090, 0x14696914, 0x69691400, 0xA08585A0, 0xAA821414, 0x50A4A450, 0x6A5A0200,
+    0xA9A58000, 0x5090A0A8, 0xA8A09050, 0x24242424, 0x00AA5500, 0x24924924, 0x24499224, 0x50A50A50,
+    0x500AA550, 0xAAAA4444, 0x66660000, 0xA5A0A5A0, 0x50A050A0, 0x69286928, 0x44AAAA44, 0x66666600,
+    0xAA444444, 0x54A854A8, 0x95809580, 0x96969600, 0xA85454A8, 0x80959580, 0xAA141414, 0x96960000,
+    0xAAAA1414, 0xA05050A0, 0xA0A5A5A0, 0x96000000, 0x40804080, 0xA9A8A9A8, 0xAAAAAA44, 0x2A4A5254};
+
+// the pixel of the second subset (two subsets) and of the second and third subset (three subsets) with an implicit index bit
+const uint8_t bptc_anchor2[64] = {
+    15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+    15, 2, 8, 2, 2, 8, 8, 15, 2, 8, 2, 2, 8, 8, 2, 2,
+    15, 15, 6, 8, 2, 8, 15, 15, 2, 8, 2, 2, 2, 15, 15, 6,
+    6, 2, 6, 8, 15, 15, 2, 2, 15, 15, 15, 15, 15, 2, 2, 15};
+const uint8_t bptc_anchor3_2[64] = {
+    3, 3, 15, 15, 8, 3, 15, 15, 8, 8, 6, 6, 6, 5, 3, 3,
+    3, 3, 8, 15, 3, 3, 6, 10, 5, 8, 8, 6, 8, 5, 15, 15,
+    8, 15, 3, 5, 6, 10, 8, 15, 15, 3, 15, 5, 15, 15, 15, 15,
+    3, 15, 5, 5, 5, 8, 5, 10, 5, 10, 8, 13, 15, 12, 3, 3};
+const uint8_t bptc_anchor3_3[64] = {
+    15, 8, 8, 3, 15, 15, 3, 8, 15, 15, 15, 15, 15, 15, 15, 8,
+    15, 8, 15, 3, 15, 8, 15, 8, 3, 15, 6, 10, 15, 15, 10, 8,
+    15, 3, 15, 10, 10, 8, 9, 10, 6, 15, 8, 15, 3, 6, 6, 8,
+    15, 3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 3, 15, 15, 8};
+
+const uint8_t bptc_weights2[4] = {0, 21, 43, 64};
+const uint8_t bptc_weights3[8] = {0, 9, 18, 27, 37, 46, 55, 64};
+const uint8_t bptc_weights4[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+inline const uint8_t *bptc_weights(int bits)
+{
+    return bits == 2 ? bptc_weights2 : bits == 3 ? bptc_weights3 : bptc_weights4;
+}
+
+inline int bptc_subset(int subsets, int partition, int pixel)
+{
+    if (subsets == 2)
+        return (bptc_partitions2[partition] >> pixel) & 1;
+    if (subsets == 3)
+        return (bptc_partitions3[partition] >> (2 * pixel)) & 3;
+    return 0;
+}
+
+inline bool bptc_is_anchor(int subsets, int partition, int pixel)
+{
+    if (pixel == 0)
+        return true;
+    if (subsets == 2)
+        return pixel == bptc_anchor2[partition];
+    if (subsets == 3)
+        return pixel == bptc_anchor3_2[partition] || pixel == bptc_anchor3_3[partition];
+    return false;
+}
+
+struct BC7Mode
+{
+    uint8_t subsets;
+    uint8_t partition_bits;
+    uint8_t rotation_bits;
+    uint8_t index_selection_bits;
+    uint8_t color_bits;
+    uint8_t alpha_bits;
+    uint8_t endpoint_pbits;
+    uint8_t shared_pbits;
+    uint8_t index_bits;
+    uint8_t index_bits2;
+};
+
+const BC7Mode bc7_modes[8] = {
+    {3, 4, 0, 0, 4, 0, 1, 0, 3, 0},
+    {2, 6, 0, 0, 6, 0, 0, 1, 3, 0},
+    {3, 6, 0, 0, 5, 0, 0, 0, 2, 0},
+    {2, 6, 0, 0, 7, 0, 1, 0, 2, 0},
+    {1, 0, 2, 1, 5, 6, 0, 0, 2, 3},
+    {1, 0, 2, 0, 7, 8, 0, 0, 2, 2},
+    {1, 0, 0, 0, 7, 7, 1, 0, 4, 0},
+    {2, 6, 0, 0, 5, 5, 1, 0, 2, 0},
+};
+
+void decode_bc7(const uint8_t *block, uint8_t *dst, size_t stride, int, int)
+{
+    if (block[0] == 0)
+    {
+        // reserved mode
+        for (int y = 0; y < 4; y++)
+            memset(dst + y * stride, 0, 16);
+        return;
+    }
+    int mode_index = 0;
+    while (!((block[0] >> mode_index) & 1))
+        mode_index++;
+    const BC7Mode &mode = bc7_modes[mode_index];
+
+    const BlockBits bits(block);
+    BitReader reader = {bits, mode_index + 1};
+    const int partition = reader.read(mode.partition_bits);
+    const int rotation = reader.read(mode.rotation_bits);
+    const int index_selection = reader.read(mode.index_selection_bits);
+
+    const int endpoints = mode.subsets * 2;
+    int colors[6][4];
+    for (int c = 0; c < 3; c++)
+    {
+        for (int e = 0; e < endpoints; e++)
+            colors[e][c] = reader.read(mode.color_bits);
+    }
+    for (int e = 0; e < endpoints; e++)
+        colors[e][3] = mode.alpha_bits ? reader.read(mode.alpha_bits) : 255;
+
+    int color_bits = mode.color_bits;
+    int alpha_bits = mode.alpha_bits;
+    if (mode.endpoint_pbits || mode.shared_pbits)
+    {
+        int pbits[6];
+        for (int e = 0; e < endpoints; e++)
+            pbits[e] = mode.endpoint_pbits ? reader.read(1) : 0;
+        if (mode.shared_pbits)
+        {
+            for (int s = 0; s < mode.subsets; s++)
+                pbits[s * 2] = pbits[s * 2 + 1] = reader.read(1);
+        }
+        for (int e = 0; e < endpoints; e++)
+        {
+            for (int c = 0; c < (alpha_bits ? 4 : 3); c++)
+                colors[e][c] = colors[e][c] << 1 | pbits[e];
+        }
+        color_bits++;
+        if (alpha_bits)
+            alpha_bits++;
+    }
+    for (int e = 0; e < endpoints; e++)
+    {
+        for (int c = 0; c < 4; c++)
+        {
+            const int count = c < 3 ? color_bits : alpha_bits;
+            if (count == 0)
+                continue;
+            colors[e][c] <<= 8 - count;
+            colors[e][c] |= colors[e][c] >> count;
+        }
+    }
+
+    int indices[16];
+    int indices2[16];
+    for (int i = 0; i < 16; i++)
+        indices[i] = reader.read(mode.index_bits - (bptc_is_anchor(mode.subsets, partition, i) ? 1 : 0));
+    for (int i = 0; mode.index_bits2 && i < 16; i++)
+        indices2[i] = reader.read(mode.index_bits2 - (i == 0 ? 1 : 0));
+
+    for (int i = 0; i < 16; i++)
+    {
+        const int *e0 = colors[bptc_subset(mode.subsets, partition, i) * 2];
+        const int *e1 = e0 + 4;
+        int color_weight;
+        int alpha_weight;
+        if (!mode.index_bits2)
+            color_weight = alpha_weight = bptc_weights(mode.index_bits)[indices[i]];
+        else if (index_selection)
+        {
+            color_weight = bptc_weights(mode.index_bits2)[indices2[i]];
+            alpha_weight = bptc_weights(mode.index_bits)[indices[i]];
+        }
+        else
+        {
+            color_weight = bptc_weights(mode.index_bits)[indices[i]];
+            alpha_weight = bptc_weights(mode.index_bits2)[indices2[i]];
+        }
+
+        uint8_t pixel[4];
+        for (int c = 0; c < 4; c++)
+        {
+            const int weight = c < 3 ? color_weight : alpha_weight;
+            pixel[c] = static_cast<uint8_t>(((64 - weight) * e0[c] + weight * e1[c] + 32) >> 6);
+        }
+        if (rotation)
+            std::swap(pixel[3], pixel[rotation - 1]);
+        memcpy(dst + (i / 4) * stride + (i % 4) * 4, pixel, 4);
+    }
+}
+
+// bits of the BC6H endpoints, the 4 endpoints of each channel
+enum BC6HField : uint8_t
+{
+    R0,
+    R1,
+    R2,
+    R3,
+    G0,
+    G1,
+    G2,
+    G3,
+    B0,
+    B1,
+    B2,
+    B3,
+};
+
+// count bits of the block go to field bits [shift, shift + count), in reverse order if reversed
+struct BC6HSegment
+{
+    uint8_t field;
+    uint8_t shift;
+    uint8_t count;
+    bool reversed;
+};
+
+struct BC6HMode
+{
+    uint8_t mode;
+    uint8_t mode_bits;
+    uint8_t subsets;
+    bool transformed;
+    uint8_t endpoint_bits;
+    uint8_t delta_bits[3];
+    BC6HSegment segments[24];
+};
+
+const BC6HMode bc6h_modes[14] = {
+    {0x00, 2, 2, true, 10, {5, 5, 5}, {{G2, 4, 1}, {B2, 4, 1}, {B3, 4, 1}, {R0, 0, 10}, {G0, 0, 10}, {B0, 0, 10}, {R1, 0, 5}, {G3, 4, 1}, {G2, 0, 4}, {G1, 0, 5}, {B3, 0, 1}, {G3, 0, 4}, {B1, 0, 5}, {B3, 1, 1}, {B2, 0, 4}, {R2, 0, 5}, {B3, 2, 1}, {R3, 0, 5}, {B3, 3, 1}}},
+    {0x01, 2, 2, true, 7, {6, 6, 6}, {{G2, 5, 1}, {G3, 4, 1}, {G3, 5, 1}, {R0, 0, 7}, {B3, 0, 1}, {B3, 1, 1}, {B2, 4, 1}, {G0, 0, 7}, {B2, 5, 1}, {B3, 2, 1}, {G2, 4, 1}, {B0, 0, 7}, {B3, 3, 1}, {B3, 5, 1}, {B3, 4, 1}, {R1, 0, 6}, {G2, 0, 4}, {G1, 0, 6}, {G3, 0, 4}, {B1, 0, 6}, {B2, 0, 4}, {R2, 0, 6}, {R3, 0, 6}}},
+    {0x02, 5, 2, true, 11, {5, 4, 4}, {{R0, 0, 10}, {G0, 0, 10}, {B0, 0, 10}, {R1, 0, 5}, {R0, 10, 1}, {G2, 0, 4}, {G1, 0, 4}, {G0, 10, 1}, {B3, 0, 1}, {G3, 0, 4}, {B1, 0, 4}, {B0, 10, 1}, {B3, 1, 1}, {B2, 0, 4}, {R2, 0, 5}, {B3, 2, 1}, {R3, 0, 5}, {B3, 3, 1}}},
+    {0x06, 5, 2, true, 11, {4, 5, 4}, {{R0, 0, 10}, {G0, 0, 10}, {B0, 0, 10}, {R1, 0, 4}, {R0, 10, 1}, {G3, 4, 1}, {G2, 0, 4}, {G1, 0, 5}, {G0, 10, 1}, {G3, 0, 4}, {B1, 0, 4}, {B0, 10, 1}, {B3, 1, 1}, {B2, 0, 4}, {R2, 0, 4}, {B3, 0, 1}, {B3, 2, 1}, {R3, 0, 4}, {G2, 4, 1}, {B3, 3, 1}}},
+    {0x0A, 5, 2, true, 11, {4, 4, 5}, {{R0, 0, 10}, {G0, 0, 10}, {B0, 0, 10}, {R1, 0, 4}, {R0, 10, 1}, {B2, 4, 1}, {G2, 0, 4}, {G1, 0, 4}, {G0, 10, 1}, {B3, 0, 1}, {G3, 0, 4}, {B1, 0, 5}, {B0, 10, 1}, {B2, 0, 4}, {R2, 0, 4}, {B3, 1, 1}, {B3, 2, 1}, {R3, 0, 4}, {B3, 4, 1}, {B3, 3, 1}}},
+    {0x0E, 5, 2, true, 9, {5, 5, 5}, {{R0, 0, 9}, {B2, 4, 1}, {G0, 0, 9}, {G2, 4, 1}, {B0, 0, 9}, {B3, 4, 1}, {R1, 0, 5}, {G3, 4, 1}, {G2, 0, 4}, {G1, 0, 5}, {B3, 0, 1}, {G3, 0, 4}, {B1, 0, 5}, {B3, 1, 1}, {B2, 0, 4}, {R2, 0, 5}, {B3, 2, 1}, {R3, 0, 5}, {B3, 3, 1}}},
+    {0x12, 5, 2, true, 8, {6, 5, 5}, {{R0, 0, 8}, {G3, 4, 1}, {B2, 4, 1}, {G0, 0, 8}, {B3, 2, 1}, {G2, 4, 1}, {B0, 0, 8}, {B3, 3, 1}, {B3, 4, 1}, {R1, 0, 6}, {G2, 0, 4}, {G1, 0, 5}, {B3, 0, 1}, {G3, 0, 4}, {B1, 0, 5}, {B3, 1, 1}, {B2, 0, 4}, {R2, 0, 6}, {R3, 0, 6}}},
+    {0x16, 5, 2, true, 8, {5, 6, 5}, {{R0, 0, 8}, {B3, 0, 1}, {B2, 4, 1}, {G0, 0, 8}, {G2, 5, 1}, {G2, 4, 1}, {B0, 0, 8}, {G3, 5, 1}, {B3, 4, 1}, {R1, 0, 5}, {G3, 4, 1}, {G2, 0, 4}, {G1, 0, 6}, {G3, 0, 4}, {B1, 0, 5}, {B3, 1, 1}, {B2, 0, 4}, {R2, 0, 5}, {B3, 2, 1}, {R3, 0, 5}, {B3, 3, 1}}},
+    {0x1A, 5, 2, true, 8, {5, 5, 6}, {{R0, 0, 8}, {B3, 1, 1}, {B2, 4, 1}, {G0, 0, 8}, {B2, 5, 1}, {G2, 4, 1}, {B0, 0, 8}, {B3, 5, 1}, {B3, 4, 1}, {R1, 0, 5}, {G3, 4, 1}, {G2, 0, 4}, {G1, 0, 5}, {B3, 0, 1}, {G3, 0, 4}, {B1, 0, 6}, {B2, 0, 4}, {R2, 0, 5}, {B3, 2, 1}, {R3, 0, 5}, {B3, 3, 1}}},
+    {0x1E, 5, 2, false, 6, {6, 6, 6}, {{R0, 0, 6}, {G3, 4, 1}, {B3, 0, 1}, {B3, 1, 1}, {B2, 4, 1}, {G0, 0, 6}, {G2, 5, 1}, {B2, 5, 1}, {B3, 2, 1}, {G2, 4, 1}, {B0, 0, 6}, {G3, 5, 1}, {B3, 3, 1}, {B3, 5, 1}, {B3, 4, 1}, {R1, 0, 6}, {G2, 0, 4}, {G1, 0, 6}, {G3, 0, 4}, {B1, 0, 6}, {B2, 0, 4}, {R2, 0, 6}, {R3, 0, 6}}},
+    {0x03, 5, 1, false, 10, {10, 10, 10}, {{R0, 0, 10}, {G0, 0, 10}, {B0, 0, 10}, {R1, 0, 10}, {G1, 0, 10}, {B1, 0, 10}}},
+    {0x07, 5, 1, true, 11, {9, 9, 9}, {{R0, 0, 10}, {G0, 0, 10}, {B0, 0, 10}, {R1, 0, 9}, {R0, 10, 1}, {G1, 0, 9}, {G0, 10, 1}, {B1, 0, 9}, {B0, 10, 1}}},
+    {0x0B, 5, 1, true, 12, {8, 8, 8}, {{R0, 0, 10}, {G0, 0, 10}, {B0, 0, 10}, {R1, 0, 8}, {R0, 10, 2, true}, {G1, 0, 8}, {G0, 10, 2, true}, {B1, 0, 8}, {B0, 10, 2, true}}},
+    {0x0F, 5, 1, true, 16, {4, 4, 4}, {{R0, 0, 10}, {G0, 0, 10}, {B0, 0, 10}, {R1, 0, 4}, {R0, 10, 6, true}, {G1, 0, 4}, {G0, 10, 6, true}, {B1, 0, 4}, {B0, 10, 6, true}}},
+};
+
+// unquantizes an unsigned endpoint to 16 bits
+inline int bc6h_unquantize(int value, int bits)
+{
+    if (bits >= 15)
+        return value;
+    if (value == 0)
+        return 0;
+    if (value == (1 << bits) - 1)
+        return 0xFFFF;
+    return ((value << 16) + 0x8000) >> bits;
+}
+
+// decodes unsigned BC6H (BC6H_UF16), which is what the encoder writes
+void decode_bc6h(const uint8_t *block, uint8_t *dst, size_t stride, int, int)
+{
+    const BlockBits bits(block);
+    const BC6HMode *mode = nullptr;
+    for (const auto &candidate : bc6h_modes)
+    {
+        if (bits.get(0, candidate.mode_bits) == candidate.mode)
+        {
+            mode = &candidate;
+            break;
+        }
+    }
+    if (!mode)
+    {
+        // reserved mode
+        const uint16_t black[4] = {0, 0, 0, 0x3C00};
+        for (int y = 0; y < 4; y++)
+        {
+            for (int x = 0; x < 4; x++)
+                memcpy(dst + y * stride + x * 8, black, 8);
+        }
+        return;
+    }
+
+    int fields[12] = {};
+    BitReader reader = {bits, mode->mode_bits};
+    for (const auto &segment : mode->segments)
+    {
+        if (segment.count == 0)
+            break;
+        const uint32_t value = reader.read(segment.count);
+        for (int i = 0; i < segment.count; i++)
+        {
+            const int bit = segment.reversed ? segment.count - 1 - i : i;
+            fields[segment.field] |= ((value >> i) & 1) << (segment.shift + bit);
+        }
+    }
+
+    const int endpoints = mode->subsets * 2;
+    const int mask = (1 << mode->endpoint_bits) - 1;
+    int colors[4][3];
+    for (int c = 0; c < 3; c++)
+    {
+        for (int e = 0; e < endpoints; e++)
+        {
+            int value = fields[c * 4 + e];
+            if (mode->transformed && e > 0)
+            {
+                // sign extended delta to the first endpoint
+                const int delta_bits = mode->delta_bits[c];
+                if (value & (1 << (delta_bits - 1)))
+                    value -= 1 << delta_bits;
+                value = (fields[c * 4] + value) & mask;
+            }
+            colors[e][c] = bc6h_unquantize(value, mode->endpoint_bits);
+        }
+    }
+
+    const int partition = mode->subsets == 2 ? reader.read(5) : 0;
+    const int index_bits = mode->subsets == 2 ? 3 : 4;
+    const uint8_t *weights = bptc_weights(index_bits);
+    for (int i = 0; i < 16; i++)
+    {
+        const int index = reader.read(index_bits - (bptc_is_anchor(mode->subsets, partition, i) ? 1 : 0));
+        const int *e0 = colors[bptc_subset(mode->subsets, partition, i) * 2];
+        const int *e1 = e0 + 3;
+        const int weight = weights[index];
+        uint16_t pixel[4];
+        for (int c = 0; c < 3; c++)
+            pixel[c] = static_cast<uint16_t>(((((64 - weight) * e0[c] + weight * e1[c] + 32) >> 6) * 31) >> 6);
+        pixel[3] = 0x3C00;
+        memcpy(dst + (i / 4) * stride + (i % 4) * 8, pixel, 8);
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+// ETC1
+
+const int etc1_modifiers[8][2] = {{2, 8}, {5, 17}, {9, 29}, {13, 42}, {18, 60}, {24, 80}, {33, 106}, {47, 183}};
+
+void decode_etc1(const uint8_t *block, uint8_t *dst, size_t stride, int, int)
+{
+    const uint32_t high = load_be32(block);
+    const uint32_t low = load_be32(block + 4);
+    const bool differential = (high >> 1) & 1;
+    const bool flip = high & 1;
+
+    int base[2][3];
+    for (int c = 0; c < 3; c++)
+    {
+        const int shift = 24 - c * 8;
+        if (differential)
+        {
+            const int first = (high >> (shift + 3)) & 0x1F;
+            int delta = (high >> shift) & 7;
+            if (delta & 4)
+                delta -= 8;
+            const int second = (first + delta) & 0x1F;
+            base[0][c] = (first << 3) | (first >> 2);
+            base[1][c] = (second << 3) | (second >> 2);
+        }
+        else
+        {
+            base[0][c] = ((high >> (shift + 4)) & 0xF) * 17;
+            base[1][c] = ((high >> shift) & 0xF) * 17;
+        }
+    }
+    const int tables[2] = {static_cast<int>((high >> 5) & 7), static_cast<int>((high >> 2) & 7)};
+
+    for (int x = 0; x < 4; x++)
+    {
+        for (int y = 0; y < 4; y++)
+        {
+            // the pixels are stored column by column
+            const int i = x * 4 + y;
+            const int index = ((low >> (16 + i)) & 1) << 1 | ((low >> i) & 1);
+            const int subblock = flip ? y >= 2 : x >= 2;
+            const int magnitude = etc1_modifiers[tables[subblock]][index & 1];
+            const int modifier = index & 2 ? -magnitude : magnitude;
+            uint8_t *pixel = dst + y * stride + x * 4;
+            for (int c = 0; c < 3; c++)
+                pixel[c] = static_cast<uint8_t>(std::min(std::max(base[subblock][c] + modifier, 0), 255));
+            pixel[3] = 255;
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+// ASTC (LDR, 2D)
+
+// the 2D footprints of the ASTC spec, the decoder takes all of them
+const int astc_decode_footprints[][2] = {{4, 4}, {5, 4}, {5, 5}, {6, 5}, {6, 6}, {8, 5}, {8, 6}, {8, 8}, {10, 5}, {10, 6}, {10, 8}, {10, 10}, {12, 10}, {12, 12}};
+
+inline bool is_astc_decode_footprint(int block_width, int block_height)
+{
+    for (const auto &footprint : astc_decode_footprints)
+    {
+        if (footprint[0] == block_width && footprint[1] == block_height)
+            return true;
+    }
+    return false;
+}
+
+// integer sequence encoding of the value range [0, max]
+struct IseRange
+{
+    uint8_t trits;
+    uint8_t quints;
+    uint8_t bits;
+};
+
+// ordered by the number of levels, the color endpoints use [4, 20], the weights [0, 11]
+const IseRange ise_ranges[21] = {
+    {0, 0, 1}, {1, 0, 0}, {0, 0, 2}, {0, 1, 0}, {1, 0, 1}, {0, 0, 3}, {0, 1, 1}, {1, 0, 2}, {0, 0, 4}, {0, 1, 2}, {1, 0, 3}, {0, 0, 5}, {0, 1, 3}, {1, 0, 4}, {0, 0, 6}, {0, 1, 4}, {1, 0, 5}, {0, 0, 7}, {0, 1, 5}, {1, 0, 6}, {0, 0, 8}};
+
+inline int ise_size(int count, const IseRange &range)
+{
+    int size = count * range.bits;
+    if (range.trits)
+        size += (count * 8 + 4) / 5;
+    if (range.quints)
+        size += (count * 7 + 2) / 3;
+    return size;
+}
+
+// decodes count values of bits [start, start + ise_size), bits past the sequence read as 0
+inline void decode_ise(const BlockBits &bits, int start, int count, const IseRange &range, int *values)
+{
+    const int end = start + ise_size(count, range);
+    auto read = [&](int &position, int size)
+    {
+        const int available = std::max(0, std::min(size, end - position));
+        const uint32_t value = bits.get(position, available);
+        position += size;
+        return static_cast<int>(value);
+    };
+
+    const int n = range.bits;
+    int position = start;
+    if (range.trits)
+    {
+        for (int i = 0; i < count; i += 5)
+        {
+            int m[5];
+            int t;
+            m[0] = read(position, n);
+            t = read(position, 2);
+            m[1] = read(position, n);
+            t |= read(position, 2) << 2;
+            m[2] = read(position, n);
+            t |= read(position, 1) << 4;
+            m[3] = read(position, n);
+            t |= read(position, 2) << 5;
+            m[4] = read(position, n);
+            t |= read(position, 1) << 7;
+
+            int trits[5];
+            int c;
+            if (((t >> 2) & 7) == 7)
+            {
+                c = ((t >> 5) & 7) << 2 | (t & 3);
+                trits[4] = 2;
+                trits[3] = 2;
+            }
+            else
+            {
+                c = t & 0x1F;
+                if (((t >> 5) & 3) == 3)
+                {
+                    trits[4] = 2;
+                    trits[3] = (t >> 7) & 1;
+                }
+                else
+                {
+                    trits[4] = (t >> 7) & 1;
+                    trits[3] = (t >> 5) & 3;
+                }
+            }
+            if ((c & 3) == 3)
+            {
+                trits[2] = 2;
+                trits[1] = (c >> 4) & 1;
+                trits[0] = ((c >> 3) & 1) << 1 | (((c >> 2) & 1) & ~((c >> 3) & 1));
+            }
+            else if (((c >> 2) & 3) == 3)
+            {
+                trits[2] = 2;
+                trits[1] = 2;
+                trits[0] = c & 3;
+            }
+            else
+            {
+                trits[2] = (c >> 4) & 1;
+                trits[1] = (c >> 2) & 3;
+                trits[0] = ((c >> 1) & 1) << 1 | ((c & 1) & ~((c >> 1) & 1));
+            }
+            for (int j = 0; j < 5 && i + j < count; j++)
+                values[i + j] = trits[j] << n | m[j];
+        }
+    }
+    else if (range.quints)
+    {
+        for (int i = 0; i < count; i += 3)
+        {
+            int m[3];
+            int q;
+            m[0] = read(position, n);
+            q = read(position, 3);
+            m[1] = read(position, n);
+            q |= read(position, 2) << 3;
+            m[2] = read(position, n);
+            q |= read(position, 2) << 5;
+
+            int quints[3];
+            if (((q >> 1) & 3) == 3 && ((q >> 5) & 3) == 0)
+            {
+                const int bit0 = q & 1;
+                quints[2] = bit0 << 2 | (((q >> 4) & 1) & ~bit0) << 1 | (((q >> 3) & 1) & ~bit0);
+                quints[1] = 4;
+                quints[0] = 4;
+            }
+            else
+            {
+                int c;
+                if (((q >> 1) & 3) == 3)
+                {
+                    quints[2] = 4;
+                    c = ((q >> 3) & 3) << 3 | ((~q >> 5) & 3) << 1 | (q & 1);
+                }
+                else
+                {
+                    quints[2] = (q >> 5) & 3;
+                    c = q & 0x1F;
+                }
+                if ((c & 7) == 5)
+                {
+                    quints[1] = 4;
+                    quints[0] = (c >> 3) & 3;
+                }
+                else
+                {
+                    quints[1] = (c >> 3) & 3;
+                    quints[0] = c & 7;
+                }
+            }
+            for (int j = 0; j < 3 && i + j < count; j++)
+                values[i + j] = quints[j] << n | m[j];
+        }
+    }
+    else
+    {
+        for (int i = 0; i < count; i++)
+            values[i] = read(position, n);
+    }
+}
+
+// unquantizes a color endpoint value to [0, 255]
+inline int astc_unquantize_color(int value, const IseRange &range)
+{
+    const int n = range.bits;
+    if (!range.trits && !range.quints)
+    {
+        // bit replication
+        int result = 0;
+        for (int shift = 8 - n; shift > -n; shift -= n)
+            result |= shift >= 0 ? value << shift : value >> -shift;
+        return result & 0xFF;
+    }
+
+    const int m = value & ((1 << n) - 1);
+    const int d = value >> n;
+    const int a = (m & 1) ? 0x1FF : 0;
+    const int b = (m >> 1) & 1, c = (m >> 2) & 1, e = (m >> 4) & 1, f = (m >> 5) & 1;
+    const int bit_d = (m >> 3) & 1;
+    int B = 0;
+    int C;
+    if (range.trits)
+    {
+        switch (n)
+        {
+        case 1:
+            C = 204;
+            break;
+        case 2:
+            B = b << 8 | b << 4 | b << 2 | b << 1;
+            C = 93;
+            break;
+        case 3:
+            B = c << 8 | b << 7 | c << 3 | b << 2 | c << 1 | b;
+            C = 44;
+            break;
+        case 4:
+            B = bit_d << 8 | c << 7 | b << 6 | bit_d << 2 | c << 1 | b;
+            C = 22;
+            break;
+        case 5:
+            B = e << 8 | bit_d << 7 | c << 6 | b << 5 | e << 1 | bit_d;
+            C = 11;
+            break;
+        default:
+            B = f << 8 | e << 7 | bit_d << 6 | c << 5 | b << 4 | f;
+            C = 5;
+            break;
+        }
+    }
+    else
+    {
+        switch (n)
+        {
+        case 1:
+            C = 113;
+            break;
+        case 2:
+            B = b << 8 | b << 3 | b << 2;
+            C = 54;
+            break;
+        case 3:
+            B = c << 8 | b << 7 | c << 2 | b << 1 | c;
+            C = 26;
+            break;
+        case 4:
+            B = bit_d << 8 | c << 7 | b << 6 | bit_d << 1 | c;
+            C = 13;
+            break;
+        default:
+            B = e << 8 | bit_d << 7 | c << 6 | b << 5 | e;
+            C = 6;
+            break;
+        }
+    }
+    int t = d * C + B;
+    t ^= a;
+    return (a & 0x80) | (t >> 2);
+}
+
+// unquantizes a weight to [0, 64]
+inline int astc_unquantize_weight(int value, const IseRange &range)
+{
+    const int n = range.bits;
+    int result;
+    if (!range.trits && !range.quints)
+    {
+        result = 0;
+        for (int shift = 6 - n; shift > -n; shift -= n)
+            result |= shift >= 0 ? value << shift : value >> -shift;
+        result &= 0x3F;
+    }
+    else if (n == 0)
+    {
+        static const int trit_values[3] = {0, 32, 63};
+        static const int quint_values[5] = {0, 16, 32, 47, 63};
+        result = range.trits ? trit_values[value] : quint_values[value];
+    }
+    else
+    {
+        const int m = value & ((1 << n) - 1);
+        const int d = value >> n;
+        const int a = (m & 1) ? 0x7F : 0;
+        const int b = (m >> 1) & 1, c = (m >> 2) & 1;
+        int B = 0;
+        int C;
+        if (range.trits)
+        {
+            if (n == 1)
+                C = 50;
+            else if (n == 2)
+            {
+                B = b << 6 | b << 2 | b;
+                C = 23;
+            }
+            else
+            {
+                B = c << 6 | b << 5 | c << 1 | b;
+                C = 11;
+            }
+        }
+        else
+        {
+            if (n == 1)
+                C = 28;
+            else
+            {
+                B = b << 6 | b << 1;
+                C = 13;
+            }
+        }
+        int t = d * C + B;
+        t ^= a;
+        result = (a & 0x20) | (t >> 2);
+    }
+    return result > 32 ? result + 1 : result;
+}
+
+inline uint32_t astc_hash52(uint32_t p)
+{
+    p ^= p >> 15;
+    p -= p << 17;
+    p += p << 7;
+    p += p << 4;
+    p ^= p >> 5;
+    p += p << 16;
+    p ^= p >> 7;
+    p ^= p >> 3;
+    p ^= p << 6;
+    p ^= p >> 17;
+    return p;
+}
+
+inline int astc_select_partition(int seed, int x, int y, int partitions, bool small_block)
+{
+    if (small_block)
+    {
+        x <<= 1;
+        y <<= 1;
+    }
+    seed += (partitions - 1) * 1024;
+    const uint32_t rnum = astc_hash52(static_cast<uint32_t>(seed));
+    uint8_t seeds[8];
+    for (int i = 0; i < 8; i++)
+    {
+        seeds[i] = static_cast<uint8_t>((rnum >> (i * 4)) & 0xF);
+        seeds[i] = static_cast<uint8_t>(seeds[i] * seeds[i]);
+    }
+    int sh1, sh2;
+    if (seed & 1)
+    {
+        sh1 = (seed & 2) ? 4 : 5;
+        sh2 = partitions == 3 ? 6 : 5;
+    }
+    else
+    {
+        sh1 = partitions == 3 ? 6 : 5;
+        sh2 = (seed & 2) ? 4 : 5;
+    }
+    for (int i = 0; i < 8; i++)
+        seeds[i] >>= (i & 1) ? sh2 : sh1;
+
+    // the z seeds (9 - 12) drop out for 2D blocks
+    int a = (seeds[0] * x + seeds[1] * y + (rnum >> 14)) & 0x3F;
+    int b = (seeds[2] * x + seeds[3] * y + (rnum >> 10)) & 0x3F;
+    int c = (seeds[4] * x + seeds[5] * y + (rnum >> 6)) & 0x3F;
+    int d = (seeds[6] * x + seeds[7] * y + (rnum >> 2)) & 0x3F;
+    if (partitions < 4)
+        d = 0;
+    if (partitions < 3)
+        c = 0;
+    if (a >= b && a >= c && a >= d)
+        return 0;
+    if (b >= c && b >= d)
+        return 1;
+    if (c >= d)
+        return 2;
+    return 3;
+}
+
+// decodes the block mode into the weight grid size, dual plane flag and weight range, false if it's reserved
+inline bool astc_block_mode(int mode, int &grid_width, int &grid_height, bool &dual_plane, int &weight_range)
+{
+    int r;
+    int a = (mode >> 5) & 3;
+    int b;
+    bool high = (mode >> 9) & 1;
+    dual_plane = (mode >> 10) & 1;
+    if (mode & 3)
+    {
+        r = ((mode >> 4) & 1) | (mode & 3) << 1;
+        b = (mode >> 7) & 3;
+        switch ((mode >> 2) & 3)
+        {
+        case 0:
+            grid_width = b + 4;
+            grid_height = a + 2;
+            break;
+        case 1:
+            grid_width = b + 8;
+            grid_height = a + 2;
+            break;
+        case 2:
+            grid_width = a + 2;
+            grid_height = b + 8;
+            break;
+        default:
+            b &= 1;
+            if (mode & 0x100)
+            {
+                grid_width = b + 2;
+                grid_height = a + 2;
+            }
+            else
+            {
+                grid_width = a + 2;
+                grid_height = b + 6;
+            }
+            break;
+        }
+    }
+    else
+    {
+        if (((mode >> 2) & 3) == 0)
+            return false;
+        r = ((mode >> 4) & 1) | ((mode >> 2) & 3) << 1;
+        b = (mode >> 9) & 3;
+        switch ((mode >> 7) & 3)
+        {
+        case 0:
+            grid_width = 12;
+            grid_height = a + 2;
+            break;
+        case 1:
+            grid_width = a + 2;
+            grid_height = 12;
+            break;
+        case 2:
+            grid_width = a + 6;
+            grid_height = b + 6;
+            high = false;
+            dual_plane = false;
+            break;
+        default:
+            if (a == 0)
+            {
+                grid_width = 6;
+                grid_height = 10;
+            }
+            else if (a == 1)
+            {
+                grid_width = 10;
+                grid_height = 6;
+            }
+            else
+                return false;
+            break;
+        }
+    }
+    weight_range = r - 2 + (high ? 6 : 0);
+    return true;
+}
+
+inline void astc_bit_transfer_signed(int &a, int &b)
+{
+    b >>= 1;
+    b |= a & 0x80;
+    a >>= 1;
+    a &= 0x3F;
+    if (a & 0x20)
+        a -= 0x40;
+}
+
+inline void astc_blue_contract(int *color)
+{
+    color[0] = (color[0] + color[2]) >> 1;
+    color[1] = (color[1] + color[2]) >> 1;
+}
+
+// computes the two RGBA endpoints of a LDR color endpoint mode, false for the HDR modes
+inline bool astc_endpoints(int cem, const int *v, int e0[4], int e1[4])
+{
+    auto set = [](int *e, int r, int g, int b, int a)
+    {
+        e[0] = std::min(std::max(r, 0), 255);
+        e[1] = std::min(std::max(g, 0), 255);
+        e[2] = std::min(std::max(b, 0), 255);
+        e[3] = std::min(std::max(a, 0), 255);
+    };
+    int t[8];
+    std::copy(v, v + (cem / 4 + 1) * 2, t);
+    switch (cem)
+    {
+    case 0:
+        set(e0, t[0], t[0], t[0], 255);
+        set(e1, t[1], t[1], t[1], 255);
+        return true;
+    case 1:
+    {
+        const int l0 = (t[0] >> 2) | (t[1] & 0xC0);
+        const int l1 = std::min(l0 + (t[1] & 0x3F), 255);
+        set(e0, l0, l0, l0, 255);
+        set(e1, l1, l1, l1, 255);
+        return true;
+    }
+    case 4:
+        set(e0, t[0], t[0], t[0], t[2]);
+        set(e1, t[1], t[1], t[1], t[3]);
+        return true;
+    case 5:
+        astc_bit_transfer_signed(t[1], t[0]);
+        astc_bit_transfer_signed(t[3], t[2]);
+        set(e0, t[0], t[0], t[0], t[2]);
+        set(e1, t[0] + t[1], t[0] + t[1], t[0] + t[1], t[2] + t[3]);
+        return true;
+    case 6:
+        set(e0, (t[0] * t[3]) >> 8, (t[1] * t[3]) >> 8, (t[2] * t[3]) >> 8, 255);
+        set(e1, t[0], t[1], t[2], 255);
+        return true;
+    case 8:
+    case 12:
+    {
+        const int a0 = cem == 12 ? t[6] : 255;
+        const int a1 = cem == 12 ? t[7] : 255;
+        if (t[1] + t[3] + t[5] >= t[0] + t[2] + t[4])
+        {
+            set(e0, t[0], t[2], t[4], a0);
+            set(e1, t[1], t[3], t[5], a1);
+        }
+        else
+        {
+            set(e0, t[1], t[3], t[5], a1);
+            set(e1, t[0], t[2], t[4], a0);
+            astc_blue_contract(e0);
+            astc_blue_contract(e1);
+        }
+        return true;
+    }
+    case 9:
+    case 13:
+    {
+        astc_bit_transfer_signed(t[1], t[0]);
+        astc_bit_transfer_signed(t[3], t[2]);
+        astc_bit_transfer_signed(t[5], t[4]);
+        int a0 = 255, a1 = 255;
+        if (cem == 13)
+        {
+            astc_bit_transfer_signed(t[7], t[6]);
+            a0 = t[6];
+            a1 = t[6] + t[7];
+        }
+        if (t[1] + t[3] + t[5] >= 0)
+        {
+            set(e0, t[0], t[2], t[4], a0);
+            set(e1, t[0] + t[1], t[2] + t[3], t[4] + t[5], a1);
+        }
+        else
+        {
+            set(e0, t[0] + t[1], t[2] + t[3], t[4] + t[5], a1);
+            set(e1, t[0], t[2], t[4], a0);
+            astc_blue_contract(e0);
+            astc_blue_contract(e1);
+        }
+        return true;
+    }
+    case 10:
+        set(e0, (t[0] * t[3]) >> 8, (t[1] * t[3]) >> 8, (t[2] * t[3]) >> 8, t[4]);
+        set(e1, t[0], t[1], t[2], t[5]);
+        return true;
+    default:
+        return false;
+    }
+}
+
+inline void astc_fill(uint8_t *dst, size_t stride, int block_width, int block_height, const uint8_t color[4])
+{
+    for (int y = 0; y < block_height; y++)
+    {
+        for (int x = 0; x < block_width; x++)
+            memcpy(dst + y * stride + x * 4, color, 4);
+    }
+}
+
+void decode_astc(const uint8_t *block, uint8_t *dst, size_t stride, int block_width, int block_height)
+{
+    // illegal and HDR blocks decode to the error color
+    static const uint8_t error_color[4] = {255, 0, 255, 255};
+    const BlockBits bits(block);
+    const int mode = bits.get(0, 11);
+
+    if ((mode & 0x1FF) == 0x1FC)
+    {
+        // void extent, a single UNORM16 color
+        if (mode & 0x200)
+            return astc_fill(dst, stride, block_width, block_height, error_color);
+        uint8_t color[4];
+        for (int c = 0; c < 4; c++)
+            color[c] = block[8 + c * 2 + 1];
+        return astc_fill(dst, stride, block_width, block_height, color);
+    }
+
+    int grid_width, grid_height, weight_range;
+    bool dual_plane;
+    if (!astc_block_mode(mode, grid_width, grid_height, dual_plane, weight_range) || grid_width > block_width || grid_height > block_height)
+        return astc_fill(dst, stride, block_width, block_height, error_color);
+    const int partitions = bits.get(11, 2) + 1;
+    const int weight_count = grid_width * grid_height * (dual_plane ? 2 : 1);
+    const int weight_bits = ise_size(weight_count, ise_ranges[weight_range]);
+    if (weight_count > 64 || weight_bits < 24 || weight_bits > 96 || (dual_plane && partitions == 4))
+        return astc_fill(dst, stride, block_width, block_height, error_color);
+
+    int cems[4];
+    int seed = 0;
+    int config_end;
+    int extra_bits = 0;
+    if (partitions == 1)
+    {
+        cems[0] = bits.get(13, 4);
+        config_end = 17;
+    }
+    else
+    {
+        seed = bits.get(13, 10);
+        config_end = 29;
+        uint32_t encoded = bits.get(23, 6);
+        if ((encoded & 3) == 0)
+        {
+            for (int p = 0; p < partitions; p++)
+                cems[p] = encoded >> 2;
+        }
+        else
+        {
+            // the remaining class and mode bits sit right below the weights
+            extra_bits = 3 * partitions - 4;
+            encoded |= bits.get(128 - weight_bits - extra_bits, extra_bits) << 6;
+            const int base_class = (encoded & 3) - 1;
+            encoded >>= 2;
+            for (int p = 0; p < partitions; p++)
+                cems[p] = (((encoded >> p) & 1) + base_class) << 2;
+            encoded >>= partitions;
+            for (int p = 0; p < partitions; p++)
+            {
+                cems[p] |= encoded & 3;
+                encoded >>= 2;
+            }
+        }
+    }
+    const int below_weights = 128 - weight_bits - extra_bits;
+    const int ccs = dual_plane ? bits.get(below_weights - 2, 2) : -1;
+    const int color_end = below_weights - (dual_plane ? 2 : 0);
+
+    int value_count = 0;
+    for (int p = 0; p < partitions; p++)
+        value_count += (cems[p] / 4 + 1) * 2;
+    int color_range = -1;
+    for (int i = 20; i >= 4 && value_count <= 18; i--)
+    {
+        if (ise_size(value_count, ise_ranges[i]) <= color_end - config_end)
+        {
+            color_range = i;
+            break;
+        }
+    }
+    if (color_range < 0)
+        return astc_fill(dst, stride, block_width, block_height, error_color);
+
+    int values[18];
+    decode_ise(bits, config_end, value_count, ise_ranges[color_range], values);
+    for (int i = 0; i < value_count; i++)
+        values[i] = astc_unquantize_color(values[i], ise_ranges[color_range]);
+    int endpoints[4][2][4];
+    for (int p = 0, offset = 0; p < partitions; offset += (cems[p] / 4 + 1) * 2, p++)
+    {
+        if (!astc_endpoints(cems[p], values + offset, endpoints[p][0], endpoints[p][1]))
+            return astc_fill(dst, stride, block_width, block_height, error_color);
+    }
+
+    // the weights are stored bit reversed from the end of the block
+    uint8_t reversed[16];
+    for (int i = 0; i < 16; i++)
+    {
+        uint8_t byte = block[15 - i];
+        byte = static_cast<uint8_t>((byte & 0xF0) >> 4 | (byte & 0x0F) << 4);
+        byte = static_cast<uint8_t>((byte & 0xCC) >> 2 | (byte & 0x33) << 2);
+        byte = static_cast<uint8_t>((byte & 0xAA) >> 1 | (byte & 0x55) << 1);
+        reversed[i] = byte;
+    }
+    int weights[64];
+    decode_ise(BlockBits(reversed), 0, weight_count, ise_ranges[weight_range], weights);
+    // padded, so that the infill can read one past the grid where its factor is 0
+    int planes[2][64 + 16] = {};
+    for (int i = 0; i < weight_count; i++)
+    {
+        const int plane = dual_plane ? i & 1 : 0;
+        planes[plane][dual_plane ? i / 2 : i] = astc_unquantize_weight(weights[i], ise_ranges[weight_range]);
+    }
+
+    const int ds = (1024 + block_width / 2) / (block_width - 1);
+    const int dt = (1024 + block_height / 2) / (block_height - 1);
+    const bool small_block = block_width * block_height < 31;
+    for (int y = 0; y < block_height; y++)
+    {
+        for (int x = 0; x < block_width; x++)
+        {
+            // bilinear infill of the weight grid
+            const int gs = (ds * x * (grid_width - 1) + 32) >> 6;
+            const int gt = (dt * y * (grid_height - 1) + 32) >> 6;
+            const int fs = gs & 0xF;
+            const int ft = gt & 0xF;
+            const int v0 = (gs >> 4) + (gt >> 4) * grid_width;
+            const int w11 = (fs * ft + 8) >> 4;
+            const int w10 = ft - w11;
+            const int w01 = fs - w11;
+            const int w00 = 16 - fs - ft + w11;
+            int texel_weights[2];
+            for (int plane = 0; plane < (dual_plane ? 2 : 1); plane++)
+            {
+                const int *grid = planes[plane];
+                texel_weights[plane] = (grid[v0] * w00 + grid[v0 + 1] * w01 + grid[v0 + grid_width] * w10 + grid[v0 + grid_width + 1] * w11 + 8) >> 4;
+            }
+
+            const int partition = partitions > 1 ? astc_select_partition(seed, x, y, partitions, small_block) : 0;
+            uint8_t *pixel = dst + y * stride + x * 4;
+            for (int c = 0; c < 4; c++)
+            {
+                const int weight = texel_weights[c == ccs ? 1 : 0];
+                const int e0 = endpoints[partition][0][c] * 257;
+                const int e1 = endpoints[partition][1][c] * 257;
+                pixel[c] = static_cast<uint8_t>(((e0 * (64 - weight) + e1 * weight + 32) >> 6) >> 8);
+            }
+        }
+    }
+}
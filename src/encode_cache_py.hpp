@@ -0,0 +1,341 @@
+#pragma once
+#include <Python.h>
+#include <cstdio>
+#include "structmember.h"
+
+PyTypeObject *EncodeCacheObjectType = nullptr;
+
+// Header of an entry file of an EncodeCache, followed by the compressed blocks.
+// The file is named after the digest, the rest is repeated so that stale and damaged files are rejected.
+struct EncodeCacheHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint64_t fingerprint;
+    int32_t width;
+    int32_t height;
+    int32_t pixel_format;
+    int32_t reserved;
+    uint64_t size;
+    uint8_t digest[32];
+};
+
+const char encode_cache_magic[4] = {'I', 'T', 'C', 'E'};
+// bumped whenever the layout or the output of the kernels changes
+const uint32_t encode_cache_version = 2;
+
+// Fills in the header of the entry of a surface. The digest is a BLAKE2b-256 of the header fields before it
+// and the pixel rows (without the stride padding), so different inputs only share an entry if it collides.
+// Needs the GIL, hashlib releases it itself while hashing large rows.
+bool encode_cache_header(const FormatInfo &format, const EncSettings &settings, const rgba_surface &src, PixelFormat pixel_format, EncodeCacheHeader &header) noexcept
+{
+    header = {};
+    memcpy(header.magic, encode_cache_magic, sizeof(header.magic));
+    header.version = encode_cache_version;
+    header.fingerprint = format_fingerprint(format, settings);
+    header.width = src.width;
+    header.height = src.height;
+    header.pixel_format = static_cast<int32_t>(pixel_format);
+    header.size = compressed_size(format, settings, src.width, src.height);
+
+    PyObject *hashlib = PyImport_ImportModule("hashlib");
+    PyObject *blake2b = hashlib ? PyObject_GetAttrString(hashlib, "blake2b") : nullptr;
+    Py_XDECREF(hashlib);
+    PyObject *call_args = blake2b ? PyTuple_New(0) : nullptr;
+    PyObject *call_kwds = call_args ? Py_BuildValue("{s:i}", "digest_size", static_cast<int>(sizeof(header.digest))) : nullptr;
+    PyObject *hasher = call_kwds ? PyObject_Call(blake2b, call_args, call_kwds) : nullptr;
+    Py_XDECREF(blake2b);
+    Py_XDECREF(call_args);
+    Py_XDECREF(call_kwds);
+    if (!hasher)
+        return false;
+
+    const int pixel_size = pixel_format == PixelFormat::native ? format.pixel_size : get_pixel_format(pixel_format).pixel_size();
+    const size_t row_size = static_cast<size_t>(src.width) * pixel_size;
+    // a single update if the rows are packed
+    const bool packed = static_cast<size_t>(src.stride) == row_size;
+    bool success = true;
+    for (int y = -1; success && y < (packed ? 1 : src.height); y++)
+    {
+        PyObject *data = y < 0 ? PyMemoryView_FromMemory(reinterpret_cast<char *>(&header), offsetof(EncodeCacheHeader, digest), PyBUF_READ)
+                               : PyMemoryView_FromMemory(reinterpret_cast<char *>(src.ptr) + static_cast<size_t>(y) * src.stride,
+                                                         packed ? row_size * src.height : row_size, PyBUF_READ);
+        PyObject *updated = data ? PyObject_CallMethod(hasher, "update", "O", data) : nullptr;
+        Py_XDECREF(data);
+        Py_XDECREF(updated);
+        success = updated != nullptr;
+    }
+    PyObject *digest = success ? PyObject_CallMethod(hasher, "digest", nullptr) : nullptr;
+    Py_DECREF(hasher);
+    if (!digest)
+        return false;
+    success = PyBytes_Size(digest) == sizeof(header.digest);
+    if (success)
+        memcpy(header.digest, PyBytes_AsString(digest), sizeof(header.digest));
+    else
+        PyErr_SetString(PyExc_RuntimeError, "unexpected blake2b digest size");
+    Py_DECREF(digest);
+    return success;
+}
+
+unsigned long current_process_id() noexcept
+{
+#if defined(_WIN32)
+    return GetCurrentProcessId();
+#else
+    return static_cast<unsigned long>(getpid());
+#endif
+}
+
+// A directory of compressed textures, keyed by their pixels, geometry, format and settings.
+typedef struct
+{
+    PyObject_HEAD
+        // str
+        PyObject *directory;
+    Py_ssize_t hits;
+    Py_ssize_t misses;
+    Py_ssize_t store_failures;
+} EncodeCacheObject;
+
+void EncodeCache_dealloc(EncodeCacheObject *self)
+{
+    Py_XDECREF(self->directory);
+    PyObject_Del((PyObject *)self);
+}
+
+int EncodeCache_init(EncodeCacheObject *self, PyObject *args, PyObject *kwds)
+{
+    static const char *kwlist[] = {
+        "directory",
+        nullptr};
+
+    PyObject *directory = nullptr;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&", const_cast<char **>(kwlist), PyUnicode_FSDecoder, &directory))
+        return -1;
+
+    // created like os.makedirs(directory, exist_ok=True)
+    PyObject *os = PyImport_ImportModule("os");
+    PyObject *makedirs = os ? PyObject_GetAttrString(os, "makedirs") : nullptr;
+    Py_XDECREF(os);
+    PyObject *call_args = makedirs ? PyTuple_Pack(1, directory) : nullptr;
+    PyObject *call_kwds = call_args ? Py_BuildValue("{s:O}", "exist_ok", Py_True) : nullptr;
+    PyObject *created = call_kwds ? PyObject_Call(makedirs, call_args, call_kwds) : nullptr;
+    Py_XDECREF(makedirs);
+    Py_XDECREF(call_args);
+    Py_XDECREF(call_kwds);
+    if (!created)
+    {
+        Py_DECREF(directory);
+        return -1;
+    }
+    Py_DECREF(created);
+
+    Py_XDECREF(self->directory);
+    self->directory = directory;
+    self->hits = 0;
+    self->misses = 0;
+    self->store_failures = 0;
+    return 0;
+}
+
+// path of the entry file of the header, with the suffix appended
+PyObject *encode_cache_path(EncodeCacheObject *self, const EncodeCacheHeader &header, const char *suffix) noexcept
+{
+    char name[2 * sizeof(header.digest) + 1];
+    for (size_t i = 0; i < sizeof(header.digest); i++)
+        snprintf(name + 2 * i, 3, "%02x", header.digest[i]);
+    return PyUnicode_FromFormat("%U/%s.%s", self->directory, name, suffix);
+}
+
+// Reads the blocks of the entry at path into result, which stays nullptr if there is no matching entry
+// or it can't be read. Returns false with the exception set if creating the result fails.
+bool encode_cache_load(PyObject *path, const EncodeCacheHeader &header, PyObject *&result) noexcept
+{
+    result = nullptr;
+    MappedFile file;
+    if (!map_file(path, false, 0, sizeof(header) + header.size, file))
+    {
+        // missing, unreadable or truncated
+        if (!PyErr_ExceptionMatches(PyExc_OSError) && !PyErr_ExceptionMatches(PyExc_ValueError))
+            return false;
+        PyErr_Clear();
+        return true;
+    }
+    bool success = true;
+    if (memcmp(file.data, &header, sizeof(header)) == 0)
+    {
+        result = PyBytes_FromStringAndSize(reinterpret_cast<const char *>(file.data) + sizeof(header), header.size);
+        success = result != nullptr;
+    }
+    unmap_file(file);
+    return success;
+}
+
+// Writes the entry to a file of this process and thread first and moves it into place,
+// so that concurrent readers and writers never see a partial entry. Plain writes instead of a mapping,
+// so that a full disk is an OSError rather than a SIGBUS. Storing is best effort, on failure the temporary
+// file is removed, the exception cleared and false returned.
+bool encode_cache_store(PyObject *path, const EncodeCacheHeader &header, const uint8_t *blocks) noexcept
+{
+    PyObject *temp = PyUnicode_FromFormat("%U.%lu.%lu.tmp", path, current_process_id(), PyThread_get_thread_ident());
+    if (!temp)
+    {
+        PyErr_Clear();
+        return false;
+    }
+    PyObject *io = PyImport_ImportModule("io");
+    PyObject *file = io ? PyObject_CallMethod(io, "open", "Os", temp, "wb") : nullptr;
+    Py_XDECREF(io);
+    if (!file)
+    {
+        PyErr_Clear();
+        Py_DECREF(temp);
+        return false;
+    }
+
+    bool stored = true;
+    const char *parts[2] = {reinterpret_cast<const char *>(&header), reinterpret_cast<const char *>(blocks)};
+    const Py_ssize_t sizes[2] = {sizeof(header), static_cast<Py_ssize_t>(header.size)};
+    for (int i = 0; stored && i < 2; i++)
+    {
+        PyObject *data = PyMemoryView_FromMemory(const_cast<char *>(parts[i]), sizes[i], PyBUF_READ);
+        PyObject *written = data ? PyObject_CallMethod(file, "write", "O", data) : nullptr;
+        Py_XDECREF(data);
+        Py_XDECREF(written);
+        stored = written != nullptr;
+    }
+    PyErr_Clear();
+    // closing flushes the buffered tail, which may fail as well
+    PyObject *closed = PyObject_CallMethod(file, "close", nullptr);
+    Py_DECREF(file);
+    Py_XDECREF(closed);
+    stored &= closed != nullptr;
+    PyErr_Clear();
+
+    PyObject *os = PyImport_ImportModule("os");
+    if (os)
+    {
+        PyObject *moved = stored ? PyObject_CallMethod(os, "replace", "OO", temp, path) : nullptr;
+        Py_XDECREF(moved);
+        stored = moved != nullptr;
+        PyErr_Clear();
+        if (!stored)
+        {
+            PyObject *removed = PyObject_CallMethod(os, "remove", "O", temp);
+            Py_XDECREF(removed);
+        }
+        Py_DECREF(os);
+    }
+    else
+        stored = false;
+    PyErr_Clear();
+    Py_DECREF(temp);
+    return stored;
+}
+
+PyObject *EncodeCache_compress(EncodeCacheObject *self, PyObject *args, PyObject *kwds)
+{
+    static const char *kwlist[] = {"rgba", "format", "settings", "threads", nullptr};
+    RGBASurfaceObject *py_src;
+    const char *format_name;
+    PyObject *py_settings = nullptr;
+    int threads = 1;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!s|O$O&", const_cast<char **>(kwlist), RGBASurfaceObjectType, &py_src, &format_name, &py_settings, threads_converter, &threads))
+        return nullptr;
+    if (!self->directory)
+    {
+        PyErr_SetString(PyExc_ValueError, "EncodeCache is not initialized");
+        return nullptr;
+    }
+
+    const FormatInfo *format = find_format(format_name);
+    if (!format)
+        return nullptr;
+    EncSettings settings = {};
+    if (!parse_settings(*format, py_settings, settings))
+        return nullptr;
+
+    const rgba_surface src = py_src->surf;
+    if (!check_native_stride(*format, src, py_src->pixel_format))
+        return nullptr;
+    EncodeCacheHeader header;
+    if (!encode_cache_header(*format, settings, src, py_src->pixel_format, header))
+        return nullptr;
+    PyObject *path = encode_cache_path(self, header, "bin");
+    if (!path)
+        return nullptr;
+    PyObject *result;
+    if (!encode_cache_load(path, header, result))
+    {
+        Py_DECREF(path);
+        return nullptr;
+    }
+    if (result)
+    {
+        self->hits++;
+        Py_DECREF(path);
+        return result;
+    }
+
+    self->misses++;
+    result = PyBytes_FromStringAndSize(nullptr, header.size);
+    if (!result)
+    {
+        Py_DECREF(path);
+        return nullptr;
+    }
+    uint8_t *dst = (uint8_t *)PyBytes_AsString(result);
+    Py_BEGIN_ALLOW_THREADS
+        compress_surface(*format, settings, src, dst, threads, py_src->pixel_format);
+    Py_END_ALLOW_THREADS
+
+        const bool stored = encode_cache_store(path, header, dst);
+    Py_DECREF(path);
+    // the blocks are returned even if they couldn't be stored, e.g. on a full disk
+    if (!stored)
+        self->store_failures++;
+    return result;
+}
+
+PyMemberDef EncodeCache_members[] = {
+    {"directory", T_OBJECT, offsetof(EncodeCacheObject, directory), READONLY, "directory"},
+    {"hits", T_PYSSIZET, offsetof(EncodeCacheObject, hits), READONLY, "hits"},
+    {"misses", T_PYSSIZET, offsetof(EncodeCacheObject, misses), READONLY, "misses"},
+    {"store_failures", T_PYSSIZET, offsetof(EncodeCacheObject, store_failures), READONLY, "store_failures"},
+    {NULL} /* Sentinel */
+};
+
+PyMethodDef EncodeCache_methods[] = {
+    {"compress", (PyCFunction)EncodeCache_compress, METH_VARARGS | METH_KEYWORDS, "return the cached blocks of a surface, compressing and storing them on a miss"},
+    {NULL} /* Sentinel */
+};
+
+PyObject *EncodeCache_repr(PyObject *self)
+{
+    EncodeCacheObject *node = (EncodeCacheObject *)self;
+    return PyUnicode_FromFormat(
+        "<EncodeCache (directory:%R, hits:%zd, misses:%zd, store_failures:%zd)>",
+        node->directory ? node->directory : Py_None,
+        node->hits,
+        node->misses,
+        node->store_failures);
+}
+
+PyType_Slot EncodeCacheType_slots[] = {
+    {Py_tp_new, reinterpret_cast<void *>(PyType_GenericNew)},
+    {Py_tp_init, reinterpret_cast<void *>(EncodeCache_init)},
+    {Py_tp_dealloc, reinterpret_cast<void *>(EncodeCache_dealloc)},
+    {Py_tp_members, EncodeCache_members},
+    {Py_tp_methods, reinterpret_cast<void *>(EncodeCache_methods)},
+    {Py_tp_repr, reinterpret_cast<void *>(EncodeCache_repr)},
+    {0, NULL},
+};
+
+PyType_Spec EncodeCacheType_Spec = {
+    "ispc_texcomp.EncodeCache",               // const char* name;
+    sizeof(EncodeCacheObject),                // int basicsize;
+    0,                                        // int itemsize;
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE, // unsigned int flags;
+    EncodeCacheType_slots,                    // PyType_Slot *slots;
+};
@@ -0,0 +1,191 @@
+#pragma once
+#include <Python.h>
+#include "structmember.h"
+#include <cstdlib>
+
+PyTypeObject *EncoderObjectType = nullptr;
+
+// Compresses frames of a fixed size into the same output buffer over and over, for video and capture streams.
+// The format and settings are validated once, the per-thread conversion and edge scratch is kept by the workers,
+// so an encode call doesn't allocate anything but the memoryview it returns.
+typedef struct
+{
+    PyObject_HEAD
+        const FormatInfo *format;
+    EncSettings settings;
+    int width;
+    int height;
+    int threads;
+    bool busy;
+    // the compressed frame, exported through the buffer protocol
+    uint8_t *buffer;
+    Py_ssize_t size;
+    Py_ssize_t exports;
+} EncoderObject;
+
+void Encoder_dealloc(EncoderObject *self)
+{
+    free(self->buffer);
+    PyObject_Del((PyObject *)self);
+}
+
+int Encoder_init(EncoderObject *self, PyObject *args, PyObject *kwds)
+{
+    static const char *kwlist[] = {"format", "width", "height", "settings", "threads", nullptr};
+    const char *format_name;
+    int width;
+    int height;
+    PyObject *py_settings = nullptr;
+    int threads = 1;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "sii|O$O&", const_cast<char **>(kwlist), &format_name, &width, &height, &py_settings, threads_converter, &threads))
+        return -1;
+    // the views of the previous frames, or a running encode, would point to freed memory
+    if (self->exports > 0 || self->busy)
+    {
+        PyErr_SetString(PyExc_BufferError, "Encoder can't be reinitialized while its frame is exported or encoded");
+        return -1;
+    }
+
+    const FormatInfo *format = find_format(format_name);
+    if (!format)
+        return -1;
+    EncSettings settings = {};
+    if (!parse_settings(*format, py_settings, settings))
+        return -1;
+    if (width <= 0 || height <= 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "width and height must be > 0");
+        return -1;
+    }
+
+    const size_t size = compressed_size(*format, settings, width, height);
+    uint8_t *buffer = static_cast<uint8_t *>(calloc(size, 1));
+    if (!buffer)
+    {
+        PyErr_NoMemory();
+        return -1;
+    }
+    free(self->buffer);
+    self->buffer = buffer;
+    self->size = static_cast<Py_ssize_t>(size);
+    self->format = format;
+    self->settings = settings;
+    self->width = width;
+    self->height = height;
+    self->threads = threads;
+    return 0;
+}
+
+// the fast path, the surface is the only argument
+PyObject *Encoder_encode(EncoderObject *self, PyObject *py_src)
+{
+    if (!self->buffer)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "Encoder isn't initialized");
+        return nullptr;
+    }
+    if (!PyObject_TypeCheck(py_src, RGBASurfaceObjectType))
+    {
+        PyErr_SetString(PyExc_TypeError, "surface has to be a RGBASurface");
+        return nullptr;
+    }
+    const RGBASurfaceObject *src = reinterpret_cast<RGBASurfaceObject *>(py_src);
+    if (src->surf.width != self->width || src->surf.height != self->height)
+    {
+        PyErr_Format(PyExc_ValueError, "the surface is %dx%d, the encoder %dx%d", src->surf.width, src->surf.height, self->width, self->height);
+        return nullptr;
+    }
+    if (self->busy)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "encode is already running in another thread");
+        return nullptr;
+    }
+    if (!check_native_stride(*self->format, src->surf, src->pixel_format))
+        return nullptr;
+
+    self->busy = true;
+    const rgba_surface surf = src->surf;
+    const PixelFormat pixel_format = src->pixel_format;
+    Py_BEGIN_ALLOW_THREADS
+        compress_surface(*self->format, self->settings, surf, self->buffer, self->threads, pixel_format);
+    Py_END_ALLOW_THREADS self->busy = false;
+    return PyMemoryView_FromObject(reinterpret_cast<PyObject *>(self));
+}
+
+// read-only, the frame is only written by encode
+static int Encoder_getbuffer(EncoderObject *self, Py_buffer *view, int flags)
+{
+    if (!self->buffer)
+    {
+        PyErr_SetString(PyExc_BufferError, "Encoder isn't initialized");
+        return -1;
+    }
+    if (PyBuffer_FillInfo(view, reinterpret_cast<PyObject *>(self), self->buffer, self->size, 1, flags) < 0)
+        return -1;
+    self->exports++;
+    return 0;
+}
+
+static void Encoder_releasebuffer(EncoderObject *self, Py_buffer *view)
+{
+    self->exports--;
+}
+
+PyObject *Encoder_getBlockWidth(EncoderObject *self, void *closure)
+{
+    return PyLong_FromLong(self->format ? self->format->get_block_width(self->settings) : 0);
+}
+
+PyObject *Encoder_getBlockHeight(EncoderObject *self, void *closure)
+{
+    return PyLong_FromLong(self->format ? self->format->get_block_height(self->settings) : 0);
+}
+
+PyMemberDef Encoder_members[] = {
+    {"width", T_INT, offsetof(EncoderObject, width), READONLY, "width"},
+    {"height", T_INT, offsetof(EncoderObject, height), READONLY, "height"},
+    {"size", T_PYSSIZET, offsetof(EncoderObject, size), READONLY, "size"},
+    {NULL} /* Sentinel */
+};
+
+PyGetSetDef Encoder_getsetters[] = {
+    {"block_width", (getter)Encoder_getBlockWidth, NULL, "block_width", NULL},
+    {"block_height", (getter)Encoder_getBlockHeight, NULL, "block_height", NULL},
+    {NULL} /* Sentinel */
+};
+
+PyMethodDef Encoder_methods[] = {
+    {"encode", (PyCFunction)Encoder_encode, METH_O, "compress a frame into the reused output buffer"},
+    {NULL} /* Sentinel */
+};
+
+PyObject *Encoder_repr(PyObject *self)
+{
+    EncoderObject *node = (EncoderObject *)self;
+    return PyUnicode_FromFormat(
+        "<Encoder (f:%s, w:%d, h:%d)>",
+        node->format ? node->format->name : "",
+        node->width,
+        node->height);
+}
+
+PyType_Slot EncoderType_slots[] = {
+    {Py_tp_new, reinterpret_cast<void *>(PyType_GenericNew)},
+    {Py_tp_init, reinterpret_cast<void *>(Encoder_init)},
+    {Py_tp_dealloc, reinterpret_cast<void *>(Encoder_dealloc)},
+    {Py_tp_members, Encoder_members},
+    {Py_tp_getset, reinterpret_cast<void *>(Encoder_getsetters)},
+    {Py_tp_methods, reinterpret_cast<void *>(Encoder_methods)},
+    {Py_tp_repr, reinterpret_cast<void *>(Encoder_repr)},
+    {Py_bf_getbuffer, reinterpret_cast<void *>(Encoder_getbuffer)},
+    {Py_bf_releasebuffer, reinterpret_cast<void *>(Encoder_releasebuffer)},
+    {0, NULL},
+};
+
+PyType_Spec EncoderType_Spec = {
+    "ispc_texcomp.Encoder",                   // const char* name;
+    sizeof(EncoderObject),                    // int basicsize;
+    0,                                        // int itemsize;
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE, // unsigned int flags;
+    EncoderType_slots,                        // PyType_Slot *slots;
+};
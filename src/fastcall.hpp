@@ -0,0 +1,133 @@
+#pragma once
+#include <Python.h>
+#include <climits>
+
+// Matches the arguments of a METH_FASTCALL | METH_KEYWORDS call against kwlist, without building an args tuple
+// and a kwargs dict or parsing a format string like PyArg_ParseTupleAndKeywords does.
+// The first `positional` names may be passed positionally, the rest only as keywords, the first `required` ones
+// have to be passed. values[i] is set to the borrowed argument of kwlist[i], or nullptr if it's missing.
+// Sets a TypeError naming the function fname and returns false on invalid calls.
+bool parse_fastcall(const char *fname, const char *const *kwlist, int count, int positional, int required, PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames, PyObject **values) noexcept
+{
+    if (nargs > positional)
+    {
+        PyErr_Format(PyExc_TypeError, "%s() takes at most %d positional argument%s (%zd given)", fname, positional, positional == 1 ? "" : "s", nargs);
+        return false;
+    }
+    for (int i = 0; i < count; i++)
+        values[i] = i < nargs ? args[i] : nullptr;
+
+    const Py_ssize_t kwcount = kwnames ? PyTuple_Size(kwnames) : 0;
+    for (Py_ssize_t k = 0; k < kwcount; k++)
+    {
+        PyObject *name = PyTuple_GetItem(kwnames, k);
+        int i = 0;
+        while (i < count && PyUnicode_CompareWithASCIIString(name, kwlist[i]) != 0)
+            i++;
+        if (i == count)
+        {
+            PyErr_Format(PyExc_TypeError, "'%U' is an invalid keyword argument for %s()", name, fname);
+            return false;
+        }
+        if (values[i])
+        {
+            PyErr_Format(PyExc_TypeError, "argument for %s() given by name ('%s') and position (%d)", fname, kwlist[i], i + 1);
+            return false;
+        }
+        values[i] = args[nargs + k];
+    }
+
+    for (int i = 0; i < required; i++)
+    {
+        if (!values[i])
+        {
+            PyErr_Format(PyExc_TypeError, "%s() missing required argument '%s' (pos %d)", fname, kwlist[i], i + 1);
+            return false;
+        }
+    }
+    return true;
+}
+
+// an int argument, value is left as is if the argument is missing
+bool fastcall_int(PyObject *arg, const char *fname, const char *name, int &value) noexcept
+{
+    if (!arg)
+        return true;
+    const long result = PyLong_AsLong(arg);
+    if (result == -1 && PyErr_Occurred())
+        return false;
+    if (result < INT_MIN || result > INT_MAX)
+    {
+        PyErr_Format(PyExc_OverflowError, "%s() argument '%s' doesn't fit into an int", fname, name);
+        return false;
+    }
+    value = static_cast<int>(result);
+    return true;
+}
+
+// The threads argument of the compress and decompress functions is 0 for all pool workers or the number of tasks the
+// rows are split into, checked here so that all of them reject the same values.
+bool check_threads(int threads) noexcept
+{
+    if (threads < 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "threads must be >= 0");
+        return false;
+    }
+    return true;
+}
+
+// an "O&" converter for the threads argument
+int threads_converter(PyObject *arg, void *address) noexcept
+{
+    const long result = PyLong_AsLong(arg);
+    if (result == -1 && PyErr_Occurred())
+        return 0;
+    if (result > INT_MAX)
+    {
+        PyErr_SetString(PyExc_OverflowError, "threads doesn't fit into an int");
+        return 0;
+    }
+    if (!check_threads(result < 0 ? -1 : static_cast<int>(result)))
+        return 0;
+    *static_cast<int *>(address) = static_cast<int>(result);
+    return 1;
+}
+
+// a Py_ssize_t argument, value is left as is if the argument is missing
+bool fastcall_ssize(PyObject *arg, Py_ssize_t &value) noexcept
+{
+    if (!arg)
+        return true;
+    const Py_ssize_t result = PyLong_AsSsize_t(arg);
+    if (result == -1 && PyErr_Occurred())
+        return false;
+    value = result;
+    return true;
+}
+
+// a bool argument converted like the "p" format unit, value is left as is if the argument is missing
+bool fastcall_bool(PyObject *arg, int &value) noexcept
+{
+    if (!arg)
+        return true;
+    const int result = PyObject_IsTrue(arg);
+    if (result < 0)
+        return false;
+    value = result;
+    return true;
+}
+
+// an argument of the given type, like the "O!" format unit
+bool fastcall_type(PyObject *arg, PyTypeObject *type, const char *fname, const char *name) noexcept
+{
+    if (PyObject_TypeCheck(arg, type))
+        return true;
+    PyObject *type_name = PyType_GetName(type);
+    PyObject *arg_type_name = PyType_GetName(Py_TYPE(arg));
+    if (type_name && arg_type_name)
+        PyErr_Format(PyExc_TypeError, "%s() argument '%s' must be %U, not %U", fname, name, type_name, arg_type_name);
+    Py_XDECREF(type_name);
+    Py_XDECREF(arg_type_name);
+    return false;
+}
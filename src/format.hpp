@@ -0,0 +1,365 @@
+#pragma once
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include "Python.h"
+
+// storage for the settings of any format, so that format independent code can carry them around by value
+union EncSettings
+{
+    bc6h_enc_settings bc6h;
+    bc7_enc_settings bc7;
+    etc_enc_settings etc;
+    astc_enc_settings astc;
+};
+
+template <void (*compress_func)(const rgba_surface *, uint8_t *)>
+void compress_plain(const rgba_surface *src, uint8_t *dst, EncSettings &)
+{
+    compress_func(src, dst);
+}
+
+template <class Settings, void (*compress_func)(const rgba_surface *, uint8_t *, Settings *), Settings EncSettings::*member>
+void compress_with(const rgba_surface *src, uint8_t *dst, EncSettings &settings)
+{
+    compress_func(src, dst, &(settings.*member));
+}
+
+template <class SettingsObject, auto member>
+void copy_settings(PyObject *py_settings, EncSettings &settings)
+{
+    settings.*member = reinterpret_cast<SettingsObject *>(py_settings)->settings;
+}
+
+template <class Settings, Settings EncSettings::*member>
+uint64_t fingerprint_with(const EncSettings &settings)
+{
+    return settings_fingerprint(settings.*member);
+}
+
+struct FormatInfo
+{
+    const char *name;
+    // block footprint in pixels, 0 if it's defined by the settings (ASTC)
+    int block_width;
+    int block_height;
+    // bytes per compressed block
+    size_t block_size;
+    // bytes per pixel of the kernel input
+    int pixel_size;
+    // channels of the kernel input stored in the blocks, the others decode to a constant
+    int channels;
+    // nullptr for the formats without settings
+    PyTypeObject **settings_type;
+    void (*copy_settings)(PyObject *py_settings, EncSettings &settings);
+    uint64_t (*fingerprint)(const EncSettings &settings);
+    void (*compress)(const rgba_surface *src, uint8_t *dst, EncSettings &settings);
+    // decodes one block into the kernel input layout, rows being stride bytes apart
+    void (*decompress)(const uint8_t *block, uint8_t *dst, size_t stride, int block_width, int block_height);
+
+    int get_block_width(const EncSettings &settings) const { return block_width ? block_width : settings.astc.block_width; }
+    int get_block_height(const EncSettings &settings) const { return block_height ? block_height : settings.astc.block_height; }
+
+    // number of blocks covering the surface, partial blocks at the right and bottom edge included
+    int blocks_x(const EncSettings &settings, int width) const
+    {
+        const int block_width = get_block_width(settings);
+        return (width + block_width - 1) / block_width;
+    }
+    int blocks_y(const EncSettings &settings, int height) const
+    {
+        const int block_height = get_block_height(settings);
+        return (height + block_height - 1) / block_height;
+    }
+};
+
+// indices into formats
+enum FormatId : size_t
+{
+    FORMAT_BC1,
+    FORMAT_BC3,
+    FORMAT_BC4,
+    FORMAT_BC5,
+    FORMAT_BC6H,
+    FORMAT_BC7,
+    FORMAT_ETC1,
+    FORMAT_ASTC,
+};
+
+const FormatInfo formats[] = {
+    {"bc1", 4, 4, 8, 4, 3, nullptr, nullptr, nullptr, compress_plain<CompressBlocksBC1>, decode_bc1},
+    {"bc3", 4, 4, 16, 4, 4, nullptr, nullptr, nullptr, compress_plain<CompressBlocksBC3>, decode_bc3},
+    {"bc4", 4, 4, 8, 1, 1, nullptr, nullptr, nullptr, compress_plain<CompressBlocksBC4>, decode_bc4},
+    {"bc5", 4, 4, 16, 2, 2, nullptr, nullptr, nullptr, compress_plain<CompressBlocksBC5>, decode_bc5},
+    {"bc6h", 4, 4, 16, 8, 3, &BC6HEncSettingsObjectType, copy_settings<BC6HEncSettingsObject, &EncSettings::bc6h>, fingerprint_with<bc6h_enc_settings, &EncSettings::bc6h>, compress_with<bc6h_enc_settings, CompressBlocksBC6H, &EncSettings::bc6h>, decode_bc6h},
+    {"bc7", 4, 4, 16, 4, 4, &BC7EncSettingsObjectType, copy_settings<BC7EncSettingsObject, &EncSettings::bc7>, fingerprint_with<bc7_enc_settings, &EncSettings::bc7>, compress_with<bc7_enc_settings, CompressBlocksBC7, &EncSettings::bc7>, decode_bc7},
+    {"etc1", 4, 4, 8, 4, 3, &ETCEncSettingsObjectType, copy_settings<ETCEncSettingsObject, &EncSettings::etc>, fingerprint_with<etc_enc_settings, &EncSettings::etc>, compress_with<etc_enc_settings, CompressBlocksETC1, &EncSettings::etc>, decode_etc1},
+    {"astc", 0, 0, 16, 4, 4, &ASTCEncSettingsObjectType, copy_settings<ASTCEncSettingsObject, &EncSettings::astc>, fingerprint_with<astc_enc_settings, &EncSettings::astc>, compress_with<astc_enc_settings, CompressBlocksASTC, &EncSettings::astc>, decode_astc},
+};
+
+// looks up a format by its name, sets a ValueError if there is none
+const FormatInfo *find_format(const char *name) noexcept
+{
+    for (const auto &format : formats)
+    {
+        if (strcmp(format.name, name) == 0)
+            return &format;
+    }
+    PyErr_Format(PyExc_ValueError, "Invalid format: '%s'", name);
+    return nullptr;
+}
+
+// validates the settings object for the format and copies its settings, sets a TypeError on mismatch
+bool parse_settings(const FormatInfo &format, PyObject *py_settings, EncSettings &settings) noexcept
+{
+    if (format.settings_type == nullptr)
+    {
+        if (py_settings != nullptr && py_settings != Py_None)
+        {
+            PyErr_Format(PyExc_TypeError, "%s doesn't take settings", format.name);
+            return false;
+        }
+        return true;
+    }
+    if (py_settings == nullptr || !PyObject_TypeCheck(py_settings, *format.settings_type))
+    {
+        PyObject *type_name = PyType_GetName(*format.settings_type);
+        if (type_name)
+        {
+            PyErr_Format(PyExc_TypeError, "%s requires settings of type %S", format.name, type_name);
+            Py_DECREF(type_name);
+        }
+        return false;
+    }
+    format.copy_settings(py_settings, settings);
+    // the attributes of the settings are writable, so the footprint is checked again
+    if (format.block_width == 0 && !is_astc_footprint(settings.astc.block_width, settings.astc.block_height))
+    {
+        PyErr_Format(PyExc_ValueError, "Invalid block dimensions %dx%d", settings.astc.block_width, settings.astc.block_height);
+        return false;
+    }
+    return true;
+}
+
+// Surfaces without a pixel format hold the kernel input as is, so their stride can only be checked against a row of it
+// once the format is known. Sets a ValueError if the row doesn't fit.
+bool check_native_stride(const FormatInfo &format, const rgba_surface &src, PixelFormat pixel_format) noexcept
+{
+    if (pixel_format != PixelFormat::native || static_cast<size_t>(src.stride) >= static_cast<size_t>(src.width) * format.pixel_size)
+        return true;
+    PyErr_Format(PyExc_ValueError, "stride %d is smaller than a row of %s input (%d bytes per pixel)", src.stride, format.name, format.pixel_size);
+    return false;
+}
+
+// size of the compressed blocks of a surface, partial edge blocks take up a whole block
+size_t compressed_size(const FormatInfo &format, const EncSettings &settings, int width, int height) noexcept
+{
+    const size_t blocks_x = format.blocks_x(settings, width);
+    const size_t blocks_y = format.blocks_y(settings, height);
+    return blocks_x * blocks_y * format.block_size;
+}
+
+// identifies the output of a format with the given settings, the settings of formats without them are ignored
+uint64_t format_fingerprint(const FormatInfo &format, const EncSettings &settings) noexcept
+{
+    SettingsFingerprint fingerprint;
+    for (const char *c = format.name; *c; c++)
+        fingerprint.add(*c);
+    if (format.fingerprint)
+    {
+        const uint64_t settings_hash = format.fingerprint(settings);
+        fingerprint.add(static_cast<int32_t>(settings_hash));
+        fingerprint.add(static_cast<int32_t>(settings_hash >> 32));
+    }
+    return fingerprint.hash;
+}
+
+// reused by the edge blocks of all calls on the same thread
+thread_local std::vector<uint8_t> edge_scratch;
+// reused by the pixel format conversion of all calls on the same thread
+thread_local std::vector<uint8_t> convert_scratch;
+
+// reused by the kernel layout copies of converted source rows
+thread_local std::vector<uint8_t> source_scratch;
+
+// The rows [y, y + rows) of src in the kernel layout, as the kernel sees them,
+// either src itself or converted into source_scratch.
+rgba_surface kernel_source_rows(const FormatInfo &format, const rgba_surface &src, int y, int rows, PixelFormat pixel_format) noexcept
+{
+    rgba_surface source = {src.ptr + static_cast<size_t>(y) * src.stride, src.width, rows, src.stride};
+    if (needs_conversion(pixel_format, format.pixel_size))
+    {
+        source.stride = src.width * format.pixel_size;
+        source_scratch.resize(static_cast<size_t>(source.stride) * rows);
+        for (int row = 0; row < rows; row++)
+            convert_row(pixel_format, kernel_pixel_format(format.pixel_size), src.ptr + static_cast<size_t>(y + row) * src.stride, src.width, source_scratch.data() + static_cast<size_t>(row) * source.stride);
+        source.ptr = source_scratch.data();
+    }
+    return source;
+}
+
+// compresses the block rows [begin, end) of src, dst points to the first block of the whole surface
+void compress_rows(const FormatInfo &format, EncSettings &settings, const rgba_surface &src, uint8_t *dst, int begin, int end, PixelFormat pixel_format = PixelFormat::native) noexcept
+{
+    const int block_width = format.get_block_width(settings);
+    const int block_height = format.get_block_height(settings);
+    const size_t row_size = format.blocks_x(settings, src.width) * format.block_size;
+
+    if (needs_conversion(pixel_format, format.pixel_size))
+    {
+        // Converted one block row at a time right before it's compressed,
+        // so the scratch stays in the cache and the image is never converted as a whole.
+        const PixelFormat kernel_format = kernel_pixel_format(format.pixel_size);
+        rgba_surface band = {nullptr, src.width, 0, src.width * format.pixel_size};
+        convert_scratch.resize(static_cast<size_t>(band.stride) * block_height);
+        band.ptr = convert_scratch.data();
+        for (int row = begin; row < end; row++)
+        {
+            band.height = std::min(block_height, src.height - row * block_height);
+            for (int y = 0; y < band.height; y++)
+                convert_row(pixel_format, kernel_format, src.ptr + static_cast<size_t>(row * block_height + y) * src.stride, src.width, band.ptr + static_cast<size_t>(y) * band.stride);
+            compress_rows(format, settings, band, dst + row * row_size, 0, 1);
+        }
+        return;
+    }
+
+    // the kernels only handle whole blocks
+    const int full_rows = std::min(end, src.height / block_height);
+    rgba_surface band = src;
+    band.width = src.width / block_width * block_width;
+    if (band.width > 0 && begin < full_rows)
+    {
+        if (band.width == src.width)
+        {
+            band.ptr = src.ptr + static_cast<size_t>(begin) * block_height * src.stride;
+            band.height = (full_rows - begin) * block_height;
+            format.compress(&band, dst + begin * row_size, settings);
+        }
+        else
+        {
+            // the partial block at the end of each row breaks the contiguous layout of the kernel output
+            band.height = block_height;
+            for (int row = begin; row < full_rows; row++)
+            {
+                band.ptr = src.ptr + static_cast<size_t>(row) * block_height * src.stride;
+                format.compress(&band, dst + row * row_size, settings);
+            }
+        }
+    }
+
+    // Partial edge blocks are compressed from a small scratch surface,
+    // into which the border pixels are replicated instead of padding the whole image.
+    const int edge_end = std::max(begin, full_rows);
+    const size_t full_size = static_cast<size_t>(band.width / block_width) * format.block_size;
+    if (full_size < row_size && begin < full_rows)
+    {
+        // right edge column
+        const int rows = full_rows - begin;
+        rgba_surface scratch = {nullptr, block_width, rows * block_height, block_width * format.pixel_size};
+        edge_scratch.resize(static_cast<size_t>(scratch.stride) * scratch.height + rows * format.block_size);
+        scratch.ptr = edge_scratch.data();
+        ReplicateBorders(&scratch, &src, band.width, begin * block_height, format.pixel_size * 8);
+        uint8_t *blocks = scratch.ptr + static_cast<size_t>(scratch.stride) * scratch.height;
+        format.compress(&scratch, blocks, settings);
+        for (int row = 0; row < rows; row++)
+            memcpy(dst + (begin + row) * row_size + full_size, blocks + row * format.block_size, format.block_size);
+    }
+    if (edge_end < end)
+    {
+        // bottom edge row, including the corner block
+        rgba_surface scratch = {nullptr, format.blocks_x(settings, src.width) * block_width, block_height, 0};
+        scratch.stride = scratch.width * format.pixel_size;
+        edge_scratch.resize(static_cast<size_t>(scratch.stride) * scratch.height);
+        scratch.ptr = edge_scratch.data();
+        ReplicateBorders(&scratch, &src, 0, edge_end * block_height, format.pixel_size * 8);
+        format.compress(&scratch, dst + edge_end * row_size, settings);
+    }
+}
+
+// compresses the whole surface, its block rows are split across up to `threads` threads
+void compress_surface(const FormatInfo &format, EncSettings &settings, const rgba_surface &src, uint8_t *dst, int threads, PixelFormat pixel_format = PixelFormat::native) noexcept
+{
+    parallel_for(format.blocks_y(settings, src.height), threads, [&](int begin, int end)
+                 { compress_rows(format, settings, src, dst, begin, end, pixel_format); });
+}
+
+// reused by the block rows of compressed regions that don't span the whole surface
+thread_local std::vector<uint8_t> region_scratch;
+
+// Compresses the blocks [x0, x1) x [y0, y1) of src into the blocks of the whole surface, dst pointing to its first
+// one, leaving the others as they are. The blocks are independent, so they come out as compress_surface writes them.
+void compress_region(const FormatInfo &format, EncSettings &settings, const rgba_surface &src, uint8_t *dst, int x0, int y0, int x1, int y1, int threads, PixelFormat pixel_format = PixelFormat::native) noexcept
+{
+    const int block_width = format.get_block_width(settings);
+    const int block_height = format.get_block_height(settings);
+    const int pixel_size = pixel_format == PixelFormat::native ? format.pixel_size : get_pixel_format(pixel_format).pixel_size();
+    const size_t row_size = format.blocks_x(settings, src.width) * format.block_size;
+
+    // the region as a surface of its own, which shares the right and bottom edge of src if it reaches them,
+    // so that the partial edge blocks replicate the same border pixels
+    rgba_surface region = src;
+    region.ptr = src.ptr + static_cast<size_t>(y0) * block_height * src.stride + static_cast<size_t>(x0) * block_width * pixel_size;
+    region.width = std::min(src.width - x0 * block_width, (x1 - x0) * block_width);
+    region.height = std::min(src.height - y0 * block_height, (y1 - y0) * block_height);
+    if (x0 == 0 && format.blocks_x(settings, region.width) * format.block_size == row_size)
+    {
+        // whole block rows are laid out like in the surface
+        compress_surface(format, settings, region, dst + y0 * row_size, threads, pixel_format);
+        return;
+    }
+
+    const size_t region_row_size = static_cast<size_t>(x1 - x0) * format.block_size;
+    parallel_for(y1 - y0, threads, [&](int begin, int end)
+                 {
+        region_scratch.resize(region_row_size);
+        for (int row = begin; row < end; row++)
+        {
+            rgba_surface band = region;
+            band.ptr = region.ptr + static_cast<size_t>(row) * block_height * region.stride;
+            band.height = std::min(block_height, region.height - row * block_height);
+            compress_rows(format, settings, band, region_scratch.data(), 0, 1, pixel_format);
+            memcpy(dst + (y0 + row) * row_size + static_cast<size_t>(x0) * format.block_size, region_scratch.data(), region_row_size);
+        } });
+}
+
+// reused by the decoded block rows of all calls on the same thread
+thread_local std::vector<uint8_t> decode_scratch;
+
+// decodes the block rows [begin, end) of src into dst, src points to the first block of the whole surface
+void decompress_rows(const FormatInfo &format, const EncSettings &settings, const uint8_t *src, const rgba_surface &dst, int begin, int end, PixelFormat pixel_format = PixelFormat::native) noexcept
+{
+    const int block_width = format.get_block_width(settings);
+    const int block_height = format.get_block_height(settings);
+    const int blocks_x = format.blocks_x(settings, dst.width);
+    const size_t row_size = blocks_x * format.block_size;
+    const bool convert = needs_conversion(pixel_format, format.pixel_size);
+    const PixelFormat kernel_format = kernel_pixel_format(format.pixel_size);
+
+    // whole blocks are decoded into a block row sized scratch, the partial edge blocks are cropped while copying
+    const size_t band_stride = static_cast<size_t>(blocks_x) * block_width * format.pixel_size;
+    decode_scratch.resize(band_stride * block_height);
+    uint8_t *band = decode_scratch.data();
+    for (int row = begin; row < end; row++)
+    {
+        const uint8_t *blocks = src + row * row_size;
+        for (int x = 0; x < blocks_x; x++)
+            format.decompress(blocks + x * format.block_size, band + static_cast<size_t>(x) * block_width * format.pixel_size, band_stride, block_width, block_height);
+
+        const int rows = std::min(block_height, dst.height - row * block_height);
+        for (int y = 0; y < rows; y++)
+        {
+            uint8_t *target = dst.ptr + static_cast<size_t>(row * block_height + y) * dst.stride;
+            if (convert)
+                convert_row(kernel_format, pixel_format, band + y * band_stride, dst.width, target);
+            else
+                memcpy(target, band + y * band_stride, static_cast<size_t>(dst.width) * format.pixel_size);
+        }
+    }
+}
+
+// decodes the blocks of a whole surface into dst, its block rows are split across up to `threads` threads
+void decompress_surface(const FormatInfo &format, const EncSettings &settings, const uint8_t *src, const rgba_surface &dst, int threads, PixelFormat pixel_format = PixelFormat::native) noexcept
+{
+    parallel_for(format.blocks_y(settings, dst.height), threads, [&](int begin, int end)
+                 { decompress_rows(format, settings, src, dst, begin, end, pixel_format); });
+}
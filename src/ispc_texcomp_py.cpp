@@ -2,60 +2,783 @@
 #include <Python.h>
 #include "ispc_texcomp.h"
 
+#include "mapped_file.hpp"
+#include "pixel_format.hpp"
+#include "fastcall.hpp"
+#include "surface_array.hpp"
 #include "rgba_surface_py.hpp"
 #include "settings.hpp"
+#include "thread_pool.hpp"
+#include "cpu_target.hpp"
+#include "decoder.hpp"
+#include "format.hpp"
+#include "block_cache.hpp"
+#include "metrics.hpp"
+#include "adaptive.hpp"
+#include "mipmap.hpp"
+#include "stream_encoder_py.hpp"
+#include "encoder_py.hpp"
+#include "block_cache_py.hpp"
+#include "encode_cache_py.hpp"
+#include "async.hpp"
+#include "stats.hpp"
+#include "container.hpp"
 
-template <auto compress_func, size_t ratio>
-PyObject *py_compress(PyObject *self, PyObject *args) noexcept
+// the metrics dict returned by return_metrics=True
+PyObject *build_metrics(const FormatInfo &format, const EncodeMetrics &metrics, PyObject *block_errors) noexcept
 {
-    RGBASurfaceObject *py_src;
-    if (!PyArg_ParseTuple(args, "O!", RGBASurfaceObjectType, &py_src))
+    PyObject *channel_mse = PyTuple_New(format.channels);
+    PyObject *channel_psnr = PyTuple_New(format.channels);
+    double total = 0;
+    for (int c = 0; channel_mse && channel_psnr && c < format.channels; c++)
+    {
+        const double mse = metrics.pixels ? metrics.squared_error[c] / metrics.pixels : 0.0;
+        total += mse;
+        PyTuple_SetItem(channel_mse, c, PyFloat_FromDouble(mse));
+        PyTuple_SetItem(channel_psnr, c, PyFloat_FromDouble(psnr(format, mse)));
+    }
+    if (!channel_mse || !channel_psnr || PyErr_Occurred())
+    {
+        Py_XDECREF(channel_mse);
+        Py_XDECREF(channel_psnr);
+        return nullptr;
+    }
+    const double mse = total / format.channels;
+    PyObject *result = Py_BuildValue("{s:d,s:d,s:N,s:N}", "mse", mse, "psnr", psnr(format, mse), "channel_mse", channel_mse, "channel_psnr", channel_psnr);
+    if (result && block_errors && PyDict_SetItemString(result, "block_mse", block_errors) < 0)
+        Py_CLEAR(result);
+    return result;
+}
+
+// fastcall, as the call overhead is comparable to compressing tiny textures
+template <FormatId id>
+PyObject *py_compress(PyObject *self, PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames) noexcept
+{
+    CallTimer timer;
+    const FormatInfo &format = formats[id];
+    static const char *const kwlist[] = {"rgba", "threads", "return_metrics", "block_errors", "cache"};
+    static const char *const kwlist_s[] = {"rgba", "settings", "threads", "return_metrics", "block_errors", "cache"};
+    // the Python name for the error messages, filled in once while holding the GIL
+    static char fname[32] = {};
+    if (!fname[0])
+        snprintf(fname, sizeof(fname), "compress_blocks_%s", format.name);
+    // the arguments after rgba and settings are keyword-only
+    const int positional = format.settings_type ? 2 : 1;
+    PyObject *values[6];
+    if (!parse_fastcall(fname, format.settings_type ? kwlist_s : kwlist, positional + 4, positional, positional, args, nargs, kwnames, values))
+        return nullptr;
+    if (!fastcall_type(values[0], RGBASurfaceObjectType, fname, "rgba"))
+        return nullptr;
+    RGBASurfaceObject *py_src = reinterpret_cast<RGBASurfaceObject *>(values[0]);
+    PyObject *py_settings = format.settings_type ? values[1] : nullptr;
+    int threads = 1;
+    int return_metrics = 0;
+    int return_block_errors = 0;
+    PyObject *py_cache = values[positional + 3] ? values[positional + 3] : Py_None;
+    if (!fastcall_int(values[positional], fname, "threads", threads) || !check_threads(threads) ||
+        !fastcall_bool(values[positional + 1], return_metrics) ||
+        !fastcall_bool(values[positional + 2], return_block_errors))
         return nullptr;
 
-    const auto &src = py_src->surf;
-    size_t size = src.width * src.height;
-    if constexpr(ratio > 1)
+    BlockCache *cache = nullptr;
+    if (py_cache != Py_None)
     {
-        size /= ratio;
+        if (!PyObject_TypeCheck(py_cache, BlockCacheObjectType))
+        {
+            PyErr_SetString(PyExc_TypeError, "cache has to be a BlockCache or None");
+            return nullptr;
+        }
+        if (!block_cache_ready(reinterpret_cast<BlockCacheObject *>(py_cache)))
+            return nullptr;
+        cache = reinterpret_cast<BlockCacheObject *>(py_cache)->cache;
     }
-    PyObject *result = PyBytes_FromStringAndSize(nullptr, size);
+
+    // the settings are copied, so that the workers aren't affected by attribute changes while the GIL is released
+    EncSettings settings = {};
+    if (!parse_settings(format, py_settings, settings))
+        return nullptr;
+
+    const rgba_surface src = py_src->surf;
+    if (!check_native_stride(format, src, py_src->pixel_format))
+        return nullptr;
+    PyObject *result = PyBytes_FromStringAndSize(nullptr, compressed_size(format, settings, src.width, src.height));
     if (!result)
         return nullptr;
     uint8_t *dst = (uint8_t *)PyBytes_AsString(result);
+    if (!return_metrics)
+    {
+        Py_BEGIN_ALLOW_THREADS
+            timer.begin_kernel();
+        compress_surface_cached(format, settings, src, dst, threads, py_src->pixel_format, cache);
+        timer.end_kernel();
+        Py_END_ALLOW_THREADS timer.end_gil_wait();
+        record_call(timer, format, settings, src, py_src->pixel_format, PyBytes_Size(result));
+        return result;
+    }
+
+    // the per block errors are written straight into a float32 buffer, which is returned as 2D memoryview
+    const int blocks_x = format.blocks_x(settings, src.width);
+    const int blocks_y = format.blocks_y(settings, src.height);
+    PyObject *block_errors = nullptr;
+    EncodeMetrics metrics = {};
+    if (return_block_errors)
+    {
+        block_errors = PyBytes_FromStringAndSize(nullptr, static_cast<Py_ssize_t>(blocks_x) * blocks_y * sizeof(float));
+        if (!block_errors)
+        {
+            Py_DECREF(result);
+            return nullptr;
+        }
+        metrics.block_errors = reinterpret_cast<float *>(PyBytes_AsString(block_errors));
+    }
     Py_BEGIN_ALLOW_THREADS
-        compress_func(&src, dst);
-    Py_END_ALLOW_THREADS return result;
+        timer.begin_kernel();
+    compress_surface_measured(format, settings, src, dst, threads, py_src->pixel_format, cache, metrics);
+    timer.end_kernel();
+    Py_END_ALLOW_THREADS timer.end_gil_wait();
+
+    if (block_errors)
+    {
+        PyObject *view = PyMemoryView_FromObject(block_errors);
+        Py_DECREF(block_errors);
+        block_errors = view ? PyObject_CallMethod(view, "cast", "s(ii)", "f", blocks_y, blocks_x) : nullptr;
+        Py_XDECREF(view);
+        if (!block_errors)
+        {
+            Py_DECREF(result);
+            return nullptr;
+        }
+    }
+    PyObject *py_metrics = build_metrics(format, metrics, block_errors);
+    Py_XDECREF(block_errors);
+    if (!py_metrics)
+    {
+        Py_DECREF(result);
+        return nullptr;
+    }
+    record_call(timer, format, settings, src, py_src->pixel_format, PyBytes_Size(result));
+    return Py_BuildValue("(NN)", result, py_metrics);
 }
 
-template <auto compress_func, class SettingsObject, PyTypeObject **SettingsObjectType>
-PyObject *py_compress_s(PyObject *self, PyObject *args) noexcept
+// compresses into a caller provided writable buffer, e.g. a bytearray, numpy array or mmap of the output file
+template <FormatId id>
+PyObject *py_compress_into(PyObject *self, PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames) noexcept
 {
+    CallTimer timer;
+    const FormatInfo &format = formats[id];
+    static const char *const kwlist[] = {"rgba", "out", "offset", "threads"};
+    static const char *const kwlist_s[] = {"rgba", "settings", "out", "offset", "threads"};
+    static char fname[32] = {};
+    if (!fname[0])
+        snprintf(fname, sizeof(fname), "compress_blocks_%s_into", format.name);
+    // rgba, settings, out and offset may be positional, threads is keyword-only
+    const int required = format.settings_type ? 3 : 2;
+    PyObject *values[5];
+    if (!parse_fastcall(fname, format.settings_type ? kwlist_s : kwlist, required + 2, required + 1, required, args, nargs, kwnames, values))
+        return nullptr;
+    if (!fastcall_type(values[0], RGBASurfaceObjectType, fname, "rgba"))
+        return nullptr;
+    RGBASurfaceObject *py_src = reinterpret_cast<RGBASurfaceObject *>(values[0]);
+    PyObject *py_settings = format.settings_type ? values[1] : nullptr;
+    PyObject *py_out = values[required - 1];
+    Py_ssize_t offset = 0;
+    int threads = 1;
+    if (!fastcall_ssize(values[required], offset) || !fastcall_int(values[required + 1], fname, "threads", threads) || !check_threads(threads))
+        return nullptr;
+
+    EncSettings settings = {};
+    if (!parse_settings(format, py_settings, settings))
+        return nullptr;
+
+    const rgba_surface src = py_src->surf;
+    if (!check_native_stride(format, src, py_src->pixel_format))
+        return nullptr;
+    const size_t size = compressed_size(format, settings, src.width, src.height);
+
+    if (offset < 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "offset must be >= 0");
+        return nullptr;
+    }
+
+    // the export keeps resizable buffers (e.g. bytearray) from reallocating while the GIL is released
+    Py_buffer view;
+    if (PyObject_GetBuffer(py_out, &view, PyBUF_WRITABLE) < 0)
+        return nullptr;
+    if (static_cast<size_t>(view.len) < size || static_cast<size_t>(view.len) - size < static_cast<size_t>(offset))
+    {
+        PyErr_Format(PyExc_ValueError, "Output buffer too small (need %zu bytes at offset %zd, got %zd)", size, offset, view.len);
+        PyBuffer_Release(&view);
+        return nullptr;
+    }
+
+    uint8_t *dst = static_cast<uint8_t *>(view.buf) + offset;
+    Py_BEGIN_ALLOW_THREADS
+        timer.begin_kernel();
+    compress_surface(format, settings, src, dst, threads, py_src->pixel_format);
+    timer.end_kernel();
+    Py_END_ALLOW_THREADS timer.end_gil_wait();
+    PyBuffer_Release(&view);
+    record_call(timer, format, settings, src, py_src->pixel_format, size);
+    return PyLong_FromSize_t(size);
+}
+
+PyObject *py_compress_batch(PyObject *self, PyObject *args, PyObject *kwds) noexcept
+{
+    static const char *kwlist[] = {"format", "surfaces", "settings", "threads", "contiguous", nullptr};
+    const char *format_name;
+    PyObject *py_surfaces;
+    PyObject *py_settings = nullptr;
+    int threads = 1;
+    int contiguous = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "sO|O$O&p", const_cast<char **>(kwlist), &format_name, &py_surfaces, &py_settings, threads_converter, &threads, &contiguous))
+        return nullptr;
+
+    const FormatInfo *format = find_format(format_name);
+    if (!format)
+        return nullptr;
+    EncSettings settings = {};
+    if (!parse_settings(*format, py_settings, settings))
+        return nullptr;
+    // the surfaces are referenced until the end, so that they stay alive while the GIL is released
+    PyObject *py_list = PySequence_List(py_surfaces);
+    if (!py_list)
+        return nullptr;
+    const Py_ssize_t count = PyList_Size(py_list);
+    std::vector<rgba_surface> surfaces(count);
+    std::vector<PixelFormat> surface_formats(count);
+    std::vector<size_t> offsets(count + 1, 0);
+    // index of the first block row of each surface within all block rows of the batch
+    std::vector<int> rows(count + 1, 0);
+    for (Py_ssize_t i = 0; i < count; i++)
+    {
+        PyObject *item = PyList_GetItem(py_list, i);
+        if (!PyObject_TypeCheck(item, RGBASurfaceObjectType))
+        {
+            PyErr_Format(PyExc_TypeError, "surfaces[%zd] is not a RGBASurface", i);
+            Py_DECREF(py_list);
+            return nullptr;
+        }
+        surfaces[i] = reinterpret_cast<RGBASurfaceObject *>(item)->surf;
+        surface_formats[i] = reinterpret_cast<RGBASurfaceObject *>(item)->pixel_format;
+        if (!check_native_stride(*format, surfaces[i], surface_formats[i]))
+        {
+            Py_DECREF(py_list);
+            return nullptr;
+        }
+        offsets[i + 1] = offsets[i] + compressed_size(*format, settings, surfaces[i].width, surfaces[i].height);
+        rows[i + 1] = rows[i] + format->blocks_y(settings, surfaces[i].height);
+    }
+
+    PyObject *buffer = PyBytes_FromStringAndSize(nullptr, offsets[count]);
+    if (!buffer)
+    {
+        Py_DECREF(py_list);
+        return nullptr;
+    }
+    uint8_t *dst = (uint8_t *)PyBytes_AsString(buffer);
+
+    // the block rows of all surfaces are spread across the threads, so that many small surfaces still scale
+    Py_BEGIN_ALLOW_THREADS
+        parallel_for(rows[count], threads, [&](int begin, int end)
+                     {
+            size_t i = std::upper_bound(rows.begin(), rows.end(), begin) - rows.begin() - 1;
+            for (; begin < end; i++)
+            {
+                const int surface_end = std::min(end, rows[i + 1]);
+                compress_rows(*format, settings, surfaces[i], dst + offsets[i], begin - rows[i], surface_end - rows[i], surface_formats[i]);
+                begin = surface_end;
+            } });
+    Py_END_ALLOW_THREADS Py_DECREF(py_list);
+
+    if (contiguous)
+    {
+        PyObject *py_offsets = PyList_New(count);
+        if (!py_offsets)
+        {
+            Py_DECREF(buffer);
+            return nullptr;
+        }
+        for (Py_ssize_t i = 0; i < count; i++)
+        {
+            PyObject *offset = PyLong_FromSize_t(offsets[i]);
+            if (!offset)
+            {
+                Py_DECREF(py_offsets);
+                Py_DECREF(buffer);
+                return nullptr;
+            }
+            PyList_SetItem(py_offsets, i, offset);
+        }
+        PyObject *result = PyTuple_Pack(2, buffer, py_offsets);
+        Py_DECREF(buffer);
+        Py_DECREF(py_offsets);
+        return result;
+    }
+
+    PyObject *result = PyList_New(count);
+    for (Py_ssize_t i = 0; result && i < count; i++)
+    {
+        PyObject *item = PyBytes_FromStringAndSize(reinterpret_cast<const char *>(dst + offsets[i]), offsets[i + 1] - offsets[i]);
+        if (!item)
+            Py_CLEAR(result);
+        else
+            PyList_SetItem(result, i, item);
+    }
+    Py_DECREF(buffer);
+    return result;
+}
+
+PyObject *py_compress_mip_chain(PyObject *self, PyObject *args, PyObject *kwds) noexcept
+{
+    static const char *kwlist[] = {"rgba", "format", "settings", "filter", "srgb", "levels", "threads", nullptr};
+    RGBASurfaceObject *py_src;
+    const char *format_name;
+    PyObject *py_settings = nullptr;
+    const char *filter_name = "box";
+    int srgb = 1;
+    int levels = 0;
+    int threads = 1;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!s|Osp$iO&", const_cast<char **>(kwlist), RGBASurfaceObjectType, &py_src, &format_name, &py_settings, &filter_name, &srgb, &levels, threads_converter, &threads))
+        return nullptr;
+
+    const FormatInfo *format = find_format(format_name);
+    if (!format)
+        return nullptr;
+    EncSettings settings = {};
+    if (!parse_settings(*format, py_settings, settings))
+        return nullptr;
+
+    MipFilter filter;
+    if (!find_mip_filter(filter_name, filter))
+        return nullptr;
+
+    const rgba_surface src = py_src->surf;
+    if (!check_native_stride(*format, src, py_src->pixel_format))
+        return nullptr;
+    if (src.width <= 0 || src.height <= 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "the surface is empty");
+        return nullptr;
+    }
+    const int max_levels = mip_count(src.width, src.height);
+    if (levels < 0 || levels > max_levels)
+    {
+        PyErr_Format(PyExc_ValueError, "levels must be between 0 (full chain) and %d", max_levels);
+        return nullptr;
+    }
+    if (levels == 0)
+        levels = max_levels;
+
+    std::vector<size_t> offsets(levels + 1, 0);
+    for (int n = 0; n < levels; n++)
+        offsets[n + 1] = offsets[n] + compressed_size(*format, settings, std::max(1, src.width >> n), std::max(1, src.height >> n));
+
+    PyObject *buffer = PyBytes_FromStringAndSize(nullptr, offsets[levels]);
+    if (!buffer)
+        return nullptr;
+    uint8_t *dst = (uint8_t *)PyBytes_AsString(buffer);
+    bool compressed;
+    Py_BEGIN_ALLOW_THREADS
+        compressed = compress_mip_chain(*format, settings, src, levels, dst, offsets.data(), filter, srgb != 0, threads, py_src->pixel_format);
+    Py_END_ALLOW_THREADS
+
+        if (!compressed)
+    {
+        Py_DECREF(buffer);
+        return PyErr_NoMemory();
+    }
+    PyObject *py_offsets = PyList_New(levels);
+    for (int n = 0; py_offsets && n < levels; n++)
+    {
+        PyObject *offset = PyLong_FromSize_t(offsets[n]);
+        if (!offset)
+            Py_CLEAR(py_offsets);
+        else
+            PyList_SetItem(py_offsets, n, offset);
+    }
+    if (!py_offsets)
+    {
+        Py_DECREF(buffer);
+        return nullptr;
+    }
+    PyObject *result = PyTuple_Pack(2, buffer, py_offsets);
+    Py_DECREF(buffer);
+    Py_DECREF(py_offsets);
+    return result;
+}
+
+// compresses straight into a mapped output file, so the blocks never pass through the Python heap
+PyObject *py_compress_to_file(PyObject *self, PyObject *args, PyObject *kwds) noexcept
+{
+    static const char *kwlist[] = {"rgba", "format", "path", "settings", "offset", "threads", nullptr};
     RGBASurfaceObject *py_src;
-    SettingsObject *py_settings;
-    if (!PyArg_ParseTuple(args, "O!O!", RGBASurfaceObjectType, &py_src, *SettingsObjectType, &py_settings))
+    const char *format_name;
+    PyObject *path;
+    PyObject *py_settings = nullptr;
+    Py_ssize_t offset = 0;
+    int threads = 1;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!sO|On$O&", const_cast<char **>(kwlist), RGBASurfaceObjectType, &py_src, &format_name, &path, &py_settings, &offset, threads_converter, &threads))
         return nullptr;
 
-    const auto &src = py_src->surf;
-    size_t size = src.width * src.height;
-    PyObject *result = PyBytes_FromStringAndSize(nullptr, size);
+    const FormatInfo *format = find_format(format_name);
+    if (!format)
+        return nullptr;
+    EncSettings settings = {};
+    if (!parse_settings(*format, py_settings, settings))
+        return nullptr;
+    if (offset < 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "offset must be >= 0");
+        return nullptr;
+    }
+
+    const rgba_surface src = py_src->surf;
+    if (!check_native_stride(*format, src, py_src->pixel_format))
+        return nullptr;
+    const size_t size = compressed_size(*format, settings, src.width, src.height);
+    MappedFile file;
+    if (!map_file(path, true, offset, size, file))
+        return nullptr;
+    Py_BEGIN_ALLOW_THREADS
+        compress_surface(*format, settings, src, file.data, threads, py_src->pixel_format);
+    unmap_file(file);
+    Py_END_ALLOW_THREADS return PyLong_FromSize_t(size);
+}
+
+// Recompresses the blocks covering a changed rectangle of the surface into its existing compressed data,
+// returns the pixel rectangle of the blocks that were written.
+PyObject *py_compress_region(PyObject *self, PyObject *args, PyObject *kwds) noexcept
+{
+    static const char *kwlist[] = {"rgba", "format", "rect", "out", "settings", "offset", "threads", nullptr};
+    RGBASurfaceObject *py_src;
+    const char *format_name;
+    int x, y, width, height;
+    PyObject *py_out;
+    PyObject *py_settings = nullptr;
+    Py_ssize_t offset = 0;
+    int threads = 1;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!s(iiii)O|On$O&", const_cast<char **>(kwlist), RGBASurfaceObjectType, &py_src, &format_name, &x, &y, &width, &height, &py_out, &py_settings, &offset, threads_converter, &threads))
+        return nullptr;
+
+    const FormatInfo *format = find_format(format_name);
+    if (!format)
+        return nullptr;
+    EncSettings settings = {};
+    if (!parse_settings(*format, py_settings, settings))
+        return nullptr;
+    if (offset < 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "offset must be >= 0");
+        return nullptr;
+    }
+    if (width < 0 || height < 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "rect width and height must be >= 0");
+        return nullptr;
+    }
+
+    // the rectangle is clipped to the surface and grown to whole blocks
+    const rgba_surface src = py_src->surf;
+    if (!check_native_stride(*format, src, py_src->pixel_format))
+        return nullptr;
+    const int block_width = format->get_block_width(settings);
+    const int block_height = format->get_block_height(settings);
+    const int64_t right = std::min<int64_t>(static_cast<int64_t>(x) + width, src.width);
+    const int64_t bottom = std::min<int64_t>(static_cast<int64_t>(y) + height, src.height);
+    const int x0 = std::max(x, 0) / block_width;
+    const int y0 = std::max(y, 0) / block_height;
+    const int x1 = std::max<int>(x0, static_cast<int>((right + block_width - 1) / block_width));
+    const int y1 = std::max<int>(y0, static_cast<int>((bottom + block_height - 1) / block_height));
+
+    const size_t size = compressed_size(*format, settings, src.width, src.height);
+    Py_buffer view;
+    if (PyObject_GetBuffer(py_out, &view, PyBUF_WRITABLE) < 0)
+        return nullptr;
+    if (static_cast<size_t>(view.len) < size || static_cast<size_t>(view.len) - size < static_cast<size_t>(offset))
+    {
+        PyErr_Format(PyExc_ValueError, "Output buffer too small (need %zu bytes at offset %zd, got %zd)", size, offset, view.len);
+        PyBuffer_Release(&view);
+        return nullptr;
+    }
+
+    uint8_t *dst = static_cast<uint8_t *>(view.buf) + offset;
+    if (x0 < x1 && y0 < y1)
+    {
+        Py_BEGIN_ALLOW_THREADS
+            compress_region(*format, settings, src, dst, x0, y0, x1, y1, threads, py_src->pixel_format);
+        Py_END_ALLOW_THREADS
+    }
+    PyBuffer_Release(&view);
+    const int rect_x = std::min(x0 * block_width, src.width);
+    const int rect_y = std::min(y0 * block_height, src.height);
+    return Py_BuildValue("(iiii)", rect_x, rect_y,
+                         std::min(x1 * block_width, src.width) - rect_x,
+                         std::min(y1 * block_height, src.height) - rect_y);
+}
+
+// decodes blocks into an existing, writable surface, converting them to its pixel format
+template <FormatId id>
+PyObject *py_decompress(PyObject *self, PyObject *args, PyObject *kwds) noexcept
+{
+    const FormatInfo &format = formats[id];
+    static const char *kwlist[] = {"data", "rgba", "threads", nullptr};
+    static const char *kwlist_astc[] = {"data", "rgba", "block_width", "block_height", "threads", nullptr};
+    Py_buffer data;
+    RGBASurfaceObject *py_dst;
+    EncSettings settings = {};
+    int threads = 1;
+    const int parsed = format.block_width == 0
+                           ? PyArg_ParseTupleAndKeywords(args, kwds, "y*O!ii|$O&", const_cast<char **>(kwlist_astc), &data, RGBASurfaceObjectType, &py_dst, &settings.astc.block_width, &settings.astc.block_height, threads_converter, &threads)
+                           : PyArg_ParseTupleAndKeywords(args, kwds, "y*O!|$O&", const_cast<char **>(kwlist), &data, RGBASurfaceObjectType, &py_dst, threads_converter, &threads);
+    if (!parsed)
+        return nullptr;
+
+    const rgba_surface dst = py_dst->surf;
+    const size_t size = compressed_size(format, settings, dst.width, dst.height);
+    const int pixel_size = py_dst->pixel_format == PixelFormat::native ? format.pixel_size : get_pixel_format(py_dst->pixel_format).pixel_size();
+    bool valid = false;
+    if (format.block_width == 0 && !is_astc_decode_footprint(settings.astc.block_width, settings.astc.block_height))
+        PyErr_Format(PyExc_ValueError, "Invalid block dimensions %dx%d", settings.astc.block_width, settings.astc.block_height);
+    else if (RGBASurface_isReadonly(py_dst))
+        PyErr_SetString(PyExc_ValueError, "the surface is read-only");
+    else if (dst.stride < dst.width * pixel_size)
+        PyErr_SetString(PyExc_ValueError, "the stride of the surface is smaller than its rows");
+    else if (static_cast<size_t>(data.len) < size)
+        PyErr_Format(PyExc_ValueError, "Data too small (need %zu bytes, got %zd)", size, data.len);
+    else
+        valid = RGBASurface_checkExtent(py_dst, pixel_size);
+    if (!valid)
+    {
+        PyBuffer_Release(&data);
+        return nullptr;
+    }
+
+    const uint8_t *src = static_cast<const uint8_t *>(data.buf);
+    Py_BEGIN_ALLOW_THREADS
+        decompress_surface(format, settings, src, dst, threads, py_dst->pixel_format);
+    Py_END_ALLOW_THREADS PyBuffer_Release(&data);
+    Py_RETURN_NONE;
+}
+
+// fast first, then only the blocks above the error threshold with the slow settings
+PyObject *py_compress_adaptive(PyObject *self, PyObject *args, PyObject *kwds) noexcept
+{
+    static const char *kwlist[] = {"rgba", "format", "fast", "slow", "threshold", "threads", nullptr};
+    RGBASurfaceObject *py_src;
+    const char *format_name;
+    PyObject *py_fast;
+    PyObject *py_slow;
+    float threshold;
+    int threads = 1;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!sOOf|$O&", const_cast<char **>(kwlist), RGBASurfaceObjectType, &py_src, &format_name, &py_fast, &py_slow, &threshold, threads_converter, &threads))
+        return nullptr;
+
+    const FormatInfo *format = find_format(format_name);
+    if (!format)
+        return nullptr;
+    if (format->settings_type == nullptr)
+    {
+        PyErr_Format(PyExc_ValueError, "%s doesn't have profiles to choose from", format->name);
+        return nullptr;
+    }
+    EncSettings fast = {};
+    EncSettings slow = {};
+    if (!parse_settings(*format, py_fast, fast) || !parse_settings(*format, py_slow, slow))
+        return nullptr;
+    if (format->get_block_width(fast) != format->get_block_width(slow) || format->get_block_height(fast) != format->get_block_height(slow))
+    {
+        PyErr_SetString(PyExc_ValueError, "fast and slow must have the same block dimensions");
+        return nullptr;
+    }
+
+    const rgba_surface src = py_src->surf;
+    if (!check_native_stride(*format, src, py_src->pixel_format))
+        return nullptr;
+    PyObject *result = PyBytes_FromStringAndSize(nullptr, compressed_size(*format, fast, src.width, src.height));
     if (!result)
         return nullptr;
     uint8_t *dst = (uint8_t *)PyBytes_AsString(result);
+    int recompressed;
+    Py_BEGIN_ALLOW_THREADS
+        recompressed = compress_surface_adaptive(*format, fast, slow, src, dst, threshold, threads, py_src->pixel_format);
+    Py_END_ALLOW_THREADS return Py_BuildValue("(Ni)", result, recompressed);
+}
+
+// submits the compression to the shared pool and returns a concurrent.futures.Future of the blocks right away
+PyObject *py_compress_async(PyObject *self, PyObject *args, PyObject *kwds) noexcept
+{
+    static const char *kwlist[] = {"rgba", "format", "settings", "threads", nullptr};
+    RGBASurfaceObject *py_src;
+    const char *format_name;
+    PyObject *py_settings = nullptr;
+    int threads = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!s|O$O&", const_cast<char **>(kwlist), RGBASurfaceObjectType, &py_src, &format_name, &py_settings, threads_converter, &threads))
+        return nullptr;
+
+    const FormatInfo *format = find_format(format_name);
+    if (!format)
+        return nullptr;
+    EncSettings settings = {};
+    if (!parse_settings(*format, py_settings, settings))
+        return nullptr;
+    if (!check_native_stride(*format, py_src->surf, py_src->pixel_format))
+        return nullptr;
+
+    // the future is running from the start, it can't be cancelled once the rows are queued
+    PyObject *futures = PyImport_ImportModule("concurrent.futures");
+    PyObject *future = futures ? PyObject_CallMethod(futures, "Future", nullptr) : nullptr;
+    Py_XDECREF(futures);
+    if (!future)
+        return nullptr;
+    PyObject *running = PyObject_CallMethod(future, "set_running_or_notify_cancel", nullptr);
+    if (!running)
+    {
+        Py_DECREF(future);
+        return nullptr;
+    }
+    Py_DECREF(running);
+
+    const rgba_surface src = py_src->surf;
+    PyObject *result = PyBytes_FromStringAndSize(nullptr, compressed_size(*format, settings, src.width, src.height));
+    if (!result)
+    {
+        Py_DECREF(future);
+        return nullptr;
+    }
+    AsyncJob *job = new (std::nothrow) AsyncJob();
+    if (!job)
+    {
+        Py_DECREF(result);
+        Py_DECREF(future);
+        return PyErr_NoMemory();
+    }
+    job->format = format;
+    job->settings = settings;
+    job->src = src;
+    job->pixel_format = py_src->pixel_format;
+    job->dst = (uint8_t *)PyBytes_AsString(result);
+    job->surface = reinterpret_cast<PyObject *>(py_src);
+    Py_INCREF(job->surface);
+    job->result = result;
+    // the job gets its own reference, it may be done before this returns
+    job->future = future;
+    Py_INCREF(job->future);
+
+    begin_async_job();
+    Py_BEGIN_ALLOW_THREADS
+        submit_async_job(job, threads);
+    Py_END_ALLOW_THREADS return future;
+}
+
+PyObject *py_compressed_size(PyObject *self, PyObject *args, PyObject *kwds) noexcept
+{
+    static const char *kwlist[] = {"format", "width", "height", "settings", nullptr};
+    const char *format_name;
+    int width;
+    int height;
+    PyObject *py_settings = nullptr;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "sii|O", const_cast<char **>(kwlist), &format_name, &width, &height, &py_settings))
+        return nullptr;
+
+    const FormatInfo *format = find_format(format_name);
+    if (!format)
+        return nullptr;
+    EncSettings settings = {};
+    if (!parse_settings(*format, py_settings, settings))
+        return nullptr;
+    if (width < 0 || height < 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "width and height must be >= 0");
+        return nullptr;
+    }
+    return PyLong_FromSize_t(compressed_size(*format, settings, width, height));
+}
+
+PyObject *py_configure_thread_pool(PyObject *self, PyObject *args, PyObject *kwds) noexcept
+{
+    static const char *kwlist[] = {"threads", "pin", nullptr};
+    int threads = 0;
+    int pin = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O&p", const_cast<char **>(kwlist), threads_converter, &threads, &pin))
+        return nullptr;
+
+    bool success = true;
+    Py_BEGIN_ALLOW_THREADS try
+    {
+        configure_thread_pool(threads, pin != 0);
+    }
+    catch (const std::exception &)
+    {
+        success = false;
+    }
+    Py_END_ALLOW_THREADS if (!success)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "failed to create the thread pool");
+        return nullptr;
+    }
+    Py_RETURN_NONE;
+}
+
+PyObject *py_thread_pool_size(PyObject *self, PyObject *) noexcept
+{
+    // no reference to the pool is taken, so that the last one is never dropped while holding the GIL
+    int size;
     Py_BEGIN_ALLOW_THREADS
-        compress_func(&src, dst, &py_settings->settings);
-    Py_END_ALLOW_THREADS return result;
+        size = shared_pool_size();
+    Py_END_ALLOW_THREADS return PyLong_FromLong(size);
+}
+
+// the ISA the ISPC dispatcher runs the kernels with on this cpu
+PyObject *py_cpu_target(PyObject *self, PyObject *) noexcept
+{
+    const char *isa = active_kernel_isa();
+    if (!isa)
+        Py_RETURN_NONE;
+    return PyUnicode_FromString(isa);
 }
 
 // Exported methods are collected in a table
-constexpr PyMethodDef method_table[] = {
-    {"compress_blocks_bc1", py_compress<CompressBlocksBC1, 1>, METH_VARARGS, "compress a rgba_surface to bc1"},
-    {"compress_blocks_bc3", py_compress<CompressBlocksBC3, 1>, METH_VARARGS, "compress a rgba_surface to bc3"},
-    {"compress_blocks_bc4", py_compress<CompressBlocksBC4, 2>, METH_VARARGS, "compress a rgba_surface to bc4"},
-    {"compress_blocks_bc5", py_compress<CompressBlocksBC5, 1>, METH_VARARGS, "compress a rgba_surface to bc5"},
-    {"compress_blocks_bc6h", py_compress_s<CompressBlocksBC6H, BC6HEncSettingsObject, &BC6HEncSettingsObjectType>, METH_VARARGS, "compress a rgba_surface to bc6h"},
-    {"compress_blocks_bc7", py_compress_s<CompressBlocksBC7, BC7EncSettingsObject, &BC7EncSettingsObjectType>, METH_VARARGS, "compress a rgba_surface to bc7"},
-    {"compress_blocks_etc1", py_compress_s<CompressBlocksETC1, ETCEncSettingsObject, &ETCEncSettingsObjectType>, METH_VARARGS, "compress a rgba_surface to etc1"},
-    {"compress_blocks_astc", py_compress_s<CompressBlocksASTC, ASTCEncSettingsObject, &ASTCEncSettingsObjectType>, METH_VARARGS, "compress a rgba_surface to astc"},
+PyMethodDef method_table[] = {
+    {"compress_blocks_bc1", (PyCFunction)(void (*)(void))py_compress<FORMAT_BC1>, METH_FASTCALL | METH_KEYWORDS, "compress a rgba_surface to bc1"},
+    {"compress_blocks_bc3", (PyCFunction)(void (*)(void))py_compress<FORMAT_BC3>, METH_FASTCALL | METH_KEYWORDS, "compress a rgba_surface to bc3"},
+    {"compress_blocks_bc4", (PyCFunction)(void (*)(void))py_compress<FORMAT_BC4>, METH_FASTCALL | METH_KEYWORDS, "compress a rgba_surface to bc4"},
+    {"compress_blocks_bc5", (PyCFunction)(void (*)(void))py_compress<FORMAT_BC5>, METH_FASTCALL | METH_KEYWORDS, "compress a rgba_surface to bc5"},
+    {"compress_blocks_bc6h", (PyCFunction)(void (*)(void))py_compress<FORMAT_BC6H>, METH_FASTCALL | METH_KEYWORDS, "compress a rgba_surface to bc6h"},
+    {"compress_blocks_bc7", (PyCFunction)(void (*)(void))py_compress<FORMAT_BC7>, METH_FASTCALL | METH_KEYWORDS, "compress a rgba_surface to bc7"},
+    {"compress_blocks_etc1", (PyCFunction)(void (*)(void))py_compress<FORMAT_ETC1>, METH_FASTCALL | METH_KEYWORDS, "compress a rgba_surface to etc1"},
+    {"compress_blocks_astc", (PyCFunction)(void (*)(void))py_compress<FORMAT_ASTC>, METH_FASTCALL | METH_KEYWORDS, "compress a rgba_surface to astc"},
+    {"compress_blocks_bc1_into", (PyCFunction)(void (*)(void))py_compress_into<FORMAT_BC1>, METH_FASTCALL | METH_KEYWORDS, "compress a rgba_surface to bc1 into a writable buffer"},
+    {"compress_blocks_bc3_into", (PyCFunction)(void (*)(void))py_compress_into<FORMAT_BC3>, METH_FASTCALL | METH_KEYWORDS, "compress a rgba_surface to bc3 into a writable buffer"},
+    {"compress_blocks_bc4_into", (PyCFunction)(void (*)(void))py_compress_into<FORMAT_BC4>, METH_FASTCALL | METH_KEYWORDS, "compress a rgba_surface to bc4 into a writable buffer"},
+    {"compress_blocks_bc5_into", (PyCFunction)(void (*)(void))py_compress_into<FORMAT_BC5>, METH_FASTCALL | METH_KEYWORDS, "compress a rgba_surface to bc5 into a writable buffer"},
+    {"compress_blocks_bc6h_into", (PyCFunction)(void (*)(void))py_compress_into<FORMAT_BC6H>, METH_FASTCALL | METH_KEYWORDS, "compress a rgba_surface to bc6h into a writable buffer"},
+    {"compress_blocks_bc7_into", (PyCFunction)(void (*)(void))py_compress_into<FORMAT_BC7>, METH_FASTCALL | METH_KEYWORDS, "compress a rgba_surface to bc7 into a writable buffer"},
+    {"compress_blocks_etc1_into", (PyCFunction)(void (*)(void))py_compress_into<FORMAT_ETC1>, METH_FASTCALL | METH_KEYWORDS, "compress a rgba_surface to etc1 into a writable buffer"},
+    {"compress_blocks_astc_into", (PyCFunction)(void (*)(void))py_compress_into<FORMAT_ASTC>, METH_FASTCALL | METH_KEYWORDS, "compress a rgba_surface to astc into a writable buffer"},
+    {"decompress_blocks_bc1", (PyCFunction)py_decompress<FORMAT_BC1>, METH_VARARGS | METH_KEYWORDS, "decompress bc1 blocks into a rgba_surface"},
+    {"decompress_blocks_bc3", (PyCFunction)py_decompress<FORMAT_BC3>, METH_VARARGS | METH_KEYWORDS, "decompress bc3 blocks into a rgba_surface"},
+    {"decompress_blocks_bc4", (PyCFunction)py_decompress<FORMAT_BC4>, METH_VARARGS | METH_KEYWORDS, "decompress bc4 blocks into a rgba_surface"},
+    {"decompress_blocks_bc5", (PyCFunction)py_decompress<FORMAT_BC5>, METH_VARARGS | METH_KEYWORDS, "decompress bc5 blocks into a rgba_surface"},
+    {"decompress_blocks_bc6h", (PyCFunction)py_decompress<FORMAT_BC6H>, METH_VARARGS | METH_KEYWORDS, "decompress bc6h blocks into a rgba_surface"},
+    {"decompress_blocks_bc7", (PyCFunction)py_decompress<FORMAT_BC7>, METH_VARARGS | METH_KEYWORDS, "decompress bc7 blocks into a rgba_surface"},
+    {"decompress_blocks_etc1", (PyCFunction)py_decompress<FORMAT_ETC1>, METH_VARARGS | METH_KEYWORDS, "decompress etc1 blocks into a rgba_surface"},
+    {"decompress_blocks_astc", (PyCFunction)py_decompress<FORMAT_ASTC>, METH_VARARGS | METH_KEYWORDS, "decompress astc blocks into a rgba_surface"},
+    {"compress_batch", (PyCFunction)py_compress_batch, METH_VARARGS | METH_KEYWORDS, "compress a sequence of rgba_surfaces with a single call"},
+    {"compress_mip_chain", (PyCFunction)py_compress_mip_chain, METH_VARARGS | METH_KEYWORDS, "generate and compress the mip chain of a rgba_surface"},
+    {"compress_to_file", (PyCFunction)py_compress_to_file, METH_VARARGS | METH_KEYWORDS, "compress a rgba_surface into a file at the given offset"},
+    {"compress_region", (PyCFunction)py_compress_region, METH_VARARGS | METH_KEYWORDS, "recompress the blocks of a changed rectangle into existing compressed data"},
+    {"write_dds", (PyCFunction)py_write_container<dds_layout>, METH_VARARGS | METH_KEYWORDS, "compress the mip chains of surfaces into a DDS file"},
+    {"write_ktx2", (PyCFunction)py_write_container<ktx2_layout>, METH_VARARGS | METH_KEYWORDS, "compress the mip chains of surfaces into a KTX2 file"},
+    {"compress_adaptive", (PyCFunction)py_compress_adaptive, METH_VARARGS | METH_KEYWORDS, "compress with fast settings and again with slow settings where the error is high"},
+    {"compress_async", (PyCFunction)py_compress_async, METH_VARARGS | METH_KEYWORDS, "compress on the shared thread pool, returning a concurrent.futures.Future"},
+    {"compressed_size", (PyCFunction)py_compressed_size, METH_VARARGS | METH_KEYWORDS, "size of the compressed data of a surface"},
+    {"configure_thread_pool", (PyCFunction)py_configure_thread_pool, METH_VARARGS | METH_KEYWORDS, "(re)create the thread pool shared by all compress calls"},
+    {"thread_pool_size", py_thread_pool_size, METH_NOARGS, "number of workers of the shared thread pool"},
+    {"cpu_target", py_cpu_target, METH_NOARGS, "ISA of the kernels running on this cpu"},
+    {"enable_stats", (PyCFunction)py_enable_stats, METH_VARARGS | METH_KEYWORDS, "turn the call counters of stats() on or off"},
+    {"stats", py_stats, METH_NOARGS, "call counters per format and profile"},
+    {"reset_stats", py_reset_stats, METH_NOARGS, "zero the call counters"},
     {NULL, NULL, 0, NULL} // Sentinel value ending the table
 };
 
@@ -98,11 +821,34 @@ PyMODINIT_FUNC PyInit__ispc_texcomp()
     success &= create_type(&ETCEncSettingsType_Spec, &ETCEncSettingsObjectType, "ETCEncSettings");
     success &= create_type(&ASTCEncSettingsType_Spec, &ASTCEncSettingsObjectType, "ASTCEncSettings");
     success &= create_type(&RGBASurfaceType_Spec, &RGBASurfaceObjectType, "RGBASurface");
+    if (success)
+    {
+        RGBAHalfSurfaceObjectType = reinterpret_cast<PyTypeObject *>(PyType_FromSpecWithBases(&RGBAHalfSurfaceType_Spec, reinterpret_cast<PyObject *>(RGBASurfaceObjectType)));
+        success &= RGBAHalfSurfaceObjectType && register_type(m, RGBAHalfSurfaceObjectType, "RGBAHalfSurface");
+    }
+    success &= create_type(&StreamEncoderType_Spec, &StreamEncoderObjectType, "StreamEncoder");
+    success &= create_type(&EncoderType_Spec, &EncoderObjectType, "Encoder");
+    success &= create_type(&BlockCacheType_Spec, &BlockCacheObjectType, "BlockCache");
+    success &= create_type(&EncodeCacheType_Spec, &EncodeCacheObjectType, "EncodeCache");
 
     if (!success)
     {
         Py_DECREF(m);
         return nullptr;
     }
+    // the pending compress_async jobs need the GIL to complete, so they are waited for while the interpreter is still alive
+    PyObject *atexit = PyImport_ImportModule("atexit");
+    PyObject *wait = PyCFunction_New(&wait_async_jobs_def, nullptr);
+    PyObject *registered = atexit && wait ? PyObject_CallMethod(atexit, "register", "O", wait) : nullptr;
+    Py_XDECREF(atexit);
+    Py_XDECREF(wait);
+    if (!registered)
+    {
+        Py_DECREF(m);
+        return nullptr;
+    }
+    Py_DECREF(registered);
+    // join the idle workers before the interpreter is gone, instead of relying on static destructors
+    Py_AtExit(shutdown_thread_pool);
     return m;
 }
\ No newline at end of file
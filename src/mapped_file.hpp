@@ -0,0 +1,181 @@
+#pragma once
+#include <cstdint>
+#include <Python.h>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// A range of a file mapped into memory, all zero if nothing is mapped.
+struct MappedFile
+{
+    // start of the requested range
+    uint8_t *data;
+    size_t size;
+    bool writable;
+    // the mapping itself starts at an offset aligned to the allocation granularity
+    uint8_t *base;
+    size_t base_size;
+};
+
+size_t map_granularity() noexcept
+{
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwAllocationGranularity;
+#else
+    return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+void unmap_file(MappedFile &file) noexcept
+{
+    if (file.base)
+    {
+#if defined(_WIN32)
+        UnmapViewOfFile(file.base);
+#else
+        munmap(file.base, file.base_size);
+#endif
+    }
+    file = {};
+}
+
+// Maps [offset, offset + size) of the file at path (str, bytes or os.PathLike).
+// Read-only files have to contain the range, writable files are created or extended as needed.
+// Sets an OSError or ValueError and returns false on failure.
+bool map_file(PyObject *path, bool writable, size_t offset, size_t size, MappedFile &file) noexcept
+{
+    file = {};
+    const size_t aligned = offset / map_granularity() * map_granularity();
+    const size_t base_size = offset - aligned + size;
+    const size_t end = offset + size;
+
+#if defined(_WIN32)
+    PyObject *decoded = nullptr;
+    if (!PyUnicode_FSDecoder(path, &decoded))
+        return false;
+    wchar_t *wide_path = PyUnicode_AsWideCharString(decoded, nullptr);
+    Py_DECREF(decoded);
+    if (!wide_path)
+        return false;
+
+    HANDLE handle = CreateFileW(wide_path,
+                                writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+                                FILE_SHARE_READ | (writable ? 0 : FILE_SHARE_WRITE),
+                                nullptr,
+                                writable ? OPEN_ALWAYS : OPEN_EXISTING,
+                                FILE_ATTRIBUTE_NORMAL,
+                                nullptr);
+    PyMem_Free(wide_path);
+    if (handle == INVALID_HANDLE_VALUE)
+    {
+        PyErr_SetExcFromWindowsErrWithFilenameObject(PyExc_OSError, GetLastError(), path);
+        return false;
+    }
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(handle, &file_size))
+    {
+        PyErr_SetExcFromWindowsErrWithFilenameObject(PyExc_OSError, GetLastError(), path);
+        CloseHandle(handle);
+        return false;
+    }
+    if (!writable && static_cast<unsigned long long>(file_size.QuadPart) < end)
+    {
+        PyErr_Format(PyExc_ValueError, "File too small (need %zu bytes at offset %zu, got %lld)", size, offset, file_size.QuadPart);
+        CloseHandle(handle);
+        return false;
+    }
+    if (size > 0)
+    {
+        // a mapping larger than the file extends it
+        const unsigned long long mapping_size = writable ? end : 0;
+        HANDLE mapping = CreateFileMappingW(handle, nullptr, writable ? PAGE_READWRITE : PAGE_READONLY,
+                                            static_cast<DWORD>(mapping_size >> 32), static_cast<DWORD>(mapping_size), nullptr);
+        const DWORD mapping_error = GetLastError();
+        CloseHandle(handle);
+        if (!mapping)
+        {
+            PyErr_SetExcFromWindowsErrWithFilenameObject(PyExc_OSError, mapping_error, path);
+            return false;
+        }
+        const unsigned long long view_offset = aligned;
+        void *base = MapViewOfFile(mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ,
+                                   static_cast<DWORD>(view_offset >> 32), static_cast<DWORD>(view_offset), base_size);
+        const DWORD view_error = GetLastError();
+        CloseHandle(mapping);
+        if (!base)
+        {
+            PyErr_SetExcFromWindowsErrWithFilenameObject(PyExc_OSError, view_error, path);
+            return false;
+        }
+        file.base = static_cast<uint8_t *>(base);
+    }
+    else
+    {
+        CloseHandle(handle);
+    }
+#else
+    PyObject *encoded = nullptr;
+    if (!PyUnicode_FSConverter(path, &encoded))
+        return false;
+    const int fd = open(PyBytes_AsString(encoded), writable ? O_RDWR | O_CREAT : O_RDONLY, 0666);
+    Py_DECREF(encoded);
+    if (fd < 0)
+    {
+        PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, path);
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0)
+    {
+        PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, path);
+        close(fd);
+        return false;
+    }
+    if (static_cast<unsigned long long>(info.st_size) < end)
+    {
+        if (!writable)
+        {
+            PyErr_Format(PyExc_ValueError, "File too small (need %zu bytes at offset %zu, got %lld)", size, offset, static_cast<long long>(info.st_size));
+            close(fd);
+            return false;
+        }
+        if (ftruncate(fd, static_cast<off_t>(end)) != 0)
+        {
+            PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, path);
+            close(fd);
+            return false;
+        }
+    }
+    if (size > 0)
+    {
+        void *base = mmap(nullptr, base_size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, static_cast<off_t>(aligned));
+        if (base == MAP_FAILED)
+        {
+            PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, path);
+            close(fd);
+            return false;
+        }
+        file.base = static_cast<uint8_t *>(base);
+    }
+    // the mapping stays valid without the descriptor
+    close(fd);
+#endif
+
+    file.base_size = file.base ? base_size : 0;
+    file.data = file.base ? file.base + (offset - aligned) : nullptr;
+    file.size = size;
+    file.writable = writable;
+    return true;
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+// Squared error between a surface and its compressed blocks, over the channels the format stores.
+struct EncodeMetrics
+{
+    double squared_error[4];
+    size_t pixels;
+    // mean squared error of each block in row major order, nullptr if it's not wanted
+    float *block_errors;
+};
+
+// reused by the decoded blocks of the error measurement
+thread_local std::vector<uint8_t> measure_scratch;
+
+inline float kernel_channel(const FormatInfo &format, const uint8_t *pixel, int channel) noexcept
+{
+    if (format.pixel_size == 8)
+    {
+        uint16_t half;
+        memcpy(&half, pixel + channel * 2, sizeof(half));
+        return half_to_float(half);
+    }
+    return pixel[channel];
+}
+
+// Decodes the compressed block row `row` of src and adds its squared errors to squared_error,
+// the mean squared error of each of its blocks goes to block_errors unless that's nullptr.
+void measure_block_row(const FormatInfo &format, const EncSettings &settings, const rgba_surface &src, const uint8_t *blocks, int row, PixelFormat pixel_format, double squared_error[4], float *block_errors) noexcept
+{
+    const int block_width = format.get_block_width(settings);
+    const int block_height = format.get_block_height(settings);
+    const int blocks_x = format.blocks_x(settings, src.width);
+    const int rows = std::min(block_height, src.height - row * block_height);
+
+    const rgba_surface source = kernel_source_rows(format, src, row * block_height, rows, pixel_format);
+    rgba_surface decoded = {nullptr, src.width, rows, src.width * format.pixel_size};
+    measure_scratch.resize(static_cast<size_t>(decoded.stride) * rows);
+    decoded.ptr = measure_scratch.data();
+    decompress_rows(format, settings, blocks + static_cast<size_t>(row) * blocks_x * format.block_size, decoded, 0, 1);
+
+    for (int bx = 0; bx < blocks_x; bx++)
+    {
+        const int x_end = std::min(src.width, (bx + 1) * block_width);
+        double block_error = 0;
+        for (int y = 0; y < rows; y++)
+        {
+            for (int x = bx * block_width; x < x_end; x++)
+            {
+                const uint8_t *a = source.ptr + static_cast<size_t>(y) * source.stride + static_cast<size_t>(x) * format.pixel_size;
+                const uint8_t *b = decoded.ptr + static_cast<size_t>(y) * decoded.stride + static_cast<size_t>(x) * format.pixel_size;
+                for (int c = 0; c < format.channels; c++)
+                {
+                    const double diff = kernel_channel(format, a, c) - kernel_channel(format, b, c);
+                    squared_error[c] += diff * diff;
+                    block_error += diff * diff;
+                }
+            }
+        }
+        if (block_errors)
+            block_errors[bx] = static_cast<float>(block_error / ((x_end - bx * block_width) * rows * format.channels));
+    }
+}
+
+// compresses the surface like compress_surface_cached, measuring each block row right after it's compressed while it's still cached
+void compress_surface_measured(const FormatInfo &format, EncSettings &settings, const rgba_surface &src, uint8_t *dst, int threads, PixelFormat pixel_format, BlockCache *cache, EncodeMetrics &metrics) noexcept
+{
+    std::mutex mutex;
+    metrics.pixels = static_cast<size_t>(src.width) * src.height;
+    std::fill(metrics.squared_error, metrics.squared_error + 4, 0.0);
+    const int blocks_x = format.blocks_x(settings, src.width);
+    parallel_for(format.blocks_y(settings, src.height), threads, [&](int begin, int end)
+                 {
+        double squared_error[4] = {};
+        for (int row = begin; row < end; row++)
+        {
+            if (cache)
+                compress_rows_cached(format, settings, src, dst, row, row + 1, pixel_format, *cache);
+            else
+                compress_rows(format, settings, src, dst, row, row + 1, pixel_format);
+            measure_block_row(format, settings, src, dst, row, pixel_format, squared_error, metrics.block_errors ? metrics.block_errors + static_cast<size_t>(row) * blocks_x : nullptr);
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        for (int c = 0; c < 4; c++)
+            metrics.squared_error[c] += squared_error[c]; });
+}
+
+// peak signal to noise ratio of a mean squared error, the peak being 255 for unorm8 and 1.0 for half floats
+inline double psnr(const FormatInfo &format, double mse) noexcept
+{
+    const double peak = format.pixel_size == 8 ? 1.0 : 255.0;
+    return mse > 0 ? 10.0 * std::log10(peak * peak / mse) : HUGE_VAL;
+}
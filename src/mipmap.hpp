@@ -0,0 +1,321 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <vector>
+
+enum class MipFilter
+{
+    box,
+    kaiser,
+};
+
+// Kaiser windowed sinc as used by NVTT (width 3, alpha 4)
+constexpr float kaiser_width = 3.0f;
+constexpr float kaiser_alpha = 4.0f;
+
+// zeroth order modified bessel function of the first kind
+float bessel0(float x)
+{
+    const float eps = 1e-6f;
+    float xh = 0.5f * x;
+    float sum = 1.0f;
+    float pow = 1.0f;
+    float ds = 1.0f;
+    for (int k = 1; ds > sum * eps; k++)
+    {
+        pow *= xh / k;
+        ds = pow * pow;
+        sum += ds;
+    }
+    return sum;
+}
+
+// support radius of the filter in destination pixels
+float filter_support(MipFilter filter)
+{
+    return filter == MipFilter::box ? 0.5f : kaiser_width;
+}
+
+float filter_weight(MipFilter filter, float x)
+{
+    if (filter == MipFilter::box)
+        return (x >= -0.5f && x < 0.5f) ? 1.0f : 0.0f;
+
+    const float t = x / kaiser_width;
+    if (1.0f - t * t < 0.0f)
+        return 0.0f;
+    const float pi_x = 3.14159265358979f * x;
+    const float sinc = std::fabs(pi_x) < 1e-4f ? 1.0f : std::sin(pi_x) / pi_x;
+    return sinc * bessel0(kaiser_alpha * std::sqrt(1.0f - t * t)) / bessel0(kaiser_alpha);
+}
+
+// the source pixels and their normalized weights for every destination pixel of one axis
+struct FilterTaps
+{
+    int taps;
+    std::vector<int> index;
+    std::vector<float> weight;
+};
+
+FilterTaps make_taps(MipFilter filter, int src_size, int dst_size)
+{
+    const float scale = static_cast<float>(src_size) / dst_size;
+    const float radius = filter_support(filter) * scale;
+
+    FilterTaps result;
+    result.taps = static_cast<int>(std::ceil(radius * 2.0f)) + 1;
+    result.index.resize(static_cast<size_t>(dst_size) * result.taps);
+    result.weight.resize(static_cast<size_t>(dst_size) * result.taps);
+    for (int x = 0; x < dst_size; x++)
+    {
+        const float center = (x + 0.5f) * scale;
+        const int first = static_cast<int>(std::floor(center - radius));
+        int *index = &result.index[static_cast<size_t>(x) * result.taps];
+        float *weight = &result.weight[static_cast<size_t>(x) * result.taps];
+        float total = 0.0f;
+        for (int i = 0; i < result.taps; i++)
+        {
+            // clamp to edge addressing
+            index[i] = std::min(std::max(first + i, 0), src_size - 1);
+            weight[i] = filter_weight(filter, (first + i + 0.5f - center) / scale);
+            total += weight[i];
+        }
+        for (int i = 0; i < result.taps; i++)
+            weight[i] /= total;
+    }
+    return result;
+}
+
+// sRGB decoding of all 8 bit values
+const float *srgb_to_linear_table()
+{
+    static const auto table = []()
+    {
+        std::vector<float> values(256);
+        for (int i = 0; i < 256; i++)
+        {
+            const float c = i / 255.0f;
+            values[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+        return values;
+    }();
+    return table.data();
+}
+
+// sRGB encoding via a table over 16 bit linear values, which is fine enough for the darkest sRGB steps
+constexpr int linear_table_size = 1 << 16;
+
+uint8_t linear_to_srgb(float value)
+{
+    static const auto table = []()
+    {
+        std::vector<uint8_t> values(linear_table_size);
+        for (int i = 0; i < linear_table_size; i++)
+        {
+            const float l = static_cast<float>(i) / (linear_table_size - 1);
+            const float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+            values[i] = static_cast<uint8_t>(std::min(std::max(c * 255.0f + 0.5f, 0.0f), 255.0f));
+        }
+        return values;
+    }();
+    const float clamped = std::min(std::max(value, 0.0f), 1.0f);
+    return table[static_cast<int>(clamped * (linear_table_size - 1) + 0.5f)];
+}
+
+// Channel layout of the kernel input, 8 bit unorm channels or RGBA half floats (BC6H).
+struct PixelLayout
+{
+    int channels;
+    bool half;
+    bool srgb;
+
+    PixelLayout(int pixel_size, bool srgb) : channels(pixel_size == 8 ? 4 : pixel_size), half(pixel_size == 8), srgb(srgb && pixel_size == 4) {}
+
+    int pixel_size() const { return half ? 8 : channels; }
+
+    void load(const uint8_t *src, int width, float *dst) const
+    {
+        if (half)
+        {
+            const uint16_t *values = reinterpret_cast<const uint16_t *>(src);
+            for (int i = 0; i < width * 4; i++)
+                dst[i] = half_to_float(values[i]);
+        }
+        else if (srgb)
+        {
+            const float *table = srgb_to_linear_table();
+            for (int i = 0; i < width * 4; i += 4)
+            {
+                dst[i + 0] = table[src[i + 0]];
+                dst[i + 1] = table[src[i + 1]];
+                dst[i + 2] = table[src[i + 2]];
+                dst[i + 3] = src[i + 3] * (1.0f / 255.0f);
+            }
+        }
+        else
+        {
+            for (int i = 0; i < width * channels; i++)
+                dst[i] = src[i] * (1.0f / 255.0f);
+        }
+    }
+
+    void store(const float *src, int width, uint8_t *dst) const
+    {
+        if (half)
+        {
+            uint16_t *values = reinterpret_cast<uint16_t *>(dst);
+            for (int i = 0; i < width * 4; i++)
+                values[i] = float_to_half(src[i]);
+            return;
+        }
+        for (int i = 0; i < width * channels; i++)
+        {
+            if (srgb && (i & 3) != 3)
+                dst[i] = linear_to_srgb(src[i]);
+            else
+                dst[i] = static_cast<uint8_t>(std::min(std::max(src[i] * 255.0f + 0.5f, 0.0f), 255.0f));
+        }
+    }
+};
+
+// Downsamples src into dst with a separable filter, in linear space for sRGB data.
+// The vertical pass runs first on whole rows, so only two rows of floats are kept around.
+// Rows of src in another pixel format are converted to the layout of dst as they're loaded.
+void downsample(const rgba_surface &src, const rgba_surface &dst, const PixelLayout &layout, MipFilter filter, PixelFormat pixel_format = PixelFormat::native)
+{
+    const FilterTaps taps_x = make_taps(filter, src.width, dst.width);
+    const FilterTaps taps_y = make_taps(filter, src.height, dst.height);
+    const int channels = layout.channels;
+    const PixelFormat kernel_format = kernel_pixel_format(layout.pixel_size());
+    const bool convert = needs_conversion(pixel_format, layout.pixel_size());
+
+    std::vector<uint8_t> converted(convert ? static_cast<size_t>(src.width) * layout.pixel_size() : 0);
+    std::vector<float> line(static_cast<size_t>(src.width) * channels);
+    std::vector<float> column(static_cast<size_t>(src.width) * channels);
+    std::vector<float> row(static_cast<size_t>(dst.width) * channels);
+    for (int y = 0; y < dst.height; y++)
+    {
+        std::fill(column.begin(), column.end(), 0.0f);
+        for (int i = 0; i < taps_y.taps; i++)
+        {
+            const size_t tap = static_cast<size_t>(y) * taps_y.taps + i;
+            const float weight = taps_y.weight[tap];
+            if (weight == 0.0f)
+                continue;
+            const uint8_t *source = src.ptr + static_cast<size_t>(taps_y.index[tap]) * src.stride;
+            if (convert)
+            {
+                convert_row(pixel_format, kernel_format, source, src.width, converted.data());
+                source = converted.data();
+            }
+            layout.load(source, src.width, line.data());
+            for (size_t j = 0; j < column.size(); j++)
+                column[j] += weight * line[j];
+        }
+
+        for (int x = 0; x < dst.width; x++)
+        {
+            float *pixel = &row[static_cast<size_t>(x) * channels];
+            std::fill(pixel, pixel + channels, 0.0f);
+            for (int i = 0; i < taps_x.taps; i++)
+            {
+                const size_t tap = static_cast<size_t>(x) * taps_x.taps + i;
+                const float weight = taps_x.weight[tap];
+                const float *source = &column[static_cast<size_t>(taps_x.index[tap]) * channels];
+                for (int c = 0; c < channels; c++)
+                    pixel[c] += weight * source[c];
+            }
+        }
+        layout.store(row.data(), dst.width, dst.ptr + static_cast<size_t>(y) * dst.stride);
+    }
+}
+
+// looks up a mip filter by its name, sets a ValueError if there is none
+bool find_mip_filter(const char *name, MipFilter &filter) noexcept
+{
+    if (strcmp(name, "box") == 0)
+        filter = MipFilter::box;
+    else if (strcmp(name, "kaiser") == 0)
+        filter = MipFilter::kaiser;
+    else
+    {
+        PyErr_Format(PyExc_ValueError, "Invalid filter: '%s'", name);
+        return false;
+    }
+    return true;
+}
+
+// number of levels of a full mip chain down to 1x1
+int mip_count(int width, int height)
+{
+    int levels = 1;
+    for (int size = std::max(width, height); size > 1; size >>= 1)
+        levels++;
+    return levels;
+}
+
+// Generates and compresses the levels of a mip chain, level n is written to dst + offsets[n],
+// the levels don't have to be adjacent or in order. The calling thread downsamples level n+1 while the pool compresses the block rows of level n.
+// Returns false if the levels couldn't be allocated, dst is then only partially written.
+bool compress_mip_chain(const FormatInfo &format, EncSettings &settings, const rgba_surface &src, int levels, uint8_t *dst, const size_t *offsets, MipFilter filter, bool srgb, int threads, PixelFormat pixel_format = PixelFormat::native) noexcept
+{
+    const PixelLayout layout(format.pixel_size, srgb);
+
+    std::shared_ptr<ThreadPool> pool;
+    if (threads != 1)
+    {
+        try
+        {
+            pool = get_thread_pool();
+        }
+        catch (const std::exception &)
+        {
+            // compressed on this thread below
+        }
+    }
+
+    TaskGroup group;
+    // outlives the tasks reading the levels, also if allocating a later one fails
+    std::vector<std::vector<uint8_t>> data;
+    bool success = true;
+    try
+    {
+        data.resize(levels);
+        rgba_surface level = src;
+        for (int n = 0; n < levels; n++)
+        {
+            if (n > 0)
+            {
+                rgba_surface next = {nullptr, std::max(1, level.width >> 1), std::max(1, level.height >> 1), 0};
+                next.stride = next.width * format.pixel_size;
+                data[n].resize(static_cast<size_t>(next.stride) * next.height);
+                next.ptr = data[n].data();
+                // only level 0 is in the pixel format of the source
+                downsample(level, next, layout, filter, n == 1 ? pixel_format : PixelFormat::native);
+                level = next;
+            }
+            const PixelFormat level_format = n == 0 ? pixel_format : PixelFormat::native;
+
+            if (pool)
+            {
+                submit_chunks(*pool, group, format.blocks_y(settings, level.height), threads, [&format, &settings, level, level_format, dst = dst + offsets[n]](int begin, int end)
+                              { compress_rows(format, settings, level, dst, begin, end, level_format); });
+            }
+            else
+            {
+                compress_surface(format, settings, level, dst + offsets[n], 1, level_format);
+            }
+        }
+    }
+    catch (const std::bad_alloc &)
+    {
+        success = false;
+    }
+    if (pool)
+        pool->wait(group);
+    return success;
+}
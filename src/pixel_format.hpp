@@ -0,0 +1,263 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include "Python.h"
+
+float half_to_float(uint16_t h)
+{
+    const uint32_t sign = static_cast<uint32_t>(h & 0x8000) << 16;
+    uint32_t exponent = (h >> 10) & 0x1F;
+    uint32_t mantissa = h & 0x3FF;
+    uint32_t bits;
+    if (exponent == 0x1F)
+        bits = sign | 0x7F800000 | (mantissa << 13); // inf / nan
+    else if (exponent != 0)
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    else if (mantissa == 0)
+        bits = sign;
+    else
+    {
+        // subnormal, normalize it
+        exponent = 113;
+        while ((mantissa & 0x400) == 0)
+        {
+            mantissa <<= 1;
+            exponent--;
+        }
+        bits = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+    }
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+uint16_t float_to_half(float f)
+{
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    const uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+    const uint32_t abs = bits & 0x7FFFFFFF;
+    if (abs >= 0x7F800000)
+        return sign | 0x7C00 | (abs > 0x7F800000 ? 0x200 : 0); // inf / nan
+    if (abs >= 0x477FF000)
+        return sign | 0x7C00; // overflow
+    if (abs < 0x38800000)
+    {
+        // subnormal or zero, round to nearest even
+        if (abs < 0x33000000)
+            return sign;
+        const uint32_t shift = 125 - (abs >> 23);
+        const uint32_t mantissa = (abs & 0x7FFFFF) | 0x800000;
+        uint32_t half = mantissa >> (shift + 1);
+        const uint32_t rest = mantissa & ((1u << (shift + 1)) - 1);
+        const uint32_t halfway = 1u << shift;
+        if (rest > halfway || (rest == halfway && (half & 1)))
+            half++;
+        return sign | static_cast<uint16_t>(half);
+    }
+    // normal, round to nearest even
+    uint32_t half = ((abs >> 13) - (112 << 10));
+    const uint32_t rest = abs & 0x1FFF;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+        half++;
+    return sign | static_cast<uint16_t>(half);
+}
+
+// Layout of the pixels of a surface, native means the input layout of the kernel it's compressed with,
+// RGBA8 for most formats, R8 for BC4, RG8 for BC5 and RGBA half floats for BC6H.
+enum class PixelFormat : int
+{
+    native,
+    rgba8,
+    bgra8,
+    rgb8,
+    r8,
+    rg8,
+    rgba16f,
+    rgba32f,
+};
+
+struct PixelFormatInfo
+{
+    const char *name;
+    int channels;
+    // bytes per channel, 1 for unorm8, 2 for half and 4 for float
+    int channel_size;
+    // source channel of R, G, B and A, -1 if the format doesn't have it
+    int8_t source[4];
+    // buffer protocol format of a channel
+    const char *buffer_format;
+
+    int pixel_size() const { return channels * channel_size; }
+};
+
+// indexed by PixelFormat
+const PixelFormatInfo pixel_formats[] = {
+    {"native", 4, 1, {0, 1, 2, 3}, "B"},
+    {"rgba8", 4, 1, {0, 1, 2, 3}, "B"},
+    {"bgra8", 4, 1, {2, 1, 0, 3}, "B"},
+    {"rgb8", 3, 1, {0, 1, 2, -1}, "B"},
+    {"r8", 1, 1, {0, -1, -1, -1}, "B"},
+    {"rg8", 2, 1, {0, 1, -1, -1}, "B"},
+    {"rgba16f", 4, 2, {0, 1, 2, 3}, "e"},
+    {"rgba32f", 4, 4, {0, 1, 2, 3}, "f"},
+};
+
+const PixelFormatInfo &get_pixel_format(PixelFormat pixel_format) noexcept
+{
+    return pixel_formats[static_cast<int>(pixel_format)];
+}
+
+// looks up a pixel format by its name, nullptr being native, sets a ValueError if there is none
+bool find_pixel_format(const char *name, PixelFormat &pixel_format) noexcept
+{
+    pixel_format = PixelFormat::native;
+    if (name == nullptr)
+        return true;
+    for (size_t i = 1; i < sizeof(pixel_formats) / sizeof(pixel_formats[0]); i++)
+    {
+        if (strcmp(pixel_formats[i].name, name) == 0)
+        {
+            pixel_format = static_cast<PixelFormat>(i);
+            return true;
+        }
+    }
+    PyErr_Format(PyExc_ValueError, "Invalid pixel format: '%s'", name);
+    return false;
+}
+
+// the kernel input layout for the given bytes per pixel
+PixelFormat kernel_pixel_format(int pixel_size) noexcept
+{
+    switch (pixel_size)
+    {
+    case 1:
+        return PixelFormat::r8;
+    case 2:
+        return PixelFormat::rg8;
+    case 8:
+        return PixelFormat::rgba16f;
+    default:
+        return PixelFormat::rgba8;
+    }
+}
+
+// whether surfaces of the pixel format have to be converted before the kernel with the given input size gets them
+bool needs_conversion(PixelFormat pixel_format, int pixel_size) noexcept
+{
+    return pixel_format != PixelFormat::native && pixel_format != kernel_pixel_format(pixel_size);
+}
+
+// Converts one row of pixels, missing color channels become 0 and a missing alpha becomes opaque.
+// Floats are clamped to [0, 1] for unorm8 output.
+void convert_row(PixelFormat from, PixelFormat to, const uint8_t *src, int width, uint8_t *dst) noexcept
+{
+    const PixelFormatInfo &in = get_pixel_format(from);
+    const PixelFormatInfo &out = get_pixel_format(to);
+    const int in_channels = in.channels;
+    const int out_channels = out.channels;
+
+    // the RGBA channel stored in each channel of the output
+    int logical[4] = {0, 1, 2, 3};
+    for (int c = 0; c < 4; c++)
+    {
+        if (out.source[c] >= 0)
+            logical[out.source[c]] = c;
+    }
+
+    if (in.channel_size == 1 && out.channel_size == 1)
+    {
+        // plain swizzle, channel by channel so that the loops stay simple enough to be vectorized
+        for (int c = 0; c < out_channels; c++)
+        {
+            const int source = in.source[logical[c]];
+            if (source < 0)
+            {
+                const uint8_t value = logical[c] == 3 ? 255 : 0;
+                for (int x = 0; x < width; x++)
+                    dst[x * out_channels + c] = value;
+            }
+            else
+            {
+                for (int x = 0; x < width; x++)
+                    dst[x * out_channels + c] = src[x * in_channels + source];
+            }
+        }
+        return;
+    }
+
+    const size_t in_size = in.pixel_size();
+    const size_t out_size = out.pixel_size();
+    for (int x = 0; x < width; x++)
+    {
+        const uint8_t *pixel = src + x * in_size;
+        float rgba[4];
+        for (int c = 0; c < 4; c++)
+        {
+            const int source = in.source[c];
+            if (source < 0)
+                rgba[c] = c == 3 ? 1.0f : 0.0f;
+            else if (in.channel_size == 1)
+                rgba[c] = pixel[source] * (1.0f / 255.0f);
+            else if (in.channel_size == 2)
+            {
+                uint16_t value;
+                memcpy(&value, pixel + source * 2, sizeof(value));
+                rgba[c] = half_to_float(value);
+            }
+            else
+                memcpy(&rgba[c], pixel + source * 4, sizeof(float));
+        }
+
+        uint8_t *target = dst + x * out_size;
+        for (int c = 0; c < out_channels; c++)
+        {
+            const float value = rgba[logical[c]];
+            if (out.channel_size == 1)
+                // NaN ends up as 0
+                target[c] = static_cast<uint8_t>(std::min(255.0f, std::max(0.0f, value * 255.0f + 0.5f)));
+            else if (out.channel_size == 2)
+            {
+                // BC6H is unsigned, negative halves would be read as huge values
+                const uint16_t half = float_to_half(std::min(65504.0f, std::max(0.0f, value)));
+                memcpy(target + c * 2, &half, sizeof(half));
+            }
+            else
+                memcpy(target + c * 4, &value, sizeof(value));
+        }
+    }
+}
+
+// Finds the first pixel BC6H can't encode (negative, infinite or NaN) of a half or float surface.
+bool find_invalid_hdr_pixel(const rgba_surface &surf, PixelFormat pixel_format, int &x, int &y) noexcept
+{
+    const bool half = pixel_format == PixelFormat::rgba16f;
+    for (y = 0; y < surf.height; y++)
+    {
+        const uint8_t *row = surf.ptr + static_cast<size_t>(y) * surf.stride;
+        for (x = 0; x < surf.width; x++)
+        {
+            bool invalid = false;
+            for (int c = 0; c < 4; c++)
+            {
+                if (half)
+                {
+                    uint16_t value;
+                    memcpy(&value, row + (x * 4 + c) * 2, sizeof(value));
+                    // sign set (except -0) or all exponent bits set
+                    invalid |= (value > 0x8000) || (value & 0x7C00) == 0x7C00;
+                }
+                else
+                {
+                    float value;
+                    memcpy(&value, row + (x * 4 + c) * 4, sizeof(value));
+                    invalid |= !(value >= 0.0f && value <= 3.4028235e38f);
+                }
+            }
+            if (invalid)
+                return true;
+        }
+    }
+    return false;
+}
@@ -2,74 +2,338 @@
 #include "structmember.h"
 
 PyTypeObject *RGBASurfaceObjectType = nullptr;
+PyTypeObject *RGBAHalfSurfaceObjectType = nullptr;
 
 typedef struct
 {
     PyObject_HEAD
         Py_buffer view;
     rgba_surface surf;
+    // set instead of view for surfaces created by from_file
+    MappedFile file;
+    // converted to the kernel input as the block rows are compressed
+    PixelFormat pixel_format;
+    // set instead of view for surfaces created from arrays, shared by the images of a batch
+    PyObject *owner;
+    bool readonly;
 } RGBASurfaceObject;
 
-void RGBASurface_dealloc(RGBASurfaceObject *self)
+// releases the memory the surface points to
+void RGBASurface_clear(RGBASurfaceObject *self)
 {
     if (self->view.buf != nullptr)
     {
         PyBuffer_Release(&self->view);
     }
+    self->view = {};
+    unmap_file(self->file);
+    Py_CLEAR(self->owner);
+    self->readonly = false;
+    self->surf = {};
+}
+
+void RGBASurface_dealloc(RGBASurfaceObject *self)
+{
+    RGBASurface_clear(self);
     PyObject_Del((PyObject *)self);
 }
 
-int RGBASurface_init(RGBASurfaceObject *self, PyObject *args, PyObject *kwds)
+// Checks the geometry of a surface, defaulting the stride to packed rows, and sets size to the bytes its rows span.
+// Sets a ValueError if it's invalid.
+bool RGBASurface_checkGeometry(rgba_surface &surf, PixelFormat pixel_format, size_t &size)
 {
-    self->view = {};
-    self->surf = {};
+    if (surf.width < 0 || surf.height < 0 || surf.stride < 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "width, height and stride must be >= 0");
+        return false;
+    }
+
+    // Auto-calculate stride if not provided
+    const size_t row_size = static_cast<size_t>(surf.width) * get_pixel_format(pixel_format).pixel_size();
+    if (surf.stride == 0)
+    {
+        if (row_size > INT_MAX)
+        {
+            PyErr_SetString(PyExc_ValueError, "the rows are too large for the stride");
+            return false;
+        }
+        surf.stride = static_cast<int32_t>(row_size);
+    }
+    // native surfaces may hold the R8 or RG8 input of BC4 and BC5, their rows are checked once the kernel is known
+    else if (pixel_format != PixelFormat::native && static_cast<size_t>(surf.stride) < row_size)
+    {
+        PyErr_SetString(PyExc_ValueError, "stride is smaller than a row");
+        return false;
+    }
 
+    if (surf.height > 0 && static_cast<size_t>(surf.stride) > SIZE_MAX / static_cast<size_t>(surf.height))
+    {
+        PyErr_SetString(PyExc_ValueError, "the surface is too large");
+        return false;
+    }
+    size = static_cast<size_t>(surf.stride) * surf.height;
+    return true;
+}
+
+// checks the parsed geometry against the buffer and points the surface at it
+int RGBASurface_setGeometry(RGBASurfaceObject *self)
+{
+    size_t expected_size;
+    if (!RGBASurface_checkGeometry(self->surf, self->pixel_format, expected_size))
+        return -1;
+
+    // Validate geometry
+    if (static_cast<size_t>(self->view.len) < expected_size)
+    {
+        PyErr_Format(PyExc_ValueError,
+                     "Buffer too small (need %zu bytes, got %zd)",
+                     expected_size, self->view.len);
+        return -1;
+    }
+
+    self->surf.ptr = static_cast<uint8_t *>(self->view.buf);
+    return 0;
+}
+
+// mapped source files, read-only buffers and read-only arrays can't be written to
+bool RGBASurface_isReadonly(const RGBASurfaceObject *self)
+{
+    if (self->file.base)
+        return !self->file.writable;
+    return self->owner ? self->readonly : self->view.readonly != 0;
+}
+
+// Checks that the rows of the surface, with pixels of pixel_size bytes, lie within the memory it points to.
+// Array surfaces are checked by array_surface as they're created.
+bool RGBASurface_checkExtent(const RGBASurfaceObject *self, int pixel_size)
+{
+    if (self->owner || self->surf.height <= 0 || self->surf.width <= 0)
+        return true;
+    const size_t available = self->file.base ? self->file.size : static_cast<size_t>(self->view.len);
+    const size_t needed = static_cast<size_t>(self->surf.height - 1) * self->surf.stride + static_cast<size_t>(self->surf.width) * pixel_size;
+    if (needed > available)
+    {
+        PyErr_Format(PyExc_ValueError, "the surface needs %zu bytes, its buffer has %zu", needed, available);
+        return false;
+    }
+    return true;
+}
+
+// Points the surface at an array of shape (H, W) or (H, W, C), or at image index of an (N, H, W, C) batch.
+// The pixel format is derived from the channels if none is given.
+int RGBASurface_setArray(RGBASurfaceObject *self, const SurfaceArray &array, Py_ssize_t index, const char *pixel_format)
+{
+    if (!array_pixel_format(array, pixel_format, self->pixel_format))
+        return -1;
+    if (!array_surface(array, index, get_pixel_format(self->pixel_format).pixel_size(), self->surf))
+        return -1;
+    Py_INCREF(array.owner);
+    self->owner = array.owner;
+    self->readonly = array.readonly;
+    return 0;
+}
+
+// Parses the src, width and height of the constructors, an array if width and height are left out,
+// otherwise a contiguous buffer like the "y*" format unit.
+int RGBASurface_setSource(RGBASurfaceObject *self, PyObject *src, const char *pixel_format)
+{
+    if (self->surf.width == -1 && self->surf.height == -1)
+    {
+        if (self->surf.stride != 0)
+        {
+            PyErr_SetString(PyExc_TypeError, "stride is taken from the array, it can't be passed without width and height");
+            return -1;
+        }
+        SurfaceArray array;
+        int result = -1;
+        if (get_surface_array(src, array))
+        {
+            if (array.ndim == 4)
+                PyErr_SetString(PyExc_ValueError, "use from_array for batches of shape (N, H, W, C)");
+            else
+                result = RGBASurface_setArray(self, array, 0, pixel_format);
+        }
+        Py_XDECREF(array.owner);
+        return result;
+    }
+    if (self->surf.width == -1 || self->surf.height == -1)
+    {
+        PyErr_SetString(PyExc_TypeError, "width and height have to be passed together");
+        return -1;
+    }
+    if (!find_pixel_format(pixel_format, self->pixel_format))
+        return -1;
+    if (PyObject_GetBuffer(src, &self->view, PyBUF_SIMPLE) < 0)
+        return -1;
+    return RGBASurface_setGeometry(self);
+}
+
+int RGBASurface_init(RGBASurfaceObject *self, PyObject *args, PyObject *kwds)
+{
     static const char *kwlist[] = {
         "src",
         "width",
         "height",
         "stride",
+        "pixel_format",
         nullptr};
+    PyObject *src;
+    const char *pixel_format = nullptr;
 
     // Clear existing buffer if reinitialized
-    if (self->view.buf)
-        PyBuffer_Release(&self->view);
+    RGBASurface_clear(self);
+    self->surf.width = -1;
+    self->surf.height = -1;
 
     // Parse arguments
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "y*ii|i",
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|iiiz",
                                      const_cast<char **>(kwlist),
-                                     &self->view,
+                                     &src,
                                      &self->surf.width,
                                      &self->surf.height,
-                                     &self->surf.stride))
+                                     &self->surf.stride,
+                                     &pixel_format))
+    {
+        self->surf = {};
+        return -1;
+    }
+    if (RGBASurface_setSource(self, src, pixel_format) < 0)
     {
+        RGBASurface_clear(self);
         return -1;
     }
+    return 0;
+};
 
-    // Auto-calculate stride if not provided
-    if (self->surf.stride == 0)
+int RGBAHalfSurface_validate(RGBASurfaceObject *self, bool validate);
+
+// maps a raw file instead of reading it into memory, the pages are only loaded once they're compressed
+PyObject *RGBASurface_fromFile(PyObject *cls, PyObject *args, PyObject *kwds)
+{
+    static const char *kwlist[] = {
+        "path",
+        "width",
+        "height",
+        "stride",
+        "offset",
+        "pixel_format",
+        "validate",
+        nullptr};
+
+    PyObject *path;
+    rgba_surface surf = {};
+    Py_ssize_t offset = 0;
+    const char *pixel_format_name = nullptr;
+    PixelFormat pixel_format;
+    int validate = 1;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "Oii|inz$p",
+                                     const_cast<char **>(kwlist),
+                                     &path,
+                                     &surf.width,
+                                     &surf.height,
+                                     &surf.stride,
+                                     &offset,
+                                     &pixel_format_name,
+                                     &validate))
     {
-        self->surf.stride = self->surf.width * 4; // RGBA
+        return nullptr;
     }
+    if (!find_pixel_format(pixel_format_name, pixel_format))
+        return nullptr;
+    // half surfaces default to half floats instead of the kernel input
+    const bool half = RGBAHalfSurfaceObjectType && PyType_IsSubtype(reinterpret_cast<PyTypeObject *>(cls), RGBAHalfSurfaceObjectType);
+    if (pixel_format == PixelFormat::native && half)
+        pixel_format = PixelFormat::rgba16f;
 
-    // Validate geometry
-    const size_t expected_size = self->surf.stride * self->surf.height;
-    if (self->view.len < expected_size)
+    if (offset < 0)
     {
-        PyErr_Format(PyExc_ValueError,
-                     "Buffer too small (need %zu bytes, got %zd)",
-                     expected_size, self->view.len);
-        return -1;
+        PyErr_SetString(PyExc_ValueError, "offset must be >= 0");
+        return nullptr;
     }
+    size_t size;
+    if (!RGBASurface_checkGeometry(surf, pixel_format, size))
+        return nullptr;
 
-    self->surf.ptr = static_cast<uint8_t *>(self->view.buf);
-    return 0;
+    RGBASurfaceObject *self = reinterpret_cast<RGBASurfaceObject *>(PyType_GenericNew(reinterpret_cast<PyTypeObject *>(cls), nullptr, nullptr));
+    if (!self)
+        return nullptr;
+    if (!map_file(path, false, offset, size, self->file))
+    {
+        Py_DECREF(self);
+        return nullptr;
+    }
+    self->surf = surf;
+    self->surf.ptr = self->file.data;
+    self->pixel_format = pixel_format;
+    if (half && RGBAHalfSurface_validate(self, validate) < 0)
+    {
+        Py_DECREF(self);
+        return nullptr;
+    }
+    return reinterpret_cast<PyObject *>(self);
+}
+
+// Surfaces pointing into a buffer protocol or DLPack array, a list of them for (N, H, W, C) batches, which share the
+// array without copying it, e.g. the tiles of an atlas view reshaped to (tiles, tile_height, width, C).
+PyObject *RGBASurface_fromArray(PyObject *cls, PyObject *args, PyObject *kwds)
+{
+    static const char *kwlist[] = {
+        "array",
+        "pixel_format",
+        "validate",
+        nullptr};
+
+    PyObject *src;
+    const char *pixel_format = nullptr;
+    int validate = 1;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|z$p",
+                                     const_cast<char **>(kwlist),
+                                     &src,
+                                     &pixel_format,
+                                     &validate))
+    {
+        return nullptr;
+    }
+    const bool half = RGBAHalfSurfaceObjectType && PyType_IsSubtype(reinterpret_cast<PyTypeObject *>(cls), RGBAHalfSurfaceObjectType);
+
+    SurfaceArray array;
+    if (!get_surface_array(src, array))
+    {
+        Py_XDECREF(array.owner);
+        return nullptr;
+    }
+    const Py_ssize_t count = array.ndim == 4 ? array.shape[0] : 1;
+    PyObject *result = array.ndim == 4 ? PyList_New(count) : nullptr;
+    for (Py_ssize_t i = 0; i < count && (result || array.ndim < 4); i++)
+    {
+        RGBASurfaceObject *self = reinterpret_cast<RGBASurfaceObject *>(PyType_GenericNew(reinterpret_cast<PyTypeObject *>(cls), nullptr, nullptr));
+        if (self && (RGBASurface_setArray(self, array, i, pixel_format) < 0 || (half && RGBAHalfSurface_validate(self, validate) < 0)))
+            Py_CLEAR(self);
+        if (array.ndim < 4)
+        {
+            result = reinterpret_cast<PyObject *>(self);
+            break;
+        }
+        if (!self)
+            Py_CLEAR(result);
+        else
+            PyList_SetItem(result, i, reinterpret_cast<PyObject *>(self));
+    }
+    Py_DECREF(array.owner);
+    return result;
+}
+
+PyMethodDef RGBASurface_methods[] = {
+    {"from_file", (PyCFunction)RGBASurface_fromFile, METH_VARARGS | METH_KEYWORDS | METH_CLASS, "map a raw RGBA file as surface"},
+    {"from_array", (PyCFunction)RGBASurface_fromArray, METH_VARARGS | METH_KEYWORDS | METH_CLASS, "surfaces pointing into an array without copying it"},
+    {NULL} /* Sentinel */
 };
 
 PyMemberDef RGBASurface_members[] = {
-    {"width", T_INT, offsetof(RGBASurfaceObject, surf.width), 0, "width"},
-    {"height", T_INT, offsetof(RGBASurfaceObject, surf.height), 0, "height"},
-    {"stride", T_SHORT, offsetof(RGBASurfaceObject, surf.stride), 0, "stride"},
+    // read-only, the geometry is only checked against the memory behind the surface as it's created
+    {"width", T_INT, offsetof(RGBASurfaceObject, surf.width), READONLY, "width"},
+    {"height", T_INT, offsetof(RGBASurfaceObject, surf.height), READONLY, "height"},
+    {"stride", T_INT, offsetof(RGBASurfaceObject, surf.stride), READONLY, "stride"},
     {NULL} /* Sentinel */
 };
 
@@ -79,8 +343,16 @@ PyObject *RGBASurface_getData(PyObject *self, void *closure)
     return PyBytes_FromObject(self);
 }
 
+PyObject *RGBASurface_getPixelFormat(RGBASurfaceObject *self, void *closure)
+{
+    if (self->pixel_format == PixelFormat::native)
+        Py_RETURN_NONE;
+    return PyUnicode_FromString(get_pixel_format(self->pixel_format).name);
+}
+
 PyGetSetDef RGBASurface_getsetters[] = {
     {"data", (getter)RGBASurface_getData, NULL, "data", NULL},
+    {"pixel_format", (getter)RGBASurface_getPixelFormat, NULL, "pixel_format", NULL},
     {NULL} /* Sentinel */
 };
 
@@ -104,25 +376,55 @@ static int RGBASurface_getbuffer(RGBASurfaceObject *self, Py_buffer *view, int f
         return -1;
     }
 
-    view->buf = self->view.buf;
+    const bool readonly = RGBASurface_isReadonly(self);
+    if ((flags & PyBUF_WRITABLE) && readonly)
+    {
+        PyErr_SetString(PyExc_BufferError, "the surface is read-only");
+        return -1;
+    }
+    const PixelFormatInfo &pixel_format = get_pixel_format(self->pixel_format);
+    const Py_ssize_t height = self->surf.height;
+    const Py_ssize_t stride = self->surf.stride;
+    const Py_ssize_t row_size = static_cast<Py_ssize_t>(self->surf.width) * pixel_format.pixel_size();
+    // the R8 or RG8 input of BC4 and BC5 in native surfaces is exported as rows of bytes
+    const bool byte_rows = stride < row_size;
+    const bool padded = !byte_rows && stride != row_size && height > 1;
+    if (padded && (flags & PyBUF_STRIDES) != PyBUF_STRIDES)
+    {
+        PyErr_SetString(PyExc_BufferError, "the rows of the surface are padded, only strided buffers can be exported");
+        return -1;
+    }
+
+    // the surface may be a crop of its source, so the length is that of the pixels rather than of the memory they span
+    view->buf = self->surf.ptr;
+    view->len = height * (byte_rows ? stride : row_size);
     view->obj = reinterpret_cast<PyObject *>(self);
     Py_INCREF(view->obj); // Retain ownership
 
-    view->len = self->view.len;
-    view->readonly = 0;
-    view->itemsize = sizeof(uint8_t);
-    view->format = "BBBB"; // RGBA components
-    view->ndim = 3;
-    view->shape = new Py_ssize_t[3]{
-        static_cast<Py_ssize_t>(self->surf.height),
-        static_cast<Py_ssize_t>(self->surf.width),
-        4 // RGBA
-    };
-    view->strides = new Py_ssize_t[3]{
-        static_cast<Py_ssize_t>(self->surf.stride),
-        static_cast<Py_ssize_t>(4 * sizeof(uint8_t)), // Pixel stride
-        sizeof(uint8_t)                               // Component stride
-    };
+    view->readonly = readonly;
+    view->itemsize = byte_rows ? 1 : pixel_format.channel_size;
+    view->format = (flags & PyBUF_FORMAT) ? const_cast<char *>(byte_rows ? "B" : pixel_format.buffer_format) : nullptr;
+    view->ndim = byte_rows ? 2 : 3;
+    view->shape = nullptr;
+    view->strides = nullptr;
+    if ((flags & PyBUF_ND) == PyBUF_ND)
+    {
+        view->shape = byte_rows ? new Py_ssize_t[2]{height, stride}
+                                : new Py_ssize_t[3]{height, static_cast<Py_ssize_t>(self->surf.width), pixel_format.channels};
+    }
+    else
+        view->ndim = 1;
+    if ((flags & PyBUF_STRIDES) == PyBUF_STRIDES)
+    {
+        view->strides = byte_rows ? new Py_ssize_t[2]{stride, 1}
+                                  : new Py_ssize_t[3]{
+                                        stride,
+                                        pixel_format.pixel_size(), // Pixel stride
+                                        pixel_format.channel_size  // Component stride
+                                    };
+    }
+    view->suboffsets = nullptr;
+    view->internal = nullptr;
     return 0;
 }
 
@@ -143,6 +445,7 @@ PyType_Slot RGBASurfaceType_slots[] = {
     {Py_tp_dealloc, reinterpret_cast<void *>(RGBASurface_dealloc)},
     {Py_tp_members, RGBASurface_members},
     {Py_tp_getset, reinterpret_cast<void *>(RGBASurface_getsetters)},
+    {Py_tp_methods, reinterpret_cast<void *>(RGBASurface_methods)},
     {Py_bf_getbuffer, reinterpret_cast<void *>(RGBASurface_getbuffer)},
     {Py_bf_releasebuffer, reinterpret_cast<void *>(RGBASurface_releasebuffer)},
     {Py_tp_repr, reinterpret_cast<void *>(RGBASurface_repr)},
@@ -155,4 +458,76 @@ PyType_Spec RGBASurfaceType_Spec = {
     0,                                        // int itemsize;
     Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE, // unsigned int flags;
     RGBASurfaceType_slots,                    // PyType_Slot *slots;
-};
\ No newline at end of file
+};
+// checks that the surface holds half floats or float32, and if validate, only values BC6H can encode
+int RGBAHalfSurface_validate(RGBASurfaceObject *self, bool validate)
+{
+    if (self->pixel_format != PixelFormat::rgba16f && self->pixel_format != PixelFormat::rgba32f)
+    {
+        PyErr_SetString(PyExc_ValueError, "pixel_format must be 'rgba16f' or 'rgba32f'");
+        return -1;
+    }
+    int x, y;
+    if (validate && find_invalid_hdr_pixel(self->surf, self->pixel_format, x, y))
+    {
+        PyErr_Format(PyExc_ValueError, "Invalid pixel at (%d, %d), BC6H only takes finite values >= 0", x, y);
+        return -1;
+    }
+    return 0;
+}
+
+// HDR surface for BC6H, RGBA half floats by default or float32 which is converted to half while compressing
+int RGBAHalfSurface_init(RGBASurfaceObject *self, PyObject *args, PyObject *kwds)
+{
+    static const char *kwlist[] = {
+        "src",
+        "width",
+        "height",
+        "stride",
+        "pixel_format",
+        "validate",
+        nullptr};
+    PyObject *src;
+    const char *pixel_format = nullptr;
+    int validate = 1;
+
+    // Clear existing buffer if reinitialized
+    RGBASurface_clear(self);
+    self->surf.width = -1;
+    self->surf.height = -1;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|iiizp",
+                                     const_cast<char **>(kwlist),
+                                     &src,
+                                     &self->surf.width,
+                                     &self->surf.height,
+                                     &self->surf.stride,
+                                     &pixel_format,
+                                     &validate))
+    {
+        self->surf = {};
+        return -1;
+    }
+    // flat buffers default to half floats, arrays to the type of their channels
+    if (!pixel_format && self->surf.width != -1)
+        pixel_format = "rgba16f";
+    if (RGBASurface_setSource(self, src, pixel_format) < 0 || RGBAHalfSurface_validate(self, validate) < 0)
+    {
+        RGBASurface_clear(self);
+        return -1;
+    }
+    return 0;
+}
+
+PyType_Slot RGBAHalfSurfaceType_slots[] = {
+    {Py_tp_init, reinterpret_cast<void *>(RGBAHalfSurface_init)},
+    {0, NULL},
+};
+
+PyType_Spec RGBAHalfSurfaceType_Spec = {
+    "ispc_texcomp.RGBAHalfSurface",           // const char* name;
+    sizeof(RGBASurfaceObject),                // int basicsize;
+    0,                                        // int itemsize;
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE, // unsigned int flags;
+    RGBAHalfSurfaceType_slots,                // PyType_Slot *slots;
+};
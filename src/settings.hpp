@@ -1,5 +1,9 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <unordered_map>
 #include <string>
+#include <vector>
 #include "Python.h"
 
 PyTypeObject *BC7EncSettingsObjectType = nullptr;
@@ -31,6 +35,75 @@ typedef struct
         astc_enc_settings settings;
 } ASTCEncSettingsObject;
 
+// FNV-1a hash of the fields of a settings struct, added one by one as little endian int32,
+// so that it doesn't depend on the padding or the platform and can be part of persistent cache keys.
+struct SettingsFingerprint
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+
+    void add(int32_t value)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            hash ^= (static_cast<uint32_t>(value) >> (i * 8)) & 0xFF;
+            hash *= 0x100000001b3ull;
+        }
+    }
+};
+
+uint64_t settings_fingerprint(const bc7_enc_settings &settings)
+{
+    SettingsFingerprint fingerprint;
+    for (bool mode : settings.mode_selection)
+        fingerprint.add(mode);
+    for (int iterations : settings.refineIterations)
+        fingerprint.add(iterations);
+    fingerprint.add(settings.skip_mode2);
+    fingerprint.add(settings.fastSkipTreshold_mode1);
+    fingerprint.add(settings.fastSkipTreshold_mode3);
+    fingerprint.add(settings.fastSkipTreshold_mode7);
+    fingerprint.add(settings.mode45_channel0);
+    fingerprint.add(settings.refineIterations_channel);
+    fingerprint.add(settings.channels);
+    return fingerprint.hash;
+}
+
+uint64_t settings_fingerprint(const bc6h_enc_settings &settings)
+{
+    SettingsFingerprint fingerprint;
+    fingerprint.add(settings.slow_mode);
+    fingerprint.add(settings.fast_mode);
+    fingerprint.add(settings.refineIterations_1p);
+    fingerprint.add(settings.refineIterations_2p);
+    fingerprint.add(settings.fastSkipTreshold);
+    return fingerprint.hash;
+}
+
+uint64_t settings_fingerprint(const etc_enc_settings &settings)
+{
+    SettingsFingerprint fingerprint;
+    fingerprint.add(settings.fastSkipTreshold);
+    return fingerprint.hash;
+}
+
+uint64_t settings_fingerprint(const astc_enc_settings &settings)
+{
+    SettingsFingerprint fingerprint;
+    fingerprint.add(settings.block_width);
+    fingerprint.add(settings.block_height);
+    fingerprint.add(settings.channels);
+    fingerprint.add(settings.fastSkipTreshold);
+    fingerprint.add(settings.refineIterations);
+    return fingerprint.hash;
+}
+
+// fingerprint() of the settings objects, unlike hash() it's the same in every process
+template <class SettingsObject>
+static PyObject *settings_fingerprint_py(PyObject *self, PyObject *)
+{
+    return PyLong_FromUnsignedLongLong(settings_fingerprint(reinterpret_cast<SettingsObject *>(self)->settings));
+}
+
 template <class SettingsObject, auto &ProfileMap>
 static PyObject *settings_from_profile(PyObject *cls, PyObject *profile_py)
 {
@@ -73,6 +146,36 @@ static PyObject *settings_from_profile(PyObject *cls, PyObject *profile_py)
     }
 }
 
+// profiles() of the settings objects, the names from_profile accepts in alphabetical order
+template <auto &ProfileMap>
+static PyObject *settings_profiles(PyObject *cls, PyObject *)
+{
+    std::vector<const char *> names;
+    try
+    {
+        for (const auto &profile : ProfileMap)
+            names.push_back(profile.first.c_str());
+    }
+    catch (const std::exception &e)
+    {
+        PyErr_SetString(PyExc_RuntimeError, e.what());
+        return nullptr;
+    }
+    std::sort(names.begin(), names.end(), [](const char *a, const char *b)
+              { return strcmp(a, b) < 0; });
+
+    PyObject *list = PyList_New(static_cast<Py_ssize_t>(names.size()));
+    for (size_t i = 0; list && i < names.size(); i++)
+    {
+        PyObject *name = PyUnicode_FromString(names[i]);
+        if (!name)
+            Py_CLEAR(list);
+        else
+            PyList_SetItem(list, static_cast<Py_ssize_t>(i), name);
+    }
+    return list;
+}
+
 ///////////////////////////////////////////////////////////////////////////////////
 // BC7EncSettings
 typedef void (*GetProfileFunc)(bc7_enc_settings *settings);
@@ -190,6 +293,8 @@ PyObject *BC7EncSettings_repr(BC7EncSettingsObject *self)
 
 static PyMethodDef BC7EncSettingsMethods[] = {
     {"from_profile", settings_from_profile<BC7EncSettingsObject, bc7_profile_map>, METH_O | METH_CLASS, ""},
+    {"profiles", settings_profiles<bc7_profile_map>, METH_NOARGS | METH_CLASS, ""},
+    {"fingerprint", settings_fingerprint_py<BC7EncSettingsObject>, METH_NOARGS, ""},
     {nullptr, nullptr, 0, nullptr} /* Sentinel */
 };
 
@@ -256,6 +361,8 @@ PyObject *BC6HEncSettings_repr(BC6HEncSettingsObject *self)
 
 static PyMethodDef BC6HEncSettingsMethods[] = {
     {"from_profile", settings_from_profile<BC6HEncSettingsObject, bc6h_profile_map>, METH_O | METH_CLASS, ""},
+    {"profiles", settings_profiles<bc6h_profile_map>, METH_NOARGS | METH_CLASS, ""},
+    {"fingerprint", settings_fingerprint_py<BC6HEncSettingsObject>, METH_NOARGS, ""},
     {nullptr, nullptr, 0, nullptr} /* Sentinel */
 };
 
@@ -306,6 +413,8 @@ PyObject *ETCEncSettings_repr(ETCEncSettingsObject *self)
 
 static PyMethodDef ETCEncSettingsMethods[] = {
     {"from_profile", settings_from_profile<ETCEncSettingsObject, etc_profile_map>, METH_O | METH_CLASS, ""},
+    {"profiles", settings_profiles<etc_profile_map>, METH_NOARGS | METH_CLASS, ""},
+    {"fingerprint", settings_fingerprint_py<ETCEncSettingsObject>, METH_NOARGS, ""},
     {nullptr, nullptr, 0, nullptr} /* Sentinel */
 };
 
@@ -329,6 +438,19 @@ PyType_Spec ETCEncSettingsType_Spec = {
 ///////////////////////////////////////////////////////////////////////////////////
 // ASTCEncSettings
 
+// the 2D footprints defined by ASTC, limited to the ones the ISPC encoder supports (up to 8x8)
+const int astc_footprints[][2] = {{4, 4}, {5, 4}, {5, 5}, {6, 5}, {6, 6}, {8, 5}, {8, 6}, {8, 8}};
+
+bool is_astc_footprint(int block_width, int block_height)
+{
+    for (const auto &footprint : astc_footprints)
+    {
+        if (footprint[0] == block_width && footprint[1] == block_height)
+            return true;
+    }
+    return false;
+}
+
 typedef void (*GetProfile_astc)(astc_enc_settings *settings, int block_width, int block_height);
 std::unordered_map<std::string, GetProfile_astc> astc_profile_map = {
     {"fast", GetProfile_astc_fast},
@@ -351,9 +473,9 @@ int ASTCEncSettings_init(ASTCEncSettingsObject *self, PyObject *args, PyObject *
         return -1;
 
     // Validate block size
-    if (self->settings.block_width < 4 || self->settings.block_height < 4 || self->settings.block_width > 8 || self->settings.block_height > 8)
+    if (!is_astc_footprint(self->settings.block_width, self->settings.block_height))
     {
-        PyErr_SetString(PyExc_ValueError, "Invalid block dimensions (4-8 allowed)");
+        PyErr_SetString(PyExc_ValueError, "Invalid block dimensions (4x4, 5x4, 5x5, 6x5, 6x6, 8x5, 8x6 or 8x8 allowed)");
         return -1;
     }
     return 0;
@@ -390,9 +512,9 @@ static PyObject *ASTC_settings_from_profile(PyObject *cls, PyObject *args)
     }
 
     // Validate block size
-    if (block_width < 4 || block_height < 4 || block_width > 8 || block_height > 8)
+    if (!is_astc_footprint(block_width, block_height))
     {
-        PyErr_SetString(PyExc_ValueError, "Invalid block dimensions (4-8 allowed)");
+        PyErr_SetString(PyExc_ValueError, "Invalid block dimensions (4x4, 5x4, 5x5, 6x5, 6x6, 8x5, 8x6 or 8x8 allowed)");
         return nullptr;
     }
 
@@ -414,8 +536,27 @@ static PyObject *ASTC_settings_from_profile(PyObject *cls, PyObject *args)
     }
 }
 
+// the footprints from_profile accepts as (block_width, block_height) tuples
+static PyObject *ASTC_settings_block_sizes(PyObject *cls, PyObject *)
+{
+    const Py_ssize_t count = sizeof(astc_footprints) / sizeof(astc_footprints[0]);
+    PyObject *list = PyList_New(count);
+    for (Py_ssize_t i = 0; list && i < count; i++)
+    {
+        PyObject *footprint = Py_BuildValue("(ii)", astc_footprints[i][0], astc_footprints[i][1]);
+        if (!footprint)
+            Py_CLEAR(list);
+        else
+            PyList_SetItem(list, i, footprint);
+    }
+    return list;
+}
+
 static PyMethodDef ASTCEncSettingsMethods[] = {
     {"from_profile", ASTC_settings_from_profile, METH_VARARGS | METH_CLASS, ""},
+    {"block_sizes", ASTC_settings_block_sizes, METH_NOARGS | METH_CLASS, ""},
+    {"profiles", settings_profiles<astc_profile_map>, METH_NOARGS | METH_CLASS, ""},
+    {"fingerprint", settings_fingerprint_py<ASTCEncSettingsObject>, METH_NOARGS, ""},
     {nullptr, nullptr, 0, nullptr} /* Sentinel */
 };
 
@@ -0,0 +1,203 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <utility>
+
+// Cumulative counters of the compress calls of one format and settings fingerprint
+struct CallStats
+{
+    uint64_t calls;
+    uint64_t blocks;
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+    // time in the kernels, waiting for the GIL after them, and in the rest of the call (parsing, allocations, results)
+    uint64_t kernel_ns;
+    uint64_t gil_wait_ns;
+    uint64_t wrapper_ns;
+};
+
+// off by default, a call with disabled stats only loads this flag
+std::atomic<bool> stats_enabled{false};
+std::mutex stats_mutex;
+std::map<std::pair<const FormatInfo *, uint64_t>, CallStats> call_stats;
+
+inline uint64_t stats_clock() noexcept
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Timestamps of a single compress call, only taken if the stats were enabled when it started.
+struct CallTimer
+{
+    bool enabled = stats_enabled.load(std::memory_order_relaxed);
+    uint64_t start = enabled ? stats_clock() : 0;
+    uint64_t kernel_start = 0;
+    uint64_t kernel_end = 0;
+    uint64_t gil_end = 0;
+
+    // right after releasing the GIL
+    void begin_kernel() noexcept
+    {
+        if (enabled)
+            kernel_start = stats_clock();
+    }
+    // right before acquiring the GIL again
+    void end_kernel() noexcept
+    {
+        if (enabled)
+            kernel_end = stats_clock();
+    }
+    // right after acquiring the GIL again
+    void end_gil_wait() noexcept
+    {
+        if (enabled)
+            gil_end = stats_clock();
+    }
+};
+
+// adds a finished call to the counters of its format and settings
+void record_call(const CallTimer &timer, const FormatInfo &format, const EncSettings &settings, const rgba_surface &src, PixelFormat pixel_format, size_t bytes_out) noexcept
+{
+    if (!timer.enabled)
+        return;
+    const uint64_t end = stats_clock();
+    const uint64_t fingerprint = format.fingerprint ? format.fingerprint(settings) : 0;
+    const int pixel_size = pixel_format == PixelFormat::native ? format.pixel_size : get_pixel_format(pixel_format).pixel_size();
+    try
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex);
+        CallStats &stats = call_stats[{&format, fingerprint}];
+        stats.calls++;
+        stats.blocks += static_cast<uint64_t>(format.blocks_x(settings, src.width)) * format.blocks_y(settings, src.height);
+        stats.bytes_in += static_cast<uint64_t>(src.width) * src.height * pixel_size;
+        stats.bytes_out += bytes_out;
+        stats.kernel_ns += timer.kernel_end - timer.kernel_start;
+        stats.gil_wait_ns += timer.gil_end - timer.kernel_end;
+        stats.wrapper_ns += (end - timer.start) - (timer.gil_end - timer.kernel_start);
+    }
+    catch (const std::exception &)
+    {
+        // the call itself succeeded, so it just goes uncounted
+    }
+}
+
+template <class Settings, auto &ProfileMap>
+const char *find_profile_name(uint64_t fingerprint)
+{
+    for (const auto &profile : ProfileMap)
+    {
+        Settings settings = {};
+        profile.second(&settings);
+        if (settings_fingerprint(settings) == fingerprint)
+            return profile.first.c_str();
+    }
+    return nullptr;
+}
+
+const char *find_astc_profile_name(uint64_t fingerprint)
+{
+    for (const auto &profile : astc_profile_map)
+    {
+        for (const auto &footprint : astc_footprints)
+        {
+            astc_enc_settings settings = {};
+            profile.second(&settings, footprint[0], footprint[1]);
+            if (settings_fingerprint(settings) == fingerprint)
+                return profile.first.c_str();
+        }
+    }
+    return nullptr;
+}
+
+// the profile the settings were created from, "custom" if they match none, nullptr for the formats without settings
+const char *stats_profile_name(const FormatInfo &format, uint64_t fingerprint)
+{
+    const char *name = nullptr;
+    switch (&format - formats)
+    {
+    case FORMAT_BC6H:
+        name = find_profile_name<bc6h_enc_settings, bc6h_profile_map>(fingerprint);
+        break;
+    case FORMAT_BC7:
+        name = find_profile_name<bc7_enc_settings, bc7_profile_map>(fingerprint);
+        break;
+    case FORMAT_ETC1:
+        name = find_profile_name<etc_enc_settings, etc_profile_map>(fingerprint);
+        break;
+    case FORMAT_ASTC:
+        name = find_astc_profile_name(fingerprint);
+        break;
+    default:
+        return nullptr;
+    }
+    return name ? name : "custom";
+}
+
+// {(format, profile): counters}, the settings of the same profile summed up, e.g. the ASTC block sizes
+PyObject *py_stats(PyObject *self, PyObject *) noexcept
+{
+    std::map<std::pair<const FormatInfo *, const char *>, CallStats> profiles;
+    try
+    {
+        decltype(call_stats) snapshot;
+        {
+            std::lock_guard<std::mutex> lock(stats_mutex);
+            snapshot = call_stats;
+        }
+        for (const auto &[key, stats] : snapshot)
+        {
+            CallStats &total = profiles[{key.first, stats_profile_name(*key.first, key.second)}];
+            total.calls += stats.calls;
+            total.blocks += stats.blocks;
+            total.bytes_in += stats.bytes_in;
+            total.bytes_out += stats.bytes_out;
+            total.kernel_ns += stats.kernel_ns;
+            total.gil_wait_ns += stats.gil_wait_ns;
+            total.wrapper_ns += stats.wrapper_ns;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        PyErr_SetString(PyExc_RuntimeError, e.what());
+        return nullptr;
+    }
+
+    PyObject *result = PyDict_New();
+    for (auto it = profiles.begin(); result && it != profiles.end(); ++it)
+    {
+        const CallStats &stats = it->second;
+        PyObject *key = Py_BuildValue("(sz)", it->first.first->name, it->first.second);
+        PyObject *value = Py_BuildValue("{s:K,s:K,s:K,s:K,s:K,s:K,s:K}",
+                                        "calls", stats.calls,
+                                        "blocks", stats.blocks,
+                                        "bytes_in", stats.bytes_in,
+                                        "bytes_out", stats.bytes_out,
+                                        "kernel_ns", stats.kernel_ns,
+                                        "gil_wait_ns", stats.gil_wait_ns,
+                                        "wrapper_ns", stats.wrapper_ns);
+        if (!key || !value || PyDict_SetItem(result, key, value) < 0)
+            Py_CLEAR(result);
+        Py_XDECREF(key);
+        Py_XDECREF(value);
+    }
+    return result;
+}
+
+PyObject *py_reset_stats(PyObject *self, PyObject *) noexcept
+{
+    std::lock_guard<std::mutex> lock(stats_mutex);
+    call_stats.clear();
+    Py_RETURN_NONE;
+}
+
+PyObject *py_enable_stats(PyObject *self, PyObject *args, PyObject *kwds) noexcept
+{
+    static const char *kwlist[] = {"enabled", nullptr};
+    int enabled = 1;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|p", const_cast<char **>(kwlist), &enabled))
+        return nullptr;
+    return PyBool_FromLong(stats_enabled.exchange(enabled != 0));
+}
@@ -0,0 +1,240 @@
+#pragma once
+#include <Python.h>
+#include "structmember.h"
+
+PyTypeObject *StreamEncoderObjectType = nullptr;
+
+// Compresses an image band by band, so that neither the whole source nor the whole output has to be in memory.
+typedef struct
+{
+    PyObject_HEAD
+        const FormatInfo *format;
+    EncSettings settings;
+    int width;
+    int height;
+    int rows_done;
+    int threads;
+    PixelFormat pixel_format;
+    bool busy;
+    // callable receiving the compressed block rows, nullptr if feed returns them
+    PyObject *sink;
+} StreamEncoderObject;
+
+void StreamEncoder_dealloc(StreamEncoderObject *self)
+{
+    Py_XDECREF(self->sink);
+    PyObject_Del((PyObject *)self);
+}
+
+int StreamEncoder_init(StreamEncoderObject *self, PyObject *args, PyObject *kwds)
+{
+    static const char *kwlist[] = {
+        "format",
+        "width",
+        "height",
+        "settings",
+        "sink",
+        "threads",
+        "pixel_format",
+        nullptr};
+
+    const char *format_name;
+    int width;
+    int height;
+    PyObject *py_settings = nullptr;
+    PyObject *py_sink = nullptr;
+    int threads = 1;
+    const char *pixel_format_name = nullptr;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "sii|OO$O&z", const_cast<char **>(kwlist),
+                                     &format_name,
+                                     &width,
+                                     &height,
+                                     &py_settings,
+                                     &py_sink,
+                                     threads_converter,
+                                     &threads,
+                                     &pixel_format_name))
+        return -1;
+    // a running feed reads the format and settings without the GIL
+    if (self->busy)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "StreamEncoder can't be reinitialized while feed is running");
+        return -1;
+    }
+
+    const FormatInfo *format = find_format(format_name);
+    if (!format)
+        return -1;
+    EncSettings settings = {};
+    if (!parse_settings(*format, py_settings, settings))
+        return -1;
+    PixelFormat pixel_format;
+    if (!find_pixel_format(pixel_format_name, pixel_format))
+        return -1;
+    if (width <= 0 || height <= 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "width and height must be > 0");
+        return -1;
+    }
+
+    // file-like objects get their write method called, everything else has to be callable
+    PyObject *sink = nullptr;
+    if (py_sink != nullptr && py_sink != Py_None)
+    {
+        sink = PyObject_GetAttrString(py_sink, "write");
+        if (!sink)
+        {
+            PyErr_Clear();
+            if (!PyCallable_Check(py_sink))
+            {
+                PyErr_SetString(PyExc_TypeError, "sink must be callable or have a write method");
+                return -1;
+            }
+            Py_INCREF(py_sink);
+            sink = py_sink;
+        }
+    }
+
+    self->format = format;
+    self->settings = settings;
+    self->width = width;
+    self->height = height;
+    self->rows_done = 0;
+    self->threads = threads;
+    self->pixel_format = pixel_format;
+    PyObject *previous = self->sink;
+    self->sink = sink;
+    Py_XDECREF(previous);
+    return 0;
+}
+
+PyObject *StreamEncoder_feed(StreamEncoderObject *self, PyObject *args, PyObject *kwds)
+{
+    static const char *kwlist[] = {"rows", "stride", nullptr};
+    Py_buffer view;
+    int stride = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "y*|i", const_cast<char **>(kwlist), &view, &stride))
+        return nullptr;
+    if (!self->format)
+    {
+        PyBuffer_Release(&view);
+        PyErr_SetString(PyExc_RuntimeError, "StreamEncoder isn't initialized");
+        return nullptr;
+    }
+
+    const FormatInfo &format = *self->format;
+    const int pixel_size = self->pixel_format == PixelFormat::native ? format.pixel_size : get_pixel_format(self->pixel_format).pixel_size();
+    if (stride == 0)
+        stride = self->width * pixel_size;
+
+    // validate the band
+    const char *error = nullptr;
+    const int block_height = format.get_block_height(self->settings);
+    // rows of stride bytes, the last one with or without its padding
+    const Py_ssize_t row_size = static_cast<Py_ssize_t>(self->width) * pixel_size;
+    const Py_ssize_t rows = stride > 0 && view.len >= row_size ? (view.len - row_size) / stride + 1 : 0;
+    if (self->busy)
+        error = "feed is already running in another thread";
+    else if (stride < row_size)
+        error = "stride is smaller than a row";
+    else if (rows <= 0 || rows > self->height - self->rows_done)
+        error = "rows must contain between one row and the remaining rows";
+    else if (rows % block_height != 0 && rows != self->height - self->rows_done)
+        error = "only the last band may have a height that isn't a multiple of the block height";
+    else if (view.len != (rows - 1) * stride + row_size && view.len != rows * stride)
+        error = "rows must contain whole rows";
+    if (error)
+    {
+        PyBuffer_Release(&view);
+        PyErr_SetString(PyExc_ValueError, error);
+        return nullptr;
+    }
+
+    const rgba_surface band = {static_cast<uint8_t *>(view.buf), self->width, static_cast<int32_t>(rows), stride};
+    PyObject *result = PyBytes_FromStringAndSize(nullptr, compressed_size(format, self->settings, band.width, band.height));
+    if (!result)
+    {
+        PyBuffer_Release(&view);
+        return nullptr;
+    }
+    uint8_t *dst = (uint8_t *)PyBytes_AsString(result);
+    self->busy = true;
+    Py_BEGIN_ALLOW_THREADS
+        compress_surface(format, self->settings, band, dst, self->threads, self->pixel_format);
+    Py_END_ALLOW_THREADS self->busy = false;
+    PyBuffer_Release(&view);
+    self->rows_done += static_cast<int>(rows);
+
+    if (self->sink)
+    {
+        // the sink may reinitialize the encoder
+        PyObject *sink = self->sink;
+        Py_INCREF(sink);
+        PyObject *ret = PyObject_CallFunctionObjArgs(sink, result, nullptr);
+        Py_DECREF(sink);
+        Py_DECREF(result);
+        if (!ret)
+            return nullptr;
+        Py_DECREF(ret);
+        Py_RETURN_NONE;
+    }
+    return result;
+}
+
+PyObject *StreamEncoder_getRowsRemaining(StreamEncoderObject *self, void *closure)
+{
+    return PyLong_FromLong(self->height - self->rows_done);
+}
+
+PyObject *StreamEncoder_getBlockHeight(StreamEncoderObject *self, void *closure)
+{
+    return PyLong_FromLong(self->format ? self->format->get_block_height(self->settings) : 0);
+}
+
+PyMemberDef StreamEncoder_members[] = {
+    {"width", T_INT, offsetof(StreamEncoderObject, width), READONLY, "width"},
+    {"height", T_INT, offsetof(StreamEncoderObject, height), READONLY, "height"},
+    {"rows_done", T_INT, offsetof(StreamEncoderObject, rows_done), READONLY, "rows_done"},
+    {NULL} /* Sentinel */
+};
+
+PyGetSetDef StreamEncoder_getsetters[] = {
+    {"rows_remaining", (getter)StreamEncoder_getRowsRemaining, NULL, "rows_remaining", NULL},
+    {"block_height", (getter)StreamEncoder_getBlockHeight, NULL, "block_height", NULL},
+    {NULL} /* Sentinel */
+};
+
+PyMethodDef StreamEncoder_methods[] = {
+    {"feed", (PyCFunction)StreamEncoder_feed, METH_VARARGS | METH_KEYWORDS, "compress the next band of rows"},
+    {NULL} /* Sentinel */
+};
+
+PyObject *StreamEncoder_repr(PyObject *self)
+{
+    StreamEncoderObject *node = (StreamEncoderObject *)self;
+    return PyUnicode_FromFormat(
+        "<StreamEncoder (f:%s, w:%d, h:%d, rows:%d)>",
+        node->format ? node->format->name : "",
+        node->width,
+        node->height,
+        node->rows_done);
+}
+
+PyType_Slot StreamEncoderType_slots[] = {
+    {Py_tp_new, reinterpret_cast<void *>(PyType_GenericNew)},
+    {Py_tp_init, reinterpret_cast<void *>(StreamEncoder_init)},
+    {Py_tp_dealloc, reinterpret_cast<void *>(StreamEncoder_dealloc)},
+    {Py_tp_members, StreamEncoder_members},
+    {Py_tp_getset, reinterpret_cast<void *>(StreamEncoder_getsetters)},
+    {Py_tp_methods, reinterpret_cast<void *>(StreamEncoder_methods)},
+    {Py_tp_repr, reinterpret_cast<void *>(StreamEncoder_repr)},
+    {0, NULL},
+};
+
+PyType_Spec StreamEncoderType_Spec = {
+    "ispc_texcomp.StreamEncoder",             // const char* name;
+    sizeof(StreamEncoderObject),              // int basicsize;
+    0,                                        // int itemsize;
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE, // unsigned int flags;
+    StreamEncoderType_slots,                  // PyType_Slot *slots;
+};
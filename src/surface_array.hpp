@@ -0,0 +1,244 @@
+#pragma once
+#include <Python.h>
+#include <climits>
+#include <cstdint>
+
+// The parts of the DLPack ABI (dlpack.h, v0.8) needed to read a CPU tensor.
+struct DLDevice
+{
+    int32_t device_type;
+    int32_t device_id;
+};
+
+struct DLDataType
+{
+    uint8_t code;
+    uint8_t bits;
+    uint16_t lanes;
+};
+
+struct DLTensor
+{
+    void *data;
+    DLDevice device;
+    int32_t ndim;
+    DLDataType dtype;
+    int64_t *shape;
+    // in elements, nullptr for compact row major tensors
+    int64_t *strides;
+    uint64_t byte_offset;
+};
+
+struct DLManagedTensor
+{
+    DLTensor dl_tensor;
+    void *manager_ctx;
+    void (*deleter)(DLManagedTensor *self);
+};
+
+const int32_t DLPACK_CPU = 1;
+const uint8_t DLPACK_UINT = 1;
+const uint8_t DLPACK_FLOAT = 2;
+
+// An (H, W), (H, W, C) or (N, H, W, C) array of unorm8, half or float channels the surfaces point into.
+// owner keeps the memory alive, the memoryview of a buffer protocol export or the consumed DLPack tensor.
+struct SurfaceArray
+{
+    PyObject *owner;
+    uint8_t *data;
+    int ndim;
+    Py_ssize_t shape[4];
+    // in bytes
+    Py_ssize_t strides[4];
+    int itemsize;
+    bool is_float;
+    bool readonly;
+};
+
+// the capsule holding a consumed DLPack tensor, which is freed once the last surface using it is gone
+void dlpack_owner_destructor(PyObject *capsule)
+{
+    // it's also released while the error of a rejected array is set, which the deleter of the producer may not expect
+    PyObject *type, *value, *traceback;
+    PyErr_Fetch(&type, &value, &traceback);
+    DLManagedTensor *tensor = static_cast<DLManagedTensor *>(PyCapsule_GetPointer(capsule, "ispc_texcomp.dltensor"));
+    if (tensor && tensor->deleter)
+        tensor->deleter(tensor);
+    PyErr_Restore(type, value, traceback);
+}
+
+bool get_buffer_array(PyObject *obj, SurfaceArray &array) noexcept
+{
+    // the memoryview holds the export, which keeps e.g. a bytearray from being resized
+    array.owner = PyMemoryView_FromObject(obj);
+    if (!array.owner)
+        return false;
+    Py_buffer view;
+    if (PyObject_GetBuffer(array.owner, &view, PyBUF_RECORDS_RO) < 0)
+        return false;
+
+    // only native little endian is read, which is what all supported platforms are
+    const char *format = view.format ? view.format : "B";
+    if (*format == '@' || *format == '=' || *format == '<')
+        format++;
+    bool valid = format[0] != 0 && format[1] == 0;
+    switch (format[0])
+    {
+    case 'B':
+        array.is_float = false;
+        break;
+    case 'e':
+    case 'f':
+        array.is_float = true;
+        break;
+    default:
+        valid = false;
+    }
+    if (!valid)
+        PyErr_Format(PyExc_ValueError, "unsupported array format '%s', only uint8, float16 and float32 are", view.format);
+    else if (view.ndim < 2 || view.ndim > 4)
+    {
+        PyErr_Format(PyExc_ValueError, "the array has to have 2 to 4 dimensions, not %d", view.ndim);
+        valid = false;
+    }
+    else
+    {
+        array.data = static_cast<uint8_t *>(view.buf);
+        array.ndim = view.ndim;
+        array.itemsize = static_cast<int>(view.itemsize);
+        array.readonly = view.readonly != 0;
+        for (int i = 0; i < view.ndim; i++)
+        {
+            array.shape[i] = view.shape[i];
+            array.strides[i] = view.strides[i];
+        }
+    }
+    PyBuffer_Release(&view);
+    return valid;
+}
+
+bool get_dlpack_array(PyObject *obj, SurfaceArray &array) noexcept
+{
+    PyObject *capsule = PyObject_CallMethod(obj, "__dlpack__", nullptr);
+    if (!capsule)
+        return false;
+    DLManagedTensor *tensor = static_cast<DLManagedTensor *>(PyCapsule_GetPointer(capsule, "dltensor"));
+    if (!tensor)
+    {
+        Py_DECREF(capsule);
+        return false;
+    }
+    // consumed, the producer's capsule doesn't free the tensor anymore but the owner does
+    PyCapsule_SetName(capsule, "used_dltensor");
+    Py_DECREF(capsule);
+    array.owner = PyCapsule_New(tensor, "ispc_texcomp.dltensor", dlpack_owner_destructor);
+    if (!array.owner)
+    {
+        if (tensor->deleter)
+            tensor->deleter(tensor);
+        return false;
+    }
+
+    const DLTensor &t = tensor->dl_tensor;
+    if (t.device.device_type != DLPACK_CPU)
+    {
+        PyErr_SetString(PyExc_ValueError, "only arrays in CPU memory can be compressed");
+        return false;
+    }
+    if (t.dtype.lanes != 1 || !((t.dtype.code == DLPACK_UINT && t.dtype.bits == 8) || (t.dtype.code == DLPACK_FLOAT && (t.dtype.bits == 16 || t.dtype.bits == 32))))
+    {
+        PyErr_SetString(PyExc_ValueError, "unsupported array dtype, only uint8, float16 and float32 are");
+        return false;
+    }
+    if (t.ndim < 2 || t.ndim > 4)
+    {
+        PyErr_Format(PyExc_ValueError, "the array has to have 2 to 4 dimensions, not %d", t.ndim);
+        return false;
+    }
+    array.data = static_cast<uint8_t *>(t.data) + t.byte_offset;
+    array.ndim = t.ndim;
+    array.itemsize = t.dtype.bits / 8;
+    array.is_float = t.dtype.code == DLPACK_FLOAT;
+    Py_ssize_t compact = array.itemsize;
+    for (int i = t.ndim - 1; i >= 0; i--)
+    {
+        array.shape[i] = static_cast<Py_ssize_t>(t.shape[i]);
+        array.strides[i] = t.strides ? static_cast<Py_ssize_t>(t.strides[i]) * array.itemsize : compact;
+        compact *= array.shape[i];
+    }
+    return true;
+}
+
+// Reads the layout of a buffer protocol or DLPack array, without copying it. Sets array.owner, which the caller
+// has to release, on success and on failure.
+bool get_surface_array(PyObject *obj, SurfaceArray &array) noexcept
+{
+    array = {};
+    if (PyObject_CheckBuffer(obj))
+        return get_buffer_array(obj, array);
+    if (PyObject_HasAttrString(obj, "__dlpack__"))
+        return get_dlpack_array(obj, array);
+    PyErr_SetString(PyExc_TypeError, "src has to support the buffer protocol or DLPack");
+    return false;
+}
+
+// The pixel format of the channels of the array, the given one has to match them.
+bool array_pixel_format(const SurfaceArray &array, const char *name, PixelFormat &pixel_format) noexcept
+{
+    const int channels = array.ndim == 2 ? 1 : static_cast<int>(array.shape[array.ndim - 1]);
+    if (name)
+    {
+        if (!find_pixel_format(name, pixel_format))
+            return false;
+        const PixelFormatInfo &info = get_pixel_format(pixel_format);
+        if (info.channels == channels && info.channel_size == array.itemsize && (info.channel_size > 1) == array.is_float)
+            return true;
+    }
+    else
+    {
+        for (size_t i = 1; i < sizeof(pixel_formats) / sizeof(pixel_formats[0]); i++)
+        {
+            const PixelFormatInfo &info = pixel_formats[i];
+            if (info.channels == channels && info.channel_size == array.itemsize && (info.channel_size > 1) == array.is_float)
+            {
+                pixel_format = static_cast<PixelFormat>(i);
+                return true;
+            }
+        }
+    }
+    PyErr_Format(PyExc_ValueError, "no pixel format%s%s matches %d %s channels", name ? " " : "", name ? name : "", channels,
+                 array.is_float ? (array.itemsize == 2 ? "float16" : "float32") : "uint8");
+    return false;
+}
+
+// Points surf at image index of the array, rows may be any number of bytes apart, but the pixels of a row have to be
+// contiguous as the kernels read them. index is 0 for arrays without a batch dimension.
+bool array_surface(const SurfaceArray &array, Py_ssize_t index, int pixel_size, rgba_surface &surf) noexcept
+{
+    const int first = array.ndim == 4 ? 1 : 0;
+    const Py_ssize_t height = array.shape[first];
+    const Py_ssize_t width = array.shape[first + 1];
+    const Py_ssize_t row_stride = array.strides[first];
+    const bool contiguous = (array.ndim == 2 || array.strides[first + 2] == array.itemsize || array.shape[first + 2] == 1) && (array.strides[first + 1] == pixel_size || width == 1);
+    if (!contiguous)
+    {
+        PyErr_SetString(PyExc_ValueError, "the pixels of a row have to be contiguous, copy the array first");
+        return false;
+    }
+    if (width > INT_MAX || height > INT_MAX)
+    {
+        PyErr_SetString(PyExc_ValueError, "the array is too large");
+        return false;
+    }
+    // the kernels take 32 bit strides, which fits rows of more than 100k float32 pixels
+    if (height > 1 && (row_stride < width * pixel_size || row_stride > INT_MAX))
+    {
+        PyErr_SetString(PyExc_ValueError, "the rows have to be between a row and 2 GiB apart, in ascending order");
+        return false;
+    }
+    surf.ptr = array.data + (first ? index * array.strides[0] : 0);
+    surf.width = static_cast<int32_t>(width);
+    surf.height = static_cast<int32_t>(height);
+    surf.stride = height > 1 ? static_cast<int32_t>(row_stride) : static_cast<int32_t>(width * pixel_size);
+    return true;
+}
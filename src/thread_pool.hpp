@@ -0,0 +1,352 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// resolves the user facing thread count, 0 meaning one thread per hardware thread
+inline int resolve_thread_count(int threads) noexcept
+{
+    if (threads > 0)
+        return threads;
+    const unsigned int hardware = std::thread::hardware_concurrency();
+    return hardware > 0 ? static_cast<int>(hardware) : 1;
+}
+
+// Pins the calling thread to a single cpu, ignored on platforms without an affinity api (macOS).
+inline void pin_current_thread(int cpu) noexcept
+{
+    const int cpus = resolve_thread_count(0);
+    cpu %= cpus;
+#if defined(_WIN32)
+    if (cpu < static_cast<int>(sizeof(DWORD_PTR) * 8))
+        SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(1) << cpu);
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    (void)cpu;
+#endif
+}
+
+// Counts the outstanding tasks of one submitter, so that it can wait for just its own work.
+struct TaskGroup
+{
+    std::atomic<int> pending{0};
+};
+
+// Persistent work stealing thread pool.
+// Every worker owns a deque, it takes its own tasks from the back and steals from the front of the others,
+// so that uneven tasks (e.g. detailed vs. flat block rows) even out between the workers.
+class ThreadPool
+{
+public:
+    using Task = std::function<void()>;
+
+    ThreadPool(int threads, bool pin) : pinned(pin)
+    {
+        threads = resolve_thread_count(threads);
+        for (int i = 0; i < threads; i++)
+            queues.emplace_back(std::make_unique<Queue>());
+        workers.reserve(threads);
+        for (int i = 0; i < threads; i++)
+        {
+            try
+            {
+                workers.emplace_back(&ThreadPool::worker_loop, this, i);
+            }
+            catch (const std::system_error &)
+            {
+                // out of threads, the queues of the missing workers are stolen from by the others
+                break;
+            }
+        }
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto &worker : workers)
+            worker.join();
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    int size() const noexcept { return static_cast<int>(workers.size()); }
+    bool is_pinned() const noexcept { return pinned; }
+
+    // queues a task, workers push to their own deque, other threads spread their tasks round robin
+    void submit(TaskGroup &group, Task task)
+    {
+        const size_t home = current_worker() ? current_index : next_queue.fetch_add(1) % queues.size();
+        group.pending.fetch_add(1);
+        try
+        {
+            Queue &queue = *queues[home];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks.push_back({std::move(task), &group});
+        }
+        catch (...)
+        {
+            group.pending.fetch_sub(1);
+            throw;
+        }
+        queued.fetch_add(1);
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex);
+        }
+        wake.notify_one();
+    }
+
+    // runs queued tasks on the calling thread until every task of the group is done
+    void wait(TaskGroup &group)
+    {
+        const size_t home = current_worker() ? current_index : 0;
+        while (group.pending.load() > 0)
+        {
+            if (run_one(home))
+                continue;
+            std::unique_lock<std::mutex> lock(sleep_mutex);
+            wake.wait(lock, [&]
+                      { return group.pending.load() == 0 || queued.load() > 0; });
+        }
+    }
+
+private:
+    struct Entry
+    {
+        Task task;
+        TaskGroup *group;
+    };
+
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<Entry> tasks;
+    };
+
+    static thread_local const ThreadPool *current_pool;
+    static thread_local size_t current_index;
+
+    bool current_worker() const noexcept { return current_pool == this; }
+
+    bool take(size_t index, bool back, Entry &entry)
+    {
+        Queue &queue = *queues[index];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty())
+            return false;
+        if (back)
+        {
+            entry = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+        else
+        {
+            entry = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+        return true;
+    }
+
+    bool run_one(size_t home)
+    {
+        if (queued.load() == 0)
+            return false;
+
+        Entry entry;
+        bool found = take(home, true, entry);
+        for (size_t i = 1; !found && i < queues.size(); i++)
+            found = take((home + i) % queues.size(), false, entry);
+        if (!found)
+            return false;
+
+        queued.fetch_sub(1);
+        entry.task();
+        if (entry.group->pending.fetch_sub(1) == 1)
+        {
+            {
+                std::lock_guard<std::mutex> lock(sleep_mutex);
+            }
+            wake.notify_all();
+        }
+        return true;
+    }
+
+    void worker_loop(int index)
+    {
+        current_pool = this;
+        current_index = static_cast<size_t>(index);
+        if (pinned)
+            pin_current_thread(index);
+
+        while (true)
+        {
+            if (run_one(current_index))
+                continue;
+            std::unique_lock<std::mutex> lock(sleep_mutex);
+            wake.wait(lock, [&]
+                      { return stopping || queued.load() > 0; });
+            if (stopping && queued.load() == 0)
+                return;
+        }
+    }
+
+    const bool pinned;
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<size_t> queued{0};
+    std::atomic<size_t> next_queue{0};
+    std::mutex sleep_mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+};
+
+inline thread_local const ThreadPool *ThreadPool::current_pool = nullptr;
+inline thread_local size_t ThreadPool::current_index = 0;
+
+// The pool shared by all compress calls, it's created on first use with one worker per hardware thread,
+// or explicitly via configure_thread_pool.
+std::mutex shared_pool_mutex;
+std::shared_ptr<ThreadPool> shared_pool;
+
+std::shared_ptr<ThreadPool> get_thread_pool()
+{
+    std::lock_guard<std::mutex> lock(shared_pool_mutex);
+    if (!shared_pool)
+        shared_pool = std::make_shared<ThreadPool>(0, false);
+    return shared_pool;
+}
+
+void configure_thread_pool(int threads, bool pin)
+{
+    auto pool = std::make_shared<ThreadPool>(threads, pin);
+    std::shared_ptr<ThreadPool> previous;
+    {
+        std::lock_guard<std::mutex> lock(shared_pool_mutex);
+        previous = std::move(shared_pool);
+        shared_pool = std::move(pool);
+    }
+    // running calls keep their own reference, so the old workers are joined by whoever finishes last
+}
+
+// Number of workers of the shared pool, or that the default pool would have, without creating it.
+int shared_pool_size() noexcept
+{
+    std::lock_guard<std::mutex> lock(shared_pool_mutex);
+    return shared_pool ? shared_pool->size() : resolve_thread_count(0);
+}
+
+void shutdown_thread_pool()
+{
+    std::lock_guard<std::mutex> lock(shared_pool_mutex);
+    shared_pool.reset();
+}
+
+// Queues up to `threads` tasks, which call func(begin, end) for consecutive chunks of [0, count) until none are left.
+// Unlike parallel_for it doesn't wait, pool.wait(group) does, so func is copied into the tasks.
+template <class Func>
+void submit_chunks(ThreadPool &pool, TaskGroup &group, int count, int threads, Func func) noexcept
+{
+    if (count <= 0)
+        return;
+    threads = std::max(1, std::min(threads > 0 ? threads : pool.size(), count));
+    const int chunk = std::max(1, count / (threads * 4));
+
+    std::shared_ptr<std::atomic<int>> next;
+    try
+    {
+        next = std::make_shared<std::atomic<int>>(0);
+    }
+    catch (const std::exception &)
+    {
+        func(0, count);
+        return;
+    }
+    auto worker = [=]()
+    {
+        for (int begin = next->fetch_add(chunk); begin < count; begin = next->fetch_add(chunk))
+            func(begin, std::min(begin + chunk, count));
+    };
+    try
+    {
+        for (int i = 0; i < threads; i++)
+            pool.submit(group, worker);
+    }
+    catch (const std::exception &)
+    {
+        // whatever the queued tasks don't get to is done right here
+        worker();
+    }
+}
+
+// Calls func(begin, end) for consecutive chunks of [0, count) with up to `threads` threads of the shared pool.
+// The calling thread takes part in the work, so the call returns once every chunk is done.
+template <class Func>
+void parallel_for(int count, int threads, Func &&func) noexcept
+{
+    if (threads == 1 || count <= 1)
+    {
+        if (count > 0)
+            func(0, count);
+        return;
+    }
+
+    std::shared_ptr<ThreadPool> pool;
+    try
+    {
+        pool = get_thread_pool();
+    }
+    catch (const std::exception &)
+    {
+        // no pool (e.g. out of memory or threads), so all rows are done by this thread
+        func(0, count);
+        return;
+    }
+    threads = std::max(1, std::min(threads > 0 ? threads : pool->size(), count));
+
+    // a few chunks per thread keep the threads busy if some rows are more expensive than others
+    const int chunk = std::max(1, count / (threads * 4));
+    std::atomic<int> next{0};
+    auto worker = [&]()
+    {
+        for (int begin = next.fetch_add(chunk); begin < count; begin = next.fetch_add(chunk))
+            func(begin, std::min(begin + chunk, count));
+    };
+
+    TaskGroup group;
+    try
+    {
+        for (int i = 1; i < threads; i++)
+            pool->submit(group, worker);
+    }
+    catch (const std::exception &)
+    {
+        // fewer helpers, the chunks are claimed dynamically anyway
+    }
+    worker();
+    pool->wait(group);
+}
@@ -1,3 +1,7 @@
+import io
+import shutil
+import struct
+
 import imagehash
 import ispc_texcomp
 import texture2ddecoder
@@ -35,6 +39,11 @@ def check_decompressed(bgra):
     ), "Decompressed image is not similar enough to original"
 
 
+def mean_abs_diff(a, b):
+    assert len(a) == len(b)
+    return sum(abs(x - y) for x, y in zip(a, b)) / len(a)
+
+
 def test_astc():
     block_size = (8, 8)
     profile = ispc_texcomp.ASTCEncSettings.from_profile("fast", 8, 8)
@@ -84,6 +93,502 @@ def test_bc7():
     check_decompressed(bgra)
 
 
+def test_threads():
+    profile = ispc_texcomp.BC7EncSettings.from_profile("fast")
+    raw = ispc_texcomp.compress_blocks_bc7(SURFACE, profile)
+    assert raw == ispc_texcomp.compress_blocks_bc7(SURFACE, profile, threads=4)
+    profile = ispc_texcomp.ASTCEncSettings.from_profile("fast", 4, 4)
+    raw = ispc_texcomp.compress_blocks_astc(SURFACE, profile)
+    assert raw == ispc_texcomp.compress_blocks_astc(SURFACE, profile, threads=0)
+
+
+def test_thread_pool():
+    raw = ispc_texcomp.compress_blocks_bc1(SURFACE)
+    ispc_texcomp.configure_thread_pool(2, pin=True)
+    assert ispc_texcomp.thread_pool_size() == 2
+    assert ispc_texcomp.compress_blocks_bc1(SURFACE, threads=0) == raw
+    ispc_texcomp.configure_thread_pool()
+    assert ispc_texcomp.thread_pool_size() >= 1
+    assert ispc_texcomp.compress_blocks_bc1(SURFACE, threads=0) == raw
+    try:
+        ispc_texcomp.compress_blocks_bc1(SURFACE, threads=-1)
+        assert False, "accepted threads=-1"
+    except ValueError:
+        pass
+
+
+def test_compressed_size():
+    assert len(ispc_texcomp.compress_blocks_bc1(SURFACE)) == 256 * 256 // 2
+    assert ispc_texcomp.compressed_size("bc1", 5, 3) == 2 * 8
+    profile = ispc_texcomp.ASTCEncSettings.from_profile("fast", 8, 5)
+    raw = ispc_texcomp.compress_blocks_astc(SURFACE, profile)
+    assert len(raw) == ispc_texcomp.compressed_size("astc", 256, 256, profile)
+    assert len(raw) == 32 * 52 * 16
+
+
+def test_edge_padding():
+    # 254x254 crop, padded by hand to 256x256 by replicating the last row and column
+    width = height = 254
+    data = SAMPLE_IMG.crop((0, 0, width, height)).tobytes("raw", "RGBA")
+    padded = b""
+    for y in range(256):
+        row = data[min(y, height - 1) * width * 4 :][: width * 4]
+        padded += row + row[-4:] * 2
+    profile = ispc_texcomp.BC7EncSettings.from_profile("fast")
+    raw = ispc_texcomp.compress_blocks_bc7(
+        ispc_texcomp.RGBASurface(data, width, height), profile
+    )
+    assert raw == ispc_texcomp.compress_blocks_bc7(
+        ispc_texcomp.RGBASurface(padded, 256, 256), profile
+    )
+
+
+def test_into():
+    profile = ispc_texcomp.BC7EncSettings.from_profile("fast")
+    raw = ispc_texcomp.compress_blocks_bc7(SURFACE, profile)
+    out = bytearray(16 + len(raw))
+    assert ispc_texcomp.compress_blocks_bc7_into(SURFACE, profile, out, 16) == len(raw)
+    assert out[16:] == raw
+    try:
+        ispc_texcomp.compress_blocks_bc7_into(SURFACE, profile, out, 17)
+        assert False, "failed to check the output size"
+    except ValueError:
+        pass
+
+
+def test_mip_chain():
+    profile = ispc_texcomp.BC7EncSettings.from_profile("fast")
+    data, offsets = ispc_texcomp.compress_mip_chain(
+        SURFACE, "bc7", profile, "kaiser", threads=0
+    )
+    assert len(offsets) == 9
+    assert data[: offsets[1]] == ispc_texcomp.compress_blocks_bc7(SURFACE, profile)
+    # 128x128 level
+    bgra = texture2ddecoder.decode_bc7(data[offsets[1] : offsets[2]], 128, 128)
+    dec_img = Image.frombytes("RGBA", (128, 128), bgra, "raw", ("BGRA"))
+    assert (
+        abs(
+            imagehash.average_hash(SAMPLE_IMG.resize((128, 128)))
+            - imagehash.average_hash(dec_img)
+        )
+        < CUTOFF
+    )
+
+
+def test_containers():
+    profile = ispc_texcomp.BC7EncSettings.from_profile("fast")
+    data, offsets = ispc_texcomp.compress_mip_chain(SURFACE, "bc7", profile)
+    dds = ispc_texcomp.write_dds(SURFACE, "bc7", profile, levels=0)
+    assert dds[:4] == b"DDS " and dds[84:88] == b"DX10"
+    assert dds[148:] == data
+
+    ktx2 = ispc_texcomp.write_ktx2([SURFACE, SURFACE], "bc7", profile, levels=0)
+    assert ktx2[:12] == b"\xabKTX 20\xbb\r\n\x1a\n"
+    layers, faces, levels = struct.unpack_from("<3I", ktx2, 32)
+    assert (layers, faces, levels) == (2, 1, len(offsets))
+    # level 1 holds both layers
+    offset, size, _ = struct.unpack_from("<3Q", ktx2, 80 + 24)
+    level = data[offsets[1] : offsets[2]]
+    assert ktx2[offset : offset + size] == level + level
+
+
+def test_batch():
+    profile = ispc_texcomp.BC7EncSettings.from_profile("fast")
+    raw = ispc_texcomp.compress_blocks_bc7(SURFACE, profile)
+    assert (
+        ispc_texcomp.compress_batch("bc7", [SURFACE] * 3, profile, threads=0)
+        == [raw] * 3
+    )
+    data, offsets = ispc_texcomp.compress_batch(
+        "bc7", [SURFACE, SURFACE], profile, contiguous=True
+    )
+    assert data == raw * 2 and offsets == [0, len(raw)]
+
+
+def test_encoder():
+    encoder = ispc_texcomp.Encoder("bc1", SURFACE.width, SURFACE.height)
+    view = encoder.encode(SURFACE)
+    assert view.readonly
+    assert view == ispc_texcomp.compress_blocks_bc1(SURFACE)
+    # the frames share the output buffer
+    bgra = ispc_texcomp.RGBASurface(
+        SAMPLE_IMG.tobytes("raw", "BGRA"), 256, 256, pixel_format="bgra8"
+    )
+    assert encoder.encode(bgra) == view
+
+
+def test_stream_encoder():
+    profile = ispc_texcomp.BC7EncSettings.from_profile("fast")
+    raw = SAMPLE_IMG.crop((0, 0, 256, 250)).tobytes("raw", "RGBA")
+    surface = ispc_texcomp.RGBASurface(raw, 256, 250)
+    expected = ispc_texcomp.compress_blocks_bc7(surface, profile)
+    chunks = []
+    encoder = ispc_texcomp.StreamEncoder("bc7", 256, 250, profile, chunks.append)
+    band = 256 * 4 * 64
+    for i in range(0, len(raw), band):
+        encoder.feed(raw[i : i + band])
+    assert encoder.rows_remaining == 0
+    assert b"".join(chunks) == expected
+    encoder = ispc_texcomp.StreamEncoder("bc7", 256, 250, profile)
+    try:
+        encoder.feed(raw[: 256 * 4 * 3])
+        assert False, "accepted a partial block row"
+    except ValueError:
+        pass
+    # padded rows, the last one without its padding
+    row = 256 * 4
+    padded = b"".join(raw[y * row : (y + 1) * row] + bytes(16) for y in range(4))
+    assert encoder.feed(padded[:-16], row + 16) == expected[: len(expected) // 63]
+    try:
+        ispc_texcomp.StreamEncoder("bc7", 256, 1, profile).feed(
+            raw[: row + row // 2], 2 * row
+        )
+        assert False, "accepted a partial row"
+    except ValueError:
+        pass
+
+
+def test_files(tmp_path):
+    profile = ispc_texcomp.BC7EncSettings.from_profile("fast")
+    raw = SAMPLE_IMG.tobytes("raw", "RGBA")
+    src = tmp_path / "src.raw"
+    src.write_bytes(b"header" + raw)
+    surface = ispc_texcomp.RGBASurface.from_file(src, 256, 256, offset=6)
+    assert surface.data == raw
+    dst = tmp_path / "dst.bc7"
+    dst.write_bytes(b"header")
+    size = ispc_texcomp.compress_to_file(surface, "bc7", dst, profile, 6, threads=0)
+    assert dst.read_bytes() == b"header" + ispc_texcomp.compress_blocks_bc7(
+        SURFACE, profile
+    )
+    assert size == len(dst.read_bytes()) - 6
+    # rows longer than the stride would be read past the end of the mapping
+    for kwargs in ({"stride": 256 * 2, "pixel_format": "rgba8"}, {"stride": 256}):
+        try:
+            ispc_texcomp.compress_blocks_bc1(
+                ispc_texcomp.RGBASurface.from_file(src, 256, 256, **kwargs)
+            )
+            assert False, "accepted a stride smaller than a row"
+        except ValueError:
+            pass
+
+
+def test_region():
+    pixels = bytearray(SURFACE.data)
+    surface = ispc_texcomp.RGBASurface(pixels, 256, 256)
+    profile = ispc_texcomp.ASTCEncSettings.from_profile("fast", 6, 6)
+    bc1 = bytearray(ispc_texcomp.compress_blocks_bc1(surface))
+    astc = bytearray(ispc_texcomp.compress_blocks_astc(surface, profile))
+    # 26x10 pixels at (230, 100), reaching into the partial 6x6 blocks of the right edge
+    for y in range(100, 110):
+        pixels[(y * 256 + 230) * 4 : (y + 1) * 256 * 4] = bytes(26 * 4)
+    rect = (230, 100, 26, 10)
+    assert ispc_texcomp.compress_region(surface, "bc1", rect, bc1) == (228, 100, 28, 12)
+    assert ispc_texcomp.compress_region(surface, "astc", rect, astc, profile) == (
+        228,
+        96,
+        28,
+        18,
+    )
+    assert bc1 == ispc_texcomp.compress_blocks_bc1(surface)
+    assert astc == ispc_texcomp.compress_blocks_astc(surface, profile)
+
+
+def test_pixel_format():
+    profile = ispc_texcomp.BC7EncSettings.from_profile("fast")
+    bgra = ispc_texcomp.RGBASurface(
+        SAMPLE_IMG.tobytes("raw", "BGRA"), 256, 256, pixel_format="bgra8"
+    )
+    assert ispc_texcomp.compress_blocks_bc7(bgra, profile) == (
+        ispc_texcomp.compress_blocks_bc7(SURFACE, profile)
+    )
+    red = SAMPLE_IMG.getchannel("R").tobytes()
+    rgba_bc4 = ispc_texcomp.compress_blocks_bc4(
+        ispc_texcomp.RGBASurface(SURFACE.data, 256, 256, pixel_format="rgba8")
+    )
+    assert rgba_bc4 == ispc_texcomp.compress_blocks_bc4(
+        ispc_texcomp.RGBASurface(red, 256, 256, pixel_format="r8")
+    )
+
+
+def test_half_surface():
+    profile = ispc_texcomp.BC6HEncSettings.from_profile("veryfast")
+    values = [i % 7 * 0.5 for i in range(16 * 16 * 4)]
+    half = ispc_texcomp.RGBAHalfSurface(struct.pack(f"{len(values)}e", *values), 16, 16)
+    single = ispc_texcomp.RGBAHalfSurface(
+        struct.pack(f"{len(values)}f", *values), 16, 16, pixel_format="rgba32f"
+    )
+    assert half.stride == 16 * 8 and single.stride == 16 * 16
+    assert ispc_texcomp.compress_blocks_bc6h(half, profile) == (
+        ispc_texcomp.compress_blocks_bc6h(single, profile)
+    )
+    values[5] = float("nan")
+    try:
+        ispc_texcomp.RGBAHalfSurface(
+            struct.pack(f"{len(values)}f", *values), 16, 16, pixel_format="rgba32f"
+        )
+        assert False, "accepted NaN"
+    except ValueError:
+        pass
+
+
+def test_arrays():
+    data = SURFACE.data
+    array = ispc_texcomp.RGBASurface(memoryview(data).cast("B", (256, 256, 4)))
+    assert array.pixel_format == "rgba8" and array.stride == 256 * 4
+    full = ispc_texcomp.compress_blocks_bc1(SURFACE)
+    assert ispc_texcomp.compress_blocks_bc1(array) == full
+    try:
+        ispc_texcomp.decompress_blocks_bc1(full, array)
+        assert False, "decompressed into a read-only array"
+    except ValueError:
+        pass
+    try:
+        ispc_texcomp.compress_blocks_bc1_into(SURFACE, array)
+        assert False, "exported a read-only array as writable"
+    except BufferError:
+        pass
+    # crops are only exported with their strides
+    crop = ispc_texcomp.RGBASurface(memoryview(data).cast("B", (256, 256, 4))[::2])
+    assert crop.data == bytes(memoryview(data).cast("B", (256, 256, 4))[::2])
+    try:
+        io.BytesIO().write(crop)
+        assert False, "exported padded rows as contiguous"
+    except BufferError:
+        pass
+    # 4 bands of 64 rows, sharing the buffer
+    bands = ispc_texcomp.RGBASurface.from_array(
+        memoryview(data).cast("B", (4, 64, 256, 4))
+    )
+    assert [band.height for band in bands] == [64] * 4
+    assert b"".join(ispc_texcomp.compress_blocks_bc1(band) for band in bands) == full
+    assert (
+        ispc_texcomp.RGBASurface(memoryview(data).cast("B", (256, 1024))).pixel_format
+        == "r8"
+    )
+    # rows wider than 32767 bytes
+    wide = ispc_texcomp.RGBASurface(bytes(9000 * 4 * 4), 9000, 4)
+    assert wide.stride == 9000 * 4
+    try:
+        ispc_texcomp.RGBAHalfSurface(memoryview(data).cast("B", (256, 256, 4)))
+        assert False, "accepted uint8 as half floats"
+    except ValueError:
+        pass
+
+
+def test_decompress():
+    profile = ispc_texcomp.ASTCEncSettings.from_profile("fast", 6, 6)
+    raw = ispc_texcomp.compress_blocks_astc(SURFACE, profile)
+    bgra = bytearray(SAMPLE_IMG.width * SAMPLE_IMG.height * 4)
+    out = ispc_texcomp.RGBASurface(bgra, 256, 256, pixel_format="bgra8")
+    ispc_texcomp.decompress_blocks_astc(raw, out, 6, 6, threads=0)
+    check_decompressed(bytes(bgra))
+
+    raw = ispc_texcomp.compress_blocks_bc7(
+        SURFACE, ispc_texcomp.BC7EncSettings.from_profile("fast")
+    )
+    ispc_texcomp.decompress_blocks_bc7(raw, out)
+    check_decompressed(bytes(bgra))
+    try:
+        ispc_texcomp.decompress_blocks_bc7(raw, SURFACE)
+        assert False, "decompressed into a read-only surface"
+    except ValueError:
+        pass
+    try:
+        out.height = 8192
+        assert False, "changed the geometry of a surface"
+    except AttributeError:
+        pass
+
+
+def test_decompress_formats():
+    bgra = bytearray(SAMPLE_IMG.width * SAMPLE_IMG.height * 4)
+    out = ispc_texcomp.RGBASurface(bgra, 256, 256, pixel_format="bgra8")
+    ispc_texcomp.decompress_blocks_bc1(ispc_texcomp.compress_blocks_bc1(SURFACE), out)
+    check_decompressed(bytes(bgra))
+    ispc_texcomp.decompress_blocks_bc3(ispc_texcomp.compress_blocks_bc3(SURFACE), out)
+    check_decompressed(bytes(bgra))
+    raw = ispc_texcomp.compress_blocks_etc1(
+        SURFACE, ispc_texcomp.ETCEncSettings.from_profile("slow")
+    )
+    ispc_texcomp.decompress_blocks_etc1(raw, out)
+    check_decompressed(bytes(bgra))
+
+    # bc4 and bc5 keep the red and the red and green channels
+    red = SAMPLE_IMG.getchannel("R").tobytes()
+    green = SAMPLE_IMG.getchannel("G").tobytes()
+    r8 = bytearray(256 * 256)
+    ispc_texcomp.decompress_blocks_bc4(
+        ispc_texcomp.compress_blocks_bc4(SURFACE),
+        ispc_texcomp.RGBASurface(r8, 256, 256, pixel_format="r8"),
+    )
+    assert mean_abs_diff(r8, red) < 4
+    rg8 = bytearray(256 * 256 * 2)
+    ispc_texcomp.decompress_blocks_bc5(
+        ispc_texcomp.compress_blocks_bc5(SURFACE),
+        ispc_texcomp.RGBASurface(rg8, 256, 256, pixel_format="rg8"),
+    )
+    assert mean_abs_diff(rg8[0::2], red) < 4 and mean_abs_diff(rg8[1::2], green) < 4
+
+    # bc6h against the half float source, without the alpha it doesn't store
+    values = [c / 255 for c in SAMPLE_IMG.tobytes("raw", "RGBA")]
+    half = ispc_texcomp.RGBAHalfSurface(
+        struct.pack(f"{len(values)}e", *values), 256, 256
+    )
+    raw = ispc_texcomp.compress_blocks_bc6h(
+        half, ispc_texcomp.BC6HEncSettings.from_profile("veryfast")
+    )
+    rgba16f = bytearray(len(values) * 2)
+    ispc_texcomp.decompress_blocks_bc6h(
+        raw, ispc_texcomp.RGBAHalfSurface(rgba16f, 256, 256)
+    )
+    decoded = struct.unpack(f"{len(values)}e", rgba16f)
+    rgb = [i for i in range(len(values)) if i % 4 != 3]
+    assert mean_abs_diff([decoded[i] for i in rgb], [values[i] for i in rgb]) < 0.02
+
+
+def test_metrics():
+    profile = ispc_texcomp.BC7EncSettings.from_profile("fast")
+    raw, metrics = ispc_texcomp.compress_blocks_bc7(
+        SURFACE, profile, return_metrics=True, block_errors=True
+    )
+    assert raw == ispc_texcomp.compress_blocks_bc7(SURFACE, profile)
+    assert len(metrics["channel_mse"]) == 4 and metrics["psnr"] > 30
+    assert metrics["block_mse"].shape == (64, 64)
+    assert (
+        abs(sum(map(sum, metrics["block_mse"].tolist())) / 64**2 - metrics["mse"])
+        < 1e-3
+    )
+
+
+def test_adaptive():
+    fast = ispc_texcomp.BC7EncSettings.from_profile("fast")
+    slow = ispc_texcomp.BC7EncSettings.from_profile("slow")
+    raw, recompressed = ispc_texcomp.compress_adaptive(SURFACE, "bc7", fast, slow, 1e9)
+    assert recompressed == 0 and raw == ispc_texcomp.compress_blocks_bc7(SURFACE, fast)
+    raw, recompressed = ispc_texcomp.compress_adaptive(SURFACE, "bc7", fast, slow, -1)
+    assert recompressed == 64 * 64 and raw == ispc_texcomp.compress_blocks_bc7(
+        SURFACE, slow
+    )
+
+
+def test_block_cache():
+    profile = ispc_texcomp.BC7EncSettings.from_profile("fast")
+    cache = ispc_texcomp.BlockCache()
+    raw = ispc_texcomp.compress_blocks_bc7(SURFACE, profile, cache=cache, threads=4)
+    assert raw == ispc_texcomp.compress_blocks_bc7(SURFACE, profile)
+    assert cache.hits + cache.misses == 64 * 64 and cache.size == cache.misses
+    # everything is cached now
+    assert ispc_texcomp.compress_blocks_bc7(SURFACE, profile, cache=cache) == raw
+    assert cache.hits >= 64 * 64
+    # other formats don't get the bc7 blocks
+    assert ispc_texcomp.compress_blocks_bc3(
+        SURFACE, cache=cache
+    ) == ispc_texcomp.compress_blocks_bc3(SURFACE)
+
+    solid = ispc_texcomp.RGBASurface(bytes([10, 20, 30, 255]) * 64 * 64, 64, 64)
+    cache.clear()
+    ispc_texcomp.compress_blocks_bc1(solid, cache=cache)
+    assert cache.misses == 1 and cache.hits == 16 * 16 - 1
+
+
+def test_encode_cache(tmp_path):
+    profile = ispc_texcomp.BC7EncSettings.from_profile("fast")
+    assert (
+        profile.fingerprint()
+        == ispc_texcomp.BC7EncSettings.from_profile("fast").fingerprint()
+    )
+    assert (
+        profile.fingerprint()
+        != ispc_texcomp.BC7EncSettings.from_profile("alpha_slow").fingerprint()
+    )
+
+    cache = ispc_texcomp.EncodeCache(tmp_path / "cache")
+    raw = cache.compress(SURFACE, "bc7", profile)
+    assert raw == ispc_texcomp.compress_blocks_bc7(SURFACE, profile)
+    assert (
+        ispc_texcomp.EncodeCache(tmp_path / "cache").compress(SURFACE, "bc7", profile)
+        == raw
+    )
+    assert cache.compress(SURFACE, "bc1") == ispc_texcomp.compress_blocks_bc1(SURFACE)
+    assert cache.compress(SURFACE, "bc7", profile) == raw
+    assert cache.hits == 1 and cache.misses == 2 and cache.store_failures == 0
+
+    shutil.rmtree(tmp_path / "cache")
+    assert cache.compress(SURFACE, "bc7", profile) == raw
+    assert cache.misses == 3 and cache.store_failures == 1
+
+
+def test_async():
+    profile = ispc_texcomp.BC7EncSettings.from_profile("fast")
+    raw = ispc_texcomp.compress_blocks_bc7(SURFACE, profile)
+    futures = [ispc_texcomp.compress_async(SURFACE, "bc7", profile) for _ in range(8)]
+    assert [future.result() for future in futures] == [raw] * 8
+
+
+def test_cpu_target():
+    assert ispc_texcomp.cpu_target() in (
+        None,
+        "avx512skx",
+        "avx2",
+        "avx",
+        "sse4",
+        "sse2",
+        "neon",
+    )
+
+
+def test_bench():
+    from ispc_texcomp import bench
+
+    assert "slow" in ispc_texcomp.BC7EncSettings.profiles()
+    assert (8, 8) in ispc_texcomp.ASTCEncSettings.block_sizes()
+    report = bench.run(
+        size=16,
+        repeat=1,
+        threads=[1, 2],
+        formats=["bc1", "astc"],
+        profiles=["fast"],
+        images=["odd"],
+    )
+    results = report["results"]
+    # bc1 plus every astc block size, at both thread counts
+    assert len(results) == 2 * (1 + len(ispc_texcomp.ASTCEncSettings.block_sizes()))
+    assert all(result["megapixels_per_second"] > 0 for result in results)
+    assert all("speedup" in result for result in results if result["threads"] == 2)
+    overhead = bench.measure_overhead(sizes=(4,), calls=10)
+    assert all(result["nanoseconds_per_call"] > 0 for result in overhead)
+
+
+def test_stats():
+    ispc_texcomp.reset_stats()
+    previous = ispc_texcomp.enable_stats()
+    try:
+        ispc_texcomp.compress_blocks_bc1(SURFACE)
+        ispc_texcomp.compress_blocks_bc1_into(SURFACE, bytearray(256 * 256 // 2))
+        ispc_texcomp.compress_blocks_bc7(
+            SURFACE, ispc_texcomp.BC7EncSettings.from_profile("fast")
+        )
+    finally:
+        ispc_texcomp.enable_stats(previous)
+    stats = ispc_texcomp.stats()
+    bc1 = stats[("bc1", None)]
+    assert bc1["calls"] == 2
+    assert bc1["blocks"] == 2 * 64 * 64
+    assert bc1["bytes_in"] == 2 * 256 * 256 * 4
+    assert bc1["bytes_out"] == 2 * 64 * 64 * 8
+    assert (
+        sum(
+            counters["calls"]
+            for (format, _), counters in stats.items()
+            if format == "bc7"
+        )
+        == 1
+    )
+    ispc_texcomp.reset_stats()
+    assert ispc_texcomp.stats() == {}
+
+
 if __name__ == "__main__":
     for item in dir():
         if item.startswith("test_"):